@@ -1,2 +1,105 @@
 #include "SmartSpider.h"
-#include "EnvironmentTraceHit.h"
\ No newline at end of file
+#include "EnvironmentTraceHit.h"
+#include "Components/PrimitiveComponent.h"
+
+void FSpiderProbeCache::Store(const FHitResult& PlaneHit, const FVector& InAnchorLocation)
+{
+	UPrimitiveComponent* Component = PlaneHit.Component.Get();
+	if (!Component)
+	{
+		Invalidate();
+		return;
+	}
+
+	HitComponent = Component;
+	ComponentTransform = Component->GetComponentTransform();
+	PlaneNormal = PlaneHit.ImpactNormal;
+	PlaneDistance = FVector::DotProduct(PlaneNormal, PlaneHit.ImpactPoint);
+	AnchorLocation = InAnchorLocation;
+	bValid = true;
+}
+
+bool FSpiderProbeCache::IsValidAt(const FVector& Location, float MaxDistance) const
+{
+	if (!bValid) return false;
+
+	const UPrimitiveComponent* Component = HitComponent.Get();
+	if (!Component) return false;
+
+	if (Component->Mobility != EComponentMobility::Static && !Component->GetComponentTransform().Equals(ComponentTransform))
+	{
+		return false;
+	}
+
+	return FVector::DistSquared(Location, AnchorLocation) < FMath::Square(MaxDistance);
+}
+
+bool FSpiderProbeCache::Synthesize(const FVector& Start, const FVector& End, FHitResult& OutHit) const
+{
+	const FVector Delta = End - Start;
+	const float Denominator = FVector::DotProduct(PlaneNormal, Delta);
+	if (FMath::Abs(Denominator) < KINDA_SMALL_NUMBER) return false;
+
+	const float Time = (PlaneDistance - FVector::DotProduct(PlaneNormal, Start)) / Denominator;
+	if (Time < 0.f || Time > 1.f) return false;
+
+	const FVector ImpactPoint = Start + Delta * Time;
+
+	OutHit = FHitResult(Start, End);
+	OutHit.bBlockingHit = true;
+	OutHit.Time = Time;
+	OutHit.Distance = Delta.Size() * Time;
+	OutHit.Location = ImpactPoint;
+	OutHit.ImpactPoint = ImpactPoint;
+	OutHit.Normal = PlaneNormal;
+	OutHit.ImpactNormal = PlaneNormal;
+	OutHit.Component = HitComponent;
+	OutHit.Actor = HitComponent.IsValid() ? HitComponent->GetOwner() : nullptr;
+
+	return true;
+}
+
+void FSpiderProbeSet::Build(const FSpiderProbeParams& Params)
+{
+	const FVector Down(0.f, 0.f, -1.f);
+	const FVector Eye(0.f, 0.f, Params.TracingOffset_Eye);
+	const FVector Bottom(Params.TracingOffset_Bottom, 0.f, 0.f);
+	const FVector BottomAssistor(Params.TracingOffset_Bottom + Params.TracingOffset_BottomAssistor, 0.f, 0.f);
+
+	LocalStarts[(int32)ESpiderProbe::Forward] = Eye;
+	LocalEnds[(int32)ESpiderProbe::Forward] = Eye + Down.RotateAngleAxis(-Params.TracingDegreesOffset_ForwardBackward, FVector::RightVector) * Params.TracingDistance_Surface;
+
+	LocalStarts[(int32)ESpiderProbe::Backward] = Eye;
+	LocalEnds[(int32)ESpiderProbe::Backward] = Eye + Down.RotateAngleAxis(Params.TracingDegreesOffset_ForwardBackward, FVector::RightVector) * Params.TracingDistance_Surface;
+
+	LocalStarts[(int32)ESpiderProbe::Bottom] = Bottom;
+	LocalEnds[(int32)ESpiderProbe::Bottom] = Bottom + Down * Params.TracingDistance_Surface;
+
+	LocalStarts[(int32)ESpiderProbe::BottomAssistor] = BottomAssistor;
+	LocalEnds[(int32)ESpiderProbe::BottomAssistor] = BottomAssistor + Down * Params.TracingDistance_Surface;
+
+	LocalStarts[(int32)ESpiderProbe::Center] = FVector::ZeroVector;
+	LocalEnds[(int32)ESpiderProbe::Center] = Down * Params.TracingDistance_Stick;
+
+	NumRays = (int32)ESpiderProbe::Count;
+}
+
+bool FSpiderProbeSet::AddRay(const FSpiderProbeRay& Ray)
+{
+	if (NumRays >= MaxRays) return false;
+
+	LocalStarts[NumRays] = Ray.LocalStart;
+	LocalEnds[NumRays] = Ray.LocalStart + Ray.LocalDirection.GetSafeNormal() * Ray.Length;
+	CustomColors[NumRays - (int32)ESpiderProbe::Count] = Ray.DebugColor;
+	++NumRays;
+
+	return true;
+}
+
+FSpiderProbeRay FSpiderProbeSet::MakeSideRay(const FSpiderProbeParams& Params, bool bRight, const FColor& DebugColor)
+{
+	const float Degrees = bRight ? Params.TracingDegreesOffset_LeftRight : -Params.TracingDegreesOffset_LeftRight;
+	const FVector Direction = FVector(0.f, 0.f, -1.f).RotateAngleAxis(Degrees, FVector::ForwardVector);
+
+	return FSpiderProbeRay(FVector(0.f, 0.f, Params.TracingOffset_Eye), Direction, Params.TracingDistance_Surface, DebugColor);
+}
@@ -13,6 +13,119 @@ enum class EEnvironmentSurface : uint8
 	Concave
 };
 
+/* Environment probes issued by spider for surface detection. */
+enum class ESpiderProbe : uint8
+{
+	Forward = 0,
+	Backward,
+	Bottom,
+	BottomAssistor,
+	Center,
+	Count
+};
+
+/* Probe tuning of spider, shared by per-actor and swarm simulation. */
+struct FSpiderProbeParams
+{
+	float TracingOffset_Eye;
+	float TracingOffset_Bottom;
+	float TracingOffset_BottomAssistor;
+	float TracingDegreesOffset_ForwardBackward;
+	float TracingDegreesOffset_LeftRight;
+	float TracingDistance_Stick;
+	float TracingDistance_Surface;
+	float TracingDistanceTestToleranceSq;
+
+	FSpiderProbeParams()
+	{
+		FMemory::Memzero(*this);
+	}
+};
+
+/* Custom probe ray in actor local space(X forward, Y right, Z up), traced along with the built-in probes. */
+USTRUCT(BlueprintType)
+struct FSpiderProbeRay
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector LocalStart;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector LocalDirection;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0.0"))
+	float Length;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FColor DebugColor;
+
+	FSpiderProbeRay()
+		: LocalStart(FVector::ZeroVector)
+		, LocalDirection(0.f, 0.f, -1.f)
+		, Length(100.f)
+		, DebugColor(FColor::Magenta)
+	{
+	}
+
+	FSpiderProbeRay(const FVector& InLocalStart, const FVector& InLocalDirection, float InLength, const FColor& InDebugColor)
+		: LocalStart(InLocalStart)
+		, LocalDirection(InLocalDirection)
+		, Length(InLength)
+		, DebugColor(InDebugColor)
+	{
+	}
+};
+
+/*
+* Fixed list of probe rays in actor local space, directions are resolved once when built.
+* Built-in probes take the first slots in order of ESpiderProbe, custom rays follow.
+* Transforming the whole set costs two position transforms per ray, without any trig.
+*/
+struct FSpiderProbeSet
+{
+	static const int32 MaxCustomRays = 4;
+	static const int32 MaxRays = (int32)ESpiderProbe::Count + MaxCustomRays;
+
+	FVector LocalStarts[MaxRays];
+	FVector LocalEnds[MaxRays];
+	FColor CustomColors[MaxCustomRays];
+	int32 NumRays;
+
+	FSpiderProbeSet()
+		: NumRays((int32)ESpiderProbe::Count)
+	{
+		FMemory::Memzero(LocalStarts);
+		FMemory::Memzero(LocalEnds);
+	}
+
+	/* Reset to built-in probes of tuning, custom rays are dropped. */
+	void Build(const FSpiderProbeParams& Params);
+
+	/* Returns false if the set is full. */
+	bool AddRay(const FSpiderProbeRay& Ray);
+
+	/* Left and right probes from eye position, tilted by @TracingDegreesOffset_LeftRight. */
+	static FSpiderProbeRay MakeSideRay(const FSpiderProbeParams& Params, bool bRight, const FColor& DebugColor);
+
+	FORCEINLINE int32 NumCustomRays() const { return NumRays - (int32)ESpiderProbe::Count; }
+
+	FORCEINLINE void GetSegment(int32 Index, const FTransform& ActorTransform, FVector& OutStart, FVector& OutEnd) const
+	{
+		OutStart = ActorTransform.TransformPositionNoScale(LocalStarts[Index]);
+		OutEnd = ActorTransform.TransformPositionNoScale(LocalEnds[Index]);
+	}
+
+	FORCEINLINE void Transform(const FTransform& ActorTransform, FVector* OutStarts, FVector* OutEnds) const
+	{
+		for (int32 Index = 0; Index < NumRays; ++Index)
+		{
+			OutStarts[Index] = ActorTransform.TransformPositionNoScale(LocalStarts[Index]);
+			OutEnds[Index] = ActorTransform.TransformPositionNoScale(LocalEnds[Index]);
+		}
+	}
+};
+
 UENUM(BlueprintType)
 enum class EAcceptableDistance: uint8
 {
@@ -64,4 +177,169 @@ struct FAcceptableHitResult
 
 		return bAcceptable;
 	}
-};
\ No newline at end of file
+
+	/* Take result of the test computed elsewhere, e.g. by probe kernels. */
+	FORCEINLINE void SetAcceptableDistance(EAcceptableDistance InAcceptableDistance)
+	{
+		AcceptableDistance = InAcceptableDistance;
+		bAcceptable = InAcceptableDistance == EAcceptableDistance::Equal;
+	}
+};
+
+/* Result block of one probe set, all surface classifiers read from it. */
+USTRUCT(BlueprintType)
+struct FTraceResult
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere)
+	FAcceptableHitResult HitResultForward;
+
+	UPROPERTY(EditAnywhere)
+	FAcceptableHitResult HitResultBackward;
+
+	UPROPERTY(EditAnywhere)
+	FAcceptableHitResult HitResultBottom;
+
+	UPROPERTY(EditAnywhere)
+	FAcceptableHitResult HitResultBottomAssistor;
+
+	UPROPERTY(EditAnywhere)
+	FHitResult HitResultCenter;
+
+	UPROPERTY(EditAnywhere)
+	EEnvironmentSurface SurfaceType;
+
+	/* Hits of custom rays in order they were added to probe set. C++ only. */
+	FHitResult CustomHits[FSpiderProbeSet::MaxCustomRays];
+
+	FTraceResult(FAcceptableHitResult Forward, FAcceptableHitResult Backward, FAcceptableHitResult bottom, EEnvironmentSurface TargetSurface)
+	{
+		HitResultForward = Forward;
+		HitResultBackward = Backward;
+		HitResultBottom = bottom;
+
+		SurfaceType = TargetSurface;
+	}
+
+	FTraceResult()
+	{
+		HitResultForward = FAcceptableHitResult();
+		HitResultBackward = FAcceptableHitResult();
+		HitResultBottom = FAcceptableHitResult();
+		HitResultBottomAssistor = FAcceptableHitResult();
+
+		SurfaceType = EEnvironmentSurface::Plane;
+	}
+
+	/* Probes tested against acceptable distance take the first slots of ESpiderProbe, bottom assistor is not traced. */
+	static const int32 NumAcceptableHits = 3;
+
+	FORCEINLINE FAcceptableHitResult& GetAcceptableHit(int32 Index)
+	{
+		switch ((ESpiderProbe)Index)
+		{
+			case ESpiderProbe::Forward: return HitResultForward;
+			case ESpiderProbe::Backward: return HitResultBackward;
+			default: return HitResultBottom;
+		}
+	}
+
+	/* Hit slot of probe set ray. */
+	FORCEINLINE FHitResult& GetHit(int32 RayIndex)
+	{
+		switch ((ESpiderProbe)RayIndex)
+		{
+			case ESpiderProbe::Forward: return HitResultForward.HitResult;
+			case ESpiderProbe::Backward: return HitResultBackward.HitResult;
+			case ESpiderProbe::Bottom: return HitResultBottom.HitResult;
+			case ESpiderProbe::BottomAssistor: return HitResultBottomAssistor.HitResult;
+			case ESpiderProbe::Center: return HitResultCenter;
+			default: return CustomHits[RayIndex - (int32)ESpiderProbe::Count];
+		}
+	}
+};
+
+/* 
+* Last plane spider walked on, answers probes by intersecting with the plane instead of tracing.
+* Valid until spider moved far enough from anchor, or the hit component moved.
+*/
+struct FSpiderProbeCache
+{
+	TWeakObjectPtr<UPrimitiveComponent> HitComponent;
+	FTransform ComponentTransform;
+	FVector PlaneNormal;
+	float PlaneDistance;
+	FVector AnchorLocation;
+	uint32 bValid : 1;
+
+	FSpiderProbeCache()
+		: PlaneNormal(FVector::UpVector)
+		, PlaneDistance(0.f)
+		, AnchorLocation(FVector::ZeroVector)
+		, bValid(false)
+	{
+	}
+
+	FORCEINLINE void Invalidate()
+	{
+		bValid = false;
+		HitComponent = nullptr;
+	}
+
+	void Store(const FHitResult& PlaneHit, const FVector& InAnchorLocation);
+	bool IsValidAt(const FVector& Location, float MaxDistance) const;
+
+	/* Intersect segment with cached plane, returns false if the segment does not reach the plane. */
+	bool Synthesize(const FVector& Start, const FVector& End, FHitResult& OutHit) const;
+};
+
+/* Pure surface classification of probe result block, safe to run on worker threads. */
+struct FSpiderSurfaceClassifier
+{
+	static FORCEINLINE bool IsOnAir(const FTraceResult& Probes)
+	{
+		return Probes.HitResultForward.AcceptableDistance == EAcceptableDistance::GreaterThan &&
+				Probes.HitResultBackward.AcceptableDistance == EAcceptableDistance::GreaterThan &&
+				Probes.HitResultBottom.AcceptableDistance == EAcceptableDistance::GreaterThan;
+	}
+
+	static FORCEINLINE bool IsSurfaceConvex(const FTraceResult& Probes)
+	{
+		return Probes.HitResultBottom.AcceptableDistance == EAcceptableDistance::GreaterThan;
+	}
+
+	static FORCEINLINE bool IsSurfaceConcave(const FTraceResult& Probes)
+	{
+		return Probes.HitResultForward.AcceptableDistance == EAcceptableDistance::LessThan;
+	}
+
+	/* Nothing under the body, spider lost its surface. */
+	static FORCEINLINE bool IsSurfaceLost(const FTraceResult& Probes)
+	{
+		return !Probes.HitResultCenter.bBlockingHit && !Probes.HitResultBottom.HitResult.bBlockingHit;
+	}
+
+	static FORCEINLINE EEnvironmentSurface GetSurfaceType(const FTraceResult& Probes)
+	{
+		if (IsSurfaceLost(Probes)) return EEnvironmentSurface::OnAir;
+
+		if (IsSurfaceConcave(Probes)) return EEnvironmentSurface::Concave;
+
+		if (IsSurfaceConvex(Probes)) return EEnvironmentSurface::Convex;
+
+		return EEnvironmentSurface::Plane;
+	}
+
+	/* Test gathered hits against acceptable distance and classify surface type. Same hits as the vectorized path of swarm. */
+	static FORCEINLINE void Classify(FTraceResult& Probes, float AcceptableDistanceSq, float ToleranceSq)
+	{
+		for (int32 HitIndex = 0; HitIndex < FTraceResult::NumAcceptableHits; ++HitIndex)
+		{
+			FAcceptableHitResult& Hit = Probes.GetAcceptableHit(HitIndex);
+			if (Hit.HitResult.bBlockingHit) Hit.TestAgainstHitResult(AcceptableDistanceSq, ToleranceSq);
+		}
+
+		Probes.SurfaceType = GetSurfaceType(Probes);
+	}
+};
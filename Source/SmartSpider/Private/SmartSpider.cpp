@@ -1,9 +1,46 @@
 // Copyright 1998-2017 Epic Games, Inc. All Rights Reserved.
 
 #include "SmartSpider.h"
+#include "SpiderStats.h"
 
 #define LOCTEXT_NAMESPACE "FSmartSpiderModule"
 
+DEFINE_STAT(STAT_SpiderSwarmTick);
+DEFINE_STAT(STAT_SpiderScheduleTraces);
+DEFINE_STAT(STAT_SpiderSimulateEnv);
+DEFINE_STAT(STAT_SpiderGatherProbes);
+DEFINE_STAT(STAT_SpiderProbeTraces);
+DEFINE_STAT(STAT_SpiderAsyncProbes);
+DEFINE_STAT(STAT_SpiderClassifyProbes);
+DEFINE_STAT(STAT_SpiderApplySurface);
+DEFINE_STAT(STAT_SpiderHandleOnAir);
+DEFINE_STAT(STAT_SpiderHandlePlane);
+DEFINE_STAT(STAT_SpiderHandleConvex);
+DEFINE_STAT(STAT_SpiderHandleConcave);
+DEFINE_STAT(STAT_SpiderStickToSurface);
+DEFINE_STAT(STAT_SpiderSnapToSurface);
+DEFINE_STAT(STAT_SpiderBlueprintEvents);
+DEFINE_STAT(STAT_SpiderStartWallWalking);
+DEFINE_STAT(STAT_SpiderPhysWallWalk);
+DEFINE_STAT(STAT_SpiderPerception);
+DEFINE_STAT(STAT_SpiderSeparation);
+DEFINE_STAT(STAT_SpiderFlowFields);
+DEFINE_STAT(STAT_SpiderPathSearch);
+DEFINE_STAT(STAT_SpiderAgents);
+DEFINE_STAT(STAT_SpiderLegIK);
+DEFINE_STAT(STAT_SpiderNetSmoothing);
+
+DEFINE_STAT(STAT_SpiderTracesIssued);
+DEFINE_STAT(STAT_SpiderProbeCacheHits);
+DEFINE_STAT(STAT_SpiderDistanceFieldProbes);
+DEFINE_STAT(STAT_SpiderSightTraces);
+DEFINE_STAT(STAT_SpiderTransitionsToOnAir);
+DEFINE_STAT(STAT_SpiderTransitionsToPlane);
+DEFINE_STAT(STAT_SpiderTransitionsToConvex);
+DEFINE_STAT(STAT_SpiderTransitionsToConcave);
+DEFINE_STAT(STAT_SpiderEdgeTrajectories);
+DEFINE_STAT(STAT_SpiderDormant);
+
 void FSmartSpiderModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
@@ -2,17 +2,26 @@
 
 #include "SmartSpider.h"
 #include "SmartSpiderCharacter.h"
-#include "GameFramework/CharacterMovementComponent.h"
+#include "SpiderMovementComponent.h"
+#include "SpiderStats.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Kismet/GameplayStatics.h"
 #include "Components/SphereComponent.h"
+#include "SignificanceManager.h"
+#include "Net/UnrealNetwork.h"
+#include "DrawDebugHelpers.h"
+
+static const FName SpiderSignificanceTag(TEXT("SmartSpider"));
 
 
 // Sets default values
-ASmartSpiderCharacter::ASmartSpiderCharacter()
+ASmartSpiderCharacter::ASmartSpiderCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<USpiderMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	PrimaryActorTick.bCanEverTick = true;
 
+	SpiderMovement = Cast<USpiderMovementComponent>(GetCharacterMovement());
+
 	TracingOffset_Eye = 15;
 	TracingOffset_Bottom = -5;
 	TracingOffset_BottomAssistor = -3;
@@ -29,7 +38,32 @@ ASmartSpiderCharacter::ASmartSpiderCharacter()
 	bForceStickToSurfaceAtBegin = true;
 	bRotationToMovement = true;
 	bDisableMovementWhenTransition = true;
+	bUseEdgeTrajectories = true;
+	ConcaveArcRadius = 8;
 	bUseCustomRotationRate = false;
+	bUseAsyncTracing = false;
+	bSimulateInSwarm = true;
+	bAsyncProbesReady = false;
+	bForceSyncProbes = true;
+	bUseProbeCache = false;
+	bProbesFromCache = false;
+	bPooled = false;
+	bHasLastProbes = false;
+	LastProbesFrame = 0;
+	bLegIKConsumer = false;
+	ProbeCacheDistance = 30;
+	bProbeLeftRight = false;
+	ActiveProbes = nullptr;
+	ActiveDeltaTime = 0;
+	bUseSignificanceLOD = true;
+	bUseDormancy = false;
+	DormancyIdleTime = 2;
+	bDormant = false;
+	bDormantMeshTick = false;
+	IdleTime = 0;
+	bRegisteredSignificance = false;
+	SignificanceTier = 0;
+	EnvDeltaTime = 0;
 	RotateRateInDegrees = 540;
 	TransitionRateInDegrees = 540;
 	StickToSurfaceSpeed = 50;
@@ -44,6 +78,9 @@ ASmartSpiderCharacter::ASmartSpiderCharacter()
 
 	QueryObjectsType.Add(UEngineTypes::ConvertToObjectType(ECollisionChannel::ECC_WorldStatic));
 	bTraceComplex = false;
+	bIgnoreOtherSpiders = true;
+	bUseDistanceField = true;
+	bUseSurfaceReplication = false;
 
 	SightsDistanceSq = 1000 * 1000;
 	HearingDistanceSq = 1100 * 1100;
@@ -61,41 +98,636 @@ void ASmartSpiderCharacter::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
-	if (bTracingEnvWithHasVelocityOnly && GetVelocity().SizeSquared() > 0)
+	// Swarm spiders keep ticking for blueprints, their environment is traced within batched pass of swarm manager.
+	if (!IsSimulatedInSwarm())
+	{
+		SimulateEnv(DeltaSeconds);
+		UpdateDormancy(DeltaSeconds);
+	}
+}
+
+void ASmartSpiderCharacter::AddMovementInput(FVector WorldDirection, float ScaleValue /* = 1.0f */, bool bForce /* = false */)
+{
+	if (ScaleValue != 0.f && !WorldDirection.IsZero())
+	{
+		WakeUp();
+	}
+
+	Super::AddMovementInput(WorldDirection, ScaleValue, bForce);
+}
+
+void ASmartSpiderCharacter::LaunchCharacter(FVector LaunchVelocity, bool bXYOverride, bool bZOverride)
+{
+	WakeUp();
+
+	Super::LaunchCharacter(LaunchVelocity, bXYOverride, bZOverride);
+}
+
+float ASmartSpiderCharacter::TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, class AController* EventInstigator, AActor* DamageCauser)
+{
+	WakeUp();
+
+	return Super::TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser);
+}
+
+bool ASmartSpiderCharacter::CanEnterDormancy() const
+{
+	// Players and proxies are driven from elsewhere, only idle authority spiders sleep.
+	if (!bUseDormancy || bPooled || Role != ROLE_Authority || IsPlayerControlled()) return false;
+
+	if (GetCurrentSurfaceType() == EEnvironmentSurface::OnAir || !SpiderMovement->IsWallWalking()) return false;
+
+	return GetVelocity().IsZero() && GetPendingMovementInputVector().IsZero() && SpiderMovement->GetCurrentAcceleration().IsZero() &&
+			SpiderMovement->GetSeparationVelocity().IsZero() && !SpiderMovement->IsFollowingEdgeTrajectory() && !SpiderMovement->HasPendingSurfaceTransition();
+}
+
+void ASmartSpiderCharacter::UpdateDormancy(float DeltaSeconds)
+{
+	if (bDormant) return;
+
+	if (!CanEnterDormancy())
+	{
+		IdleTime = 0;
+		return;
+	}
+
+	IdleTime += DeltaSeconds;
+	if (IdleTime >= DormancyIdleTime)
+	{
+		EnterDormancy();
+	}
+}
+
+void ASmartSpiderCharacter::EnterDormancy()
+{
+	bDormant = true;
+	INC_DWORD_STAT(STAT_SpiderDormant);
+
+	SetActorTickEnabled(false);
+	SpiderMovement->SetComponentTickEnabled(false);
+	EnvDeltaTime = 0;
+
+	// Pose of a still spider does not change, leg placement and its probes sleep along.
+	bDormantMeshTick = GetMesh() && GetMesh()->IsComponentTickEnabled();
+	if (bDormantMeshTick)
+	{
+		GetMesh()->SetComponentTickEnabled(false);
+	}
+
+	UPrimitiveComponent* Surface = LastSurfaceBase.Get();
+	if (Surface && Surface->Mobility == EComponentMobility::Movable)
+	{
+		DormantSurface = Surface;
+		DormantSurfaceMovedHandle = Surface->TransformUpdated.AddUObject(this, &ASmartSpiderCharacter::OnDormantSurfaceMoved);
+	}
+}
+
+void ASmartSpiderCharacter::ReleaseDormantSurface()
+{
+	if (UPrimitiveComponent* Surface = DormantSurface.Get())
+	{
+		Surface->TransformUpdated.Remove(DormantSurfaceMovedHandle);
+	}
+
+	DormantSurface = nullptr;
+	DormantSurfaceMovedHandle.Reset();
+}
+
+void ASmartSpiderCharacter::OnDormantSurfaceMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	WakeUp();
+
+	// Spider is not based on its surface, catch up with it before movement ticks again.
+	bForceSyncProbes = true;
+	ProbeCache.Invalidate();
+	SnapToSurface(TracingDistance_Stick);
+}
+
+void ASmartSpiderCharacter::WakeUp()
+{
+	IdleTime = 0;
+	if (!bDormant) return;
+
+	bDormant = false;
+	DEC_DWORD_STAT(STAT_SpiderDormant);
+
+	ReleaseDormantSurface();
+	SpiderMovement->SetComponentTickEnabled(true);
+	if (bDormantMeshTick)
+	{
+		GetMesh()->SetComponentTickEnabled(true);
+		bDormantMeshTick = false;
+	}
+
+	if (!bPooled)
+	{
+		SetActorTickEnabled(true);
+	}
+}
+
+void ASmartSpiderCharacter::SimulateEnv(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderSimulateEnv);
+
+	if (PrepareEnvTracing(DeltaSeconds))
+	{
+		if (SwarmManager && !SwarmManager->GetTraceScheduler().TryAcquire(GetExpectedProbeCost()))
+		{
+			ExtrapolateOnSurface();
+			return;
+		}
+
+		TraceEnvHandle(ConsumeEnvDeltaTime());
+	}
+}
+
+int32 ASmartSpiderCharacter::GetExpectedProbeCost() const
+{
+	if (bUseProbeCache && ProbeCache.IsValidAt(GetActorLocation(), ProbeCacheDistance)) return 0;
+
+	int32 NumActiveProbes = 0;
+	for (int32 Index = 0; Index < ProbeSet.NumRays; ++Index)
+	{
+		NumActiveProbes += IsProbeActive(Index) ? 1 : 0;
+	}
+
+	// Probes in distance field trace movable bodies, and unbaked object types on their own.
+	const FSpiderDistanceFieldData* Field = FindProbeDistanceField();
+	return Field && GetUnbakedObjectQueryParams(*Field).IsValid() ? NumActiveProbes * 2 : NumActiveProbes;
+}
+
+void ASmartSpiderCharacter::ExtrapolateOnSurface()
+{
+	UCharacterMovementComponent* Movement = GetCharacterMovement();
+	Movement->Velocity = FVector::VectorPlaneProject(Movement->Velocity, GetCurrentSurfaceNormal());
+}
+
+bool ASmartSpiderCharacter::PrepareEnvTracing(float DeltaSeconds)
+{
+	// Edge trajectory is known up to landing, nothing to probe for.
+	if (!ShouldTraceEnv() || IsSurfaceReplicatedProxy() || SpiderMovement->IsFollowingEdgeTrajectory())
+	{
+		EnvDeltaTime = 0;
+		return false;
+	}
+
+	EnvDeltaTime += DeltaSeconds;
+
+	// Batched pass runs every frame regardless of actor tick interval, so swarm spiders wait out the tier interval here.
+	if (IsSimulatedInSwarm() && EnvDeltaTime < CurrentLODTier.TickInterval) return false;
+
+	// Stagger by unique id, so spiders of the same tier do not probe at the same frame.
+	const uint32 ProbeInterval = FMath::Max(CurrentLODTier.ProbeInterval, 1);
+	return ProbeInterval == 1 || (GFrameCounter + GetUniqueID()) % ProbeInterval == 0;
+}
+
+float ASmartSpiderCharacter::CalcSignificance(const FTransform& Viewpoint) const
+{
+	const FVector ToSpider = GetActorLocation() - Viewpoint.GetLocation();
+	float Distance = ToSpider.Size();
+
+	// Spiders behind the viewpoint are hardly visible.
+	if (FVector::DotProduct(Viewpoint.GetUnitAxis(EAxis::X), ToSpider) < 0.f)
+	{
+		Distance *= GetDefault<USmartSpiderSettings>()->HiddenDistanceScale;
+	}
+
+	return -Distance;
+}
+
+bool ASmartSpiderCharacter::ApplyLODTier(int32 Tier)
+{
+	const USmartSpiderSettings* Settings = GetDefault<USmartSpiderSettings>();
+	if (!Settings->LODTiers.IsValidIndex(Tier)) return false;
+
+	CurrentLODTier = Settings->LODTiers[Tier];
+	SetActorTickInterval(CurrentLODTier.TickInterval);
+	return true;
+}
+
+void ASmartSpiderCharacter::SetSignificanceTier(int32 NewTier)
+{
+	if (NewTier == SignificanceTier || !ApplyLODTier(NewTier)) return;
+
+	const int32 OldTier = SignificanceTier;
+	SignificanceTier = NewTier;
+
+	if (NewTier == 0 && OldTier > 0 && !bPooled)
+	{
+		// Reduced probes may leave spider floating or misaligned, re-snap before full fidelity takes over.
+		bForceSyncProbes = true;
+		ProbeCache.Invalidate();
+		EnvDeltaTime = 0;
+		SnapToSurface(TracingDistance_Stick);
+	}
+}
+
+EEnvironmentSurface ASmartSpiderCharacter::GetCurrentSurfaceType() const
+{
+	return SwarmHandle.IsValid() ? SwarmManager->GetLastSurfaceType(SwarmHandle) : LastSurfaceType;
+}
+
+FVector ASmartSpiderCharacter::GetCurrentSurfaceNormal() const
+{
+	return SwarmHandle.IsValid() ? SwarmManager->GetSurfaceNormal(SwarmHandle) : SurfaceNormal;
+}
+
+void ASmartSpiderCharacter::TeleportSucceeded(bool bIsATest)
+{
+	Super::TeleportSucceeded(bIsATest);
+
+	if (!bIsATest)
+	{
+		WakeUp();
+
+		// Pending async probes were issued from the old location.
+		bForceSyncProbes = true;
+		ProbeCache.Invalidate();
+		bHasLastProbes = false;
+		LastSurfaceBase = nullptr;
+		SpiderMovement->CancelEdgeTrajectory();
+	}
+}
+
+void ASmartSpiderCharacter::ActivateFromPool(const FTransform& Transform, const FVector& Velocity, EEnvironmentSurface Surface, const FVector& InSurfaceNormal)
+{
+	WakeUp();
+
+	SetActorLocationAndRotation(Transform.GetLocation(), Transform.GetRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	LastSurfaceType = Surface;
+	SurfaceNormal = InSurfaceNormal;
+	bNeedStickToSurface = Surface != EEnvironmentSurface::OnAir;
+	bForceSyncProbes = true;
+	ProbeCache.Invalidate();
+	bHasLastProbes = false;
+	LastSurfaceBase = nullptr;
+	EnvDeltaTime = 0;
+
+	SpiderMovement->CancelEdgeTrajectory();
+	SpiderMovement->SetSurface(InSurfaceNormal, Surface != EEnvironmentSurface::OnAir);
+	if (Surface != EEnvironmentSurface::OnAir)
+	{
+		SpiderMovement->StartWallWalking();
+	}
+	else
+	{
+		SpiderMovement->SetMovementMode(MOVE_Falling);
+	}
+	SpiderMovement->Velocity = Velocity;
+
+	if (SwarmManager && bSimulateInSwarm)
+	{
+		SwarmManager->Register(this);
+	}
+
+	SetActorTickEnabled(true);
+	bPooled = false;
+}
+
+void ASmartSpiderCharacter::DeactivateToPool()
+{
+	WakeUp();
+
+	if (SwarmManager)
+	{
+		SwarmManager->Unregister(SwarmHandle);
+	}
+
+	SetActorTickEnabled(false);
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+
+	SpiderMovement->StopMovementImmediately();
+	SpiderMovement->DisableMovement();
+
+	bPooled = true;
+}
+
+void ASmartSpiderCharacter::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	RebuildProbeQueryParams();
+	ApplySpiderMaskFilter();
+}
+
+void ASmartSpiderCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(ASmartSpiderCharacter, ReplicatedSurfaceState, COND_SimulatedOnly);
+}
+
+void ASmartSpiderCharacter::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	if (bUseSurfaceReplication)
+	{
+		UpdateReplicatedSurfaceState();
+	}
+
+	DOREPLIFETIME_ACTIVE_OVERRIDE(ASmartSpiderCharacter, ReplicatedSurfaceState, bUseSurfaceReplication);
+}
+
+void ASmartSpiderCharacter::UpdateReplicatedSurfaceState()
+{
+	FSpiderReplicatedSurfaceState& State = ReplicatedSurfaceState;
+
+	// Spiders on moving platforms are sent relative to them, so proxies stay on the platform between updates.
+	UPrimitiveComponent* Base = LastSurfaceBase.Get();
+	State.bRelativeToBase = Base && Base->Mobility == EComponentMobility::Movable && Base->IsSupportedForNetworking();
+	State.Base = State.bRelativeToBase ? Base : nullptr;
+	State.Location = State.bRelativeToBase ? Base->GetComponentTransform().InverseTransformPosition(GetActorLocation()) : GetActorLocation();
+	State.Rotation = GetActorQuat();
+	State.SurfaceNormal = GetCurrentSurfaceNormal();
+	State.SurfaceType = GetCurrentSurfaceType();
+	State.bAttached = SpiderMovement->IsAttachedToSurface();
+	State.Velocity = GetVelocity();
+
+	if (!SwarmManager) return;
+
+	float DistanceSq = MAX_FLT;
+	for (const FTransform& Viewpoint : SwarmManager->GetViewpoints())
+	{
+		DistanceSq = FMath::Min(DistanceSq, FVector::DistSquared(Viewpoint.GetLocation(), GetActorLocation()));
+	}
+
+	NetUpdateFrequency = GetDefault<USmartSpiderSettings>()->GetNetUpdateFrequency(FMath::Sqrt(DistanceSq));
+}
+
+void ASmartSpiderCharacter::OnRep_SurfaceState()
+{
+	const FSpiderReplicatedSurfaceState& State = ReplicatedSurfaceState;
+
+	// Base not resolved yet, keep extrapolating the last state.
+	FVector Location;
+	if (!State.GetWorldLocation(Location)) return;
+
+	SpiderMovement->SetNetTarget(Location, State.Rotation, State.Velocity, State.SurfaceNormal, State.bAttached);
+
+	SurfaceNormalState() = State.SurfaceNormal;
+	const EEnvironmentSurface LastSurface = LastSurfaceTypeState();
+	if (State.SurfaceType != LastSurface)
+	{
+		LastSurfaceTypeState() = State.SurfaceType;
+
+		SCOPE_CYCLE_COUNTER(STAT_SpiderBlueprintEvents);
+		OnSurfaceChange(LastSurface, State.SurfaceType, State.SurfaceNormal);
+	}
+}
+
+void ASmartSpiderCharacter::SetQueryObjectsType(const TArray<TEnumAsByte<EObjectTypeQuery> >& InQueryObjectsType)
+{
+	QueryObjectsType = InQueryObjectsType;
+	RebuildProbeQueryParams();
+}
+
+void ASmartSpiderCharacter::SetActorsToIgnore(const TArray<AActor*>& InActorsToIgnore)
+{
+	ActorsToIgnore = InActorsToIgnore;
+	RebuildProbeQueryParams();
+}
+
+void ASmartSpiderCharacter::SetTraceComplex(bool bInTraceComplex)
+{
+	bTraceComplex = bInTraceComplex;
+	RebuildProbeQueryParams();
+}
+
+void ASmartSpiderCharacter::SetSensorRanges(float SightDistance, float HearingDistance)
+{
+	SightsDistanceSq = SightDistance * SightDistance;
+	HearingDistanceSq = HearingDistance * HearingDistance;
+
+	if (SwarmHandle.IsValid())
 	{
-		TraceEnvHandle(DeltaSeconds);
+		SwarmManager->UpdateSensorRanges(SwarmHandle, SightsDistanceSq, HearingDistanceSq);
 	}
 }
 
+void ASmartSpiderCharacter::SetActorSensed(AActor* Target, bool bSensed)
+{
+	// Called at every sight check, only changes wake dormant spiders.
+	if (bSensed)
+	{
+		if (!SensedActors.Contains(Target))
+		{
+			SensedActors.Add(Target);
+			WakeUp();
+			OnTargetSensed(Target);
+		}
+	}
+	else if (SensedActors.Remove(Target) > 0)
+	{
+		WakeUp();
+		OnTargetLost(Target);
+	}
+}
+
+void ASmartSpiderCharacter::HearNoise(const FVector& Location, float Loudness, AActor* NoiseInstigator)
+{
+	WakeUp();
+
+	OnNoiseHeard(Location, Loudness, NoiseInstigator);
+}
+
+void ASmartSpiderCharacter::RebuildProbeQueryParams()
+{
+	ProbeObjectQueryParams = FCollisionObjectQueryParams();
+	for (const TEnumAsByte<EObjectTypeQuery>& ObjectType : QueryObjectsType)
+	{
+		ProbeObjectQueryParams.AddObjectTypesToQuery(UEngineTypes::ConvertToCollisionChannel(ObjectType));
+	}
+
+	static const FName ProbeTraceTag(TEXT("SpiderProbe"));
+	ProbeQueryParams = FCollisionQueryParams(ProbeTraceTag, bTraceComplex, this);
+	ProbeQueryParams.AddIgnoredActors(ActorsToIgnore);
+	if (bIgnoreOtherSpiders)
+	{
+		ProbeQueryParams.IgnoreMask = (FMaskFilter)GetDefault<USmartSpiderSettings>()->SpiderMaskFilter;
+	}
+
+	ProbeDynamicQueryParams = ProbeQueryParams;
+	ProbeDynamicQueryParams.MobilityType = EQueryMobilityType::Dynamic;
+
+	// Stale handles were issued with old params.
+	bForceSyncProbes = true;
+	ProbeCache.Invalidate();
+}
+
+void ASmartSpiderCharacter::ApplySpiderMaskFilter()
+{
+	const FMaskFilter SpiderMaskFilter = (FMaskFilter)GetDefault<USmartSpiderSettings>()->SpiderMaskFilter;
+
+	TInlineComponentArray<UPrimitiveComponent*> Primitives(this);
+	for (UPrimitiveComponent* Primitive : Primitives)
+	{
+		Primitive->SetMaskFilterOnBodyInstance(SpiderMaskFilter);
+	}
+}
+
+#if ENABLE_DRAW_DEBUG
+void ASmartSpiderCharacter::DrawProbe(const FHitResult& Hit, const FVector& Start, const FVector& End, FLinearColor TraceColor, FLinearColor TraceHitColor) const
+{
+	if (!FSpiderDebugDraw::ShouldRecord(this)) return;
+
+	if (SwarmManager)
+	{
+		SwarmManager->GetDebugDraw().RecordProbe(this, Hit, Start, End, TraceColor, TraceHitColor);
+		return;
+	}
+
+	// Spider outside of swarm has no buffer to batch into, nearest spiders filter does not apply to it.
+	UWorld* World = GetWorld();
+	if (Hit.bBlockingHit)
+	{
+		DrawDebugLine(World, Start, Hit.ImpactPoint, TraceColor.ToFColor(true));
+		DrawDebugLine(World, Hit.ImpactPoint, End, TraceHitColor.ToFColor(true));
+		DrawDebugPoint(World, Hit.ImpactPoint, 16.f, TraceColor.ToFColor(true));
+	}
+	else
+	{
+		DrawDebugLine(World, Start, End, TraceColor.ToFColor(true));
+	}
+}
+#endif
+
 // Called when the game starts or when spawned
 void ASmartSpiderCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
 	InitTracingArgs();
+	bForceSyncProbes = true;
 
-	if (bForceStickToSurfaceAtBegin)
+	SpiderMovement->SetUseSurfaceReplication(bUseSurfaceReplication);
+	if (HasAuthority())
 	{
-		FHitResult HitResult;
-		FVector ActorLocation = GetActorLocation();
-		FVector EndLocation = ActorLocation - GetActorUpVector() * 100000000;
-		if (DoLineTrace(HitResult, ActorLocation, EndLocation, TracingColor_Center))
+		SetReplicateMovement(!bUseSurfaceReplication);
+
+		const float NetCullDistance = GetDefault<USmartSpiderSettings>()->SpiderNetCullDistance;
+		if (bUseSurfaceReplication && NetCullDistance > 0)
 		{
-			TransitionToSurface(CalcDesireStickLocation(HitResult.ImpactPoint, HitResult.ImpactNormal), HitResult.ImpactNormal);
+			NetCullDistanceSquared = FMath::Square(NetCullDistance);
+		}
+	}
+
+	if (bForceStickToSurfaceAtBegin && !IsSurfaceReplicatedProxy())
+	{
+		SnapToSurface(100000000);
+	}
+
+	// Swarm manager owns trace scheduler of the world, hero spiders use it as well.
+	SwarmManager = ASpiderSwarmManager::Get(GetWorld());
+	if (SwarmManager && bSimulateInSwarm)
+	{
+		SwarmManager->Register(this);
+	}
+
+	if (bUseSignificanceLOD && GetDefault<USmartSpiderSettings>()->bEnableSignificanceLOD)
+	{
+		if (USignificanceManager* SignificanceManager = USignificanceManager::Get(GetWorld()))
+		{
+			// Tier changes are applied on change only, so the initial tier is applied here.
+			ApplyLODTier(SignificanceTier);
+
+			auto SignificanceFunction = [](const UObject* Object, const FTransform& Viewpoint) -> float
+			{
+				return CastChecked<ASmartSpiderCharacter>(Object)->CalcSignificance(Viewpoint);
+			};
+
+			auto PostSignificanceFunction = [](const UObject* Object, float OldSignificance, float Significance, bool bFinal)
+			{
+				ASmartSpiderCharacter* Spider = const_cast<ASmartSpiderCharacter*>(CastChecked<ASmartSpiderCharacter>(Object));
+				Spider->SetSignificanceTier(GetDefault<USmartSpiderSettings>()->GetLODTierIndex(-Significance));
+			};
+
+			SignificanceManager->RegisterObject(this, SpiderSignificanceTag, SignificanceFunction, USignificanceManager::EPostSignificanceType::Sequential, PostSignificanceFunction);
+			bRegisteredSignificance = true;
 		}
 	}
 }
 
+void ASmartSpiderCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bDormant)
+	{
+		DEC_DWORD_STAT(STAT_SpiderDormant);
+		ReleaseDormantSurface();
+		bDormant = false;
+		bDormantMeshTick = false;
+	}
+
+	if (bRegisteredSignificance)
+	{
+		if (USignificanceManager* SignificanceManager = USignificanceManager::Get(GetWorld()))
+		{
+			SignificanceManager->UnregisterObject(this);
+		}
+		bRegisteredSignificance = false;
+	}
+
+	if (SwarmManager)
+	{
+		SwarmManager->Unregister(SwarmHandle);
+		SwarmManager = nullptr;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void ASmartSpiderCharacter::InitTracingArgs()
 {
+	ProbeParams.TracingOffset_Eye = TracingOffset_Eye;
+	ProbeParams.TracingOffset_Bottom = TracingOffset_Bottom;
+	ProbeParams.TracingOffset_BottomAssistor = TracingOffset_BottomAssistor;
+	ProbeParams.TracingDegreesOffset_ForwardBackward = TracingDegreesOffset_ForwardBackward;
+	ProbeParams.TracingDegreesOffset_LeftRight = TracingDegreesOffset_LeftRight;
+	ProbeParams.TracingDistance_Stick = TracingDistance_Stick;
+	ProbeParams.TracingDistance_Surface = TracingDistance_Surface;
+	ProbeParams.TracingDistanceTestToleranceSq = TracingDistanceTestToleranceSq;
+
+	ProbeSet.Build(ProbeParams);
+
+	TArray<FSpiderProbeRay> Rays;
+	if (bProbeLeftRight)
+	{
+#if WITH_EDITORONLY_DATA
+		Rays.Add(FSpiderProbeSet::MakeSideRay(ProbeParams, false, TracingColor_LeftSide));
+		Rays.Add(FSpiderProbeSet::MakeSideRay(ProbeParams, true, TracingColor_RightSide));
+#else
+		Rays.Add(FSpiderProbeSet::MakeSideRay(ProbeParams, false, FColor::Magenta));
+		Rays.Add(FSpiderProbeSet::MakeSideRay(ProbeParams, true, FColor::Orange));
+#endif
+	}
+	Rays.Append(CustomProbeRays);
+
+	for (const FSpiderProbeRay& Ray : Rays)
+	{
+		if (!ProbeSet.AddRay(Ray))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s has more than %d custom probe rays, the rest are ignored."), *GetName(), FSpiderProbeSet::MaxCustomRays);
+			break;
+		}
+	}
+
 	AcceptableDistanceSq_SurfaceDetected = CalcSurfaceTracingDistance().SizeSquared();
 	AcceptableDistanceSq_TransitionDetected = (GetCharacterMovement()->GetActorFeetLocation() - GetActorLocation()).SizeSquared();
+
+	if (SwarmHandle.IsValid())
+	{
+		SwarmManager->UpdateProbeParams(SwarmHandle, ProbeParams, AcceptableDistanceSq_SurfaceDetected, AcceptableDistanceSq_TransitionDetected);
+	}
 }
 
 FVector ASmartSpiderCharacter::CalcSurfaceTracingDistance()
 {
 	FVector EyePosition = GetEyePosition();
-	FVector EndPosition = EyePosition + GetTraceDirForward() * TracingDistance_Surface;
+	FVector EndPosition = EyePosition + GetTraceDirForward() * GetProbeParams().TracingDistance_Surface;
 	FVector PlaneLocation = GetCharacterMovement()->GetActorFeetLocation();
 	FPlane Plane(PlaneLocation, GetActorUpVector());
 
@@ -109,71 +741,140 @@ FVector ASmartSpiderCharacter::CalcSurfaceTracingDistance()
 	return FVector::ZeroVector;
 }
 
-bool ASmartSpiderCharacter::IsSurfaceConvex(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+bool ASmartSpiderCharacter::IsSurfaceConvex(const FTraceResult& Probes)
 {
-	//FAcceptableHitResult AssistorHitResult;
-	//TraceBottomAssistor(AssistorHitResult);
-
-	return bottom.AcceptableDistance == EAcceptableDistance::GreaterThan; //AssistorHitResult.bAcceptable;
+	return FSpiderSurfaceClassifier::IsSurfaceConvex(Probes);
 }
 
-bool ASmartSpiderCharacter::IsSurfaceConcave(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+bool ASmartSpiderCharacter::IsSurfaceConcave(const FTraceResult& Probes)
 {
-	return Forward.AcceptableDistance == EAcceptableDistance::LessThan;
+	return FSpiderSurfaceClassifier::IsSurfaceConcave(Probes);
 }
 
-bool ASmartSpiderCharacter::IsOnAir(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+bool ASmartSpiderCharacter::IsOnAir(const FTraceResult& Probes)
 {
-	return Forward.AcceptableDistance == EAcceptableDistance::GreaterThan && 
-			Backward.AcceptableDistance == EAcceptableDistance::GreaterThan && 
-			bottom.AcceptableDistance == EAcceptableDistance::GreaterThan;
+	return FSpiderSurfaceClassifier::IsOnAir(Probes);
 }
 
-bool ASmartSpiderCharacter::IsSurfacePlane(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+bool ASmartSpiderCharacter::IsSurfacePlane(const FTraceResult& Probes)
 {
-	FAcceptableHitResult AssistorHitResult;
-	TraceBottomAssistor(AssistorHitResult);
-
-	return AssistorHitResult.HitResult.bBlockingHit && 
-			bottom.HitResult.bBlockingHit && 
-			AssistorHitResult.HitResult.ImpactNormal.Equals(bottom.HitResult.ImpactNormal, 0.01f);
+	return FSpiderSurfaceClassifier::GetSurfaceType(Probes) == EEnvironmentSurface::Plane;
 }
 
-EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandlePlane(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandlePlane(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes)
 {
-	SurfaceNormal = bottom.HitResult.bBlockingHit? bottom.HitResult.ImpactNormal: FVector::UpVector;
-	bNeedStickToSurface = true;
+	SCOPE_CYCLE_COUNTER(STAT_SpiderHandlePlane);
+
+	const FHitResult& Bottom = Probes.HitResultBottom.HitResult;
+	SurfaceNormalState() = Bottom.bBlockingHit? Bottom.ImpactNormal: FVector::UpVector;
+	SetNeedStickToSurface(true);
 
 	return Surface;
 }
 
-EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandleConvex(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandleConvex(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes)
 {
-	OnCrossSurfaceBegin();
+	SCOPE_CYCLE_COUNTER(STAT_SpiderHandleConvex);
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SpiderBlueprintEvents);
+		OnCrossSurfaceBegin();
+	}
+
+	if (bUseEdgeTrajectories)
+	{
+		// Bottom probe usually lands on the far face, otherwise look for it once.
+		const FHitResult& Bottom = Probes.HitResultBottom.HitResult;
+		if (Bottom.bBlockingHit && StartEdgeTrajectory(Probes, Bottom.ImpactPoint, Bottom.ImpactNormal, true)) return Surface;
+
+		FHitResult Wrap;
+		if (TraceEdgeWrap(Probes, Wrap) && StartEdgeTrajectory(Probes, Wrap.ImpactPoint, Wrap.ImpactNormal, true)) return Surface;
+	}
 
+	// Offset once per fixed substep rather than per tick, the edge is crossed at the same pace at any tick rate.
 	if (bForwardOffsetWhenCrossWithConvexSurface)
 	{
-		AddActorLocalOffset(-GetActorForwardVector()*TracingOffset_BottomAssistor, false, nullptr, ETeleportType::TeleportPhysics);
+		float StepTime;
+		const int32 NumSubsteps = SpiderMovement->GetSurfaceSubsteps(DeltaTime, StepTime);
+		SpiderMovement->AddSurfaceOffset(-GetActorForwardVector() * TracingOffset_BottomAssistor * NumSubsteps);
 	}
 
 	FRotator LocalRotation = UKismetMathLibrary::MakeRotator(0, -TransitionRateInDegrees * DeltaTime, 0);
-	AddActorLocalRotation(LocalRotation, false, nullptr, ETeleportType::TeleportPhysics);
+	SpiderMovement->AddLocalSurfaceRotation(LocalRotation.Quaternion());
 
 	return Surface;
 }
 
-EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandleConcave(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandleConcave(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes)
 {
+	SCOPE_CYCLE_COUNTER(STAT_SpiderHandleConcave);
+
+	const FHitResult& Forward = Probes.HitResultForward.HitResult;
+	if (bUseEdgeTrajectories && StartEdgeTrajectory(Probes, Forward.ImpactPoint, Forward.ImpactNormal, false)) return Surface;
+
 	//SurfaceNormal = Forward.HitResult.ImpactNormal;
-	TransitionToSurface(GetActorLocation(), Forward.HitResult.ImpactNormal);
+	TransitionToSurface(GetActorLocation(), Probes.HitResultForward.HitResult.ImpactNormal);
 	return Surface;
 }
 
-EEnvironmentSurface ASmartSpiderCharacter::OnAirHandle(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+bool ASmartSpiderCharacter::StartEdgeTrajectory(const FTraceResult& Probes, const FVector& ToPoint, const FVector& ToNormal, bool bConvex)
+{
+	FVector FromPoint, FromNormal;
+	GetStandingPlane(Probes, FromPoint, FromNormal);
+
+	const FVector Velocity = GetVelocity();
+	const FVector Direction = Velocity.IsNearlyZero() ? GetActorForwardVector() : Velocity;
+
+	FSpiderEdgeTrajectory Trajectory;
+	if (!FSpiderEdgeTrajectory::Build(Trajectory, GetActorLocation(), Direction, FromPoint, FromNormal, ToPoint, ToNormal,
+		GetFeetOffset(), bConvex, ConcaveArcRadius, GetProbeParams().TracingDistance_Surface))
+	{
+		return false;
+	}
+
+	SpiderMovement->StartEdgeTrajectory(Trajectory);
+	INC_DWORD_STAT(STAT_SpiderEdgeTrajectories);
+
+	// Probes of the old plane are stale once spider lands.
+	bForceSyncProbes = true;
+	ProbeCache.Invalidate();
+	return true;
+}
+
+bool ASmartSpiderCharacter::TraceEdgeWrap(const FTraceResult& Probes, FHitResult& OutHit)
 {
+	FVector FromPoint, FromNormal;
+	GetStandingPlane(Probes, FromPoint, FromNormal);
+
+	FVector Start, End;
+	GetProbeSegment(ESpiderProbe::Bottom, Start, End);
+
+	// Bottom probe is past the edge where it goes below the plane, the far face is between there and spider.
+	const FPlane BelowPlane(FromPoint - FromNormal * GetFeetOffset(), FromNormal);
+	float Time;
+	FVector WrapStart;
+	if (!UKismetMathLibrary::LinePlaneIntersection(Start, End, BelowPlane, Time, WrapStart)) return false;
+
+	const FVector WrapEnd = WrapStart + FVector::VectorPlaneProject(GetActorLocation() - WrapStart, FromNormal);
+	return DoLineTrace(OutHit, WrapStart, WrapEnd, GetProbeColor((int32)ESpiderProbe::BottomAssistor));
+}
+
+void ASmartSpiderCharacter::GetStandingPlane(const FTraceResult& Probes, FVector& OutPoint, FVector& OutNormal) const
+{
+	const FHitResult& Center = Probes.HitResultCenter;
+	OutNormal = Center.bBlockingHit ? Center.ImpactNormal : GetActorUpVector();
+	OutPoint = Center.bBlockingHit ? Center.ImpactPoint : GetActorLocation() - OutNormal * GetFeetOffset();
+}
+
+EEnvironmentSurface ASmartSpiderCharacter::OnAirHandle(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderHandleOnAir);
+
 	if (bStickToSurfaceIfOnAir)
 	{
-		StickToSurface(bottom.HitResult.bBlockingHit ? bottom.HitResult.ImpactNormal : Forward.HitResult.bBlockingHit ? Forward.HitResult.ImpactNormal : FVector::UpVector);
+		const FHitResult& Forward = Probes.HitResultForward.HitResult;
+		const FHitResult& Bottom = Probes.HitResultBottom.HitResult;
+		StickToSurface(Bottom.bBlockingHit ? Bottom.ImpactNormal : Forward.bBlockingHit ? Forward.ImpactNormal : FVector::UpVector);
 	}
 
 	return Surface;
@@ -189,140 +890,309 @@ bool ASmartSpiderCharacter::IsStickAndAlignWithSurface(FVector QueryPosition, FV
 	return FMath::IsNearlyEqual(DistanceToActor, GetFeetOffset(), .1f);
 }
 
+void ASmartSpiderCharacter::SnapToSurface(float TraceDistance)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderSnapToSurface);
+
+	FHitResult HitResult;
+	FVector ActorLocation = GetActorLocation();
+	FVector EndLocation = ActorLocation - GetActorUpVector() * TraceDistance;
+	if (DoLineTrace(HitResult, ActorLocation, EndLocation, TracingColor_Center))
+	{
+		const FQuat Rotation = USpiderMovementComponent::MakeSurfaceRotation(GetActorQuat(), HitResult.ImpactNormal);
+		SetActorLocationAndRotation(CalcDesireStickLocation(HitResult.ImpactPoint, HitResult.ImpactNormal), Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+
+		SpiderMovement->SetSurface(HitResult.ImpactNormal, true);
+		SpiderMovement->StartWallWalking();
+	}
+}
+
 FVector ASmartSpiderCharacter::CalcDesireStickLocation(FVector QueryLocation, FVector InSurfaceNornal)
 {
 	return QueryLocation + InSurfaceNornal * GetFeetOffset();
 }
 
-void ASmartSpiderCharacter::RotationToMovement(float DeltaTime)
+EEnvironmentSurface ASmartSpiderCharacter::GetSurfaceType(const FTraceResult& Probes)
 {
-	//FRotator Rotation = GetActorRotation();
-	//GetCharacterMovement()->ComputeOrientToMovementRotation(Rotation, DeltaTime, );
+	return FSpiderSurfaceClassifier::GetSurfaceType(Probes);
+}
 
-	FVector MovementVel = GetVelocity();
-	if (MovementVel.Equals(FVector::ZeroVector)) return;
+void ASmartSpiderCharacter::TraceEnvHandle(float DeltaTime)
+{
+	FTraceResult Probes;
+	GatherProbes(Probes);
+	ClassifyProbes(Probes);
+	ApplySurface(DeltaTime, Probes);
+}
 
-	FTransform Trans = GetActorTransform();
-	FVector LocalMovementDir = UKismetMathLibrary::InverseTransformDirection(Trans, MovementVel.GetSafeNormal());
-	FVector DesireDir = FVector(LocalMovementDir.X, LocalMovementDir.Y, 0);
+void ASmartSpiderCharacter::GatherProbes(FTraceResult& OutProbes)
+{
+	FVector Starts[FSpiderProbeSet::MaxRays];
+	FVector Ends[FSpiderProbeSet::MaxRays];
+	ProbeSet.Transform(GetActorTransform(), Starts, Ends);
 
-	FVector InterpDir = UKismetMathLibrary::VLerp(FVector::ForwardVector, DesireDir, DeltaTime * RotateRateInDegrees);
-	FVector WorldDir = UKismetMathLibrary::TransformDirection(Trans, InterpDir.GetSafeNormal());
-	SetActorRotation(WorldDir.Rotation());
+	GatherProbes(OutProbes, Starts, Ends);
+}
 
+void ASmartSpiderCharacter::GatherProbes(FTraceResult& OutProbes, const FVector* Starts, const FVector* Ends)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderGatherProbes);
+	SCOPE_CYCLE_UOBJECT(Spider, this);
 
-	//FQuat Rotation = Trans.GetRotation();
-	//FQuat DesireRotation = FQuat::FastLerp(Rotation, FQuat(MovementVel.Rotation()), RotateRateInDegrees);
-	//SetActorRotation(DesireRotation);
+	bAsyncProbesReady = false;
+	bProbesFromCache = bUseProbeCache && ProbeCache.IsValidAt(GetActorLocation(), ProbeCacheDistance);
+	if (bProbesFromCache)
+	{
+		for (int32 Index = 0; bProbesFromCache && Index < ProbeSet.NumRays; ++Index)
+		{
+			bProbesFromCache = !IsProbeActive(Index) || ProbeCache.Synthesize(Starts[Index], Ends[Index], OutProbes.GetHit(Index));
+		}
+		if (bProbesFromCache)
+		{
+			INC_DWORD_STAT(STAT_SpiderProbeCacheHits);
+			return;
+		}
+
+		// Probe rays leave the cached plane, fall back to full probes.
+		ProbeCache.Invalidate();
+		OutProbes = FTraceResult();
+	}
+
+	bAsyncProbesReady = bUseAsyncTracing && !bForceSyncProbes && ConsumeAsyncProbes();
+	bForceSyncProbes = false;
+
+	if (!bAsyncProbesReady)
+	{
+		TraceProbeBatch(Starts, Ends, OutProbes);
+		return;
+	}
+
+	for (int32 Index = 0; Index < ProbeSet.NumRays; ++Index)
+	{
+		if (IsProbeActive(Index))
+		{
+			OutProbes.GetHit(Index) = AsyncProbeHits[Index];
+		}
+	}
 }
 
-EEnvironmentSurface ASmartSpiderCharacter::GetSurfaceType(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+void ASmartSpiderCharacter::TraceProbeBatch(const FVector* Starts, const FVector* Ends, FTraceResult& OutProbes)
 {
-	if (IsSurfaceConcave(Forward, Backward, bottom)) return EEnvironmentSurface::Concave;
+	SCOPE_CYCLE_COUNTER(STAT_SpiderProbeTraces);
+
+	if (!ProbeObjectQueryParams.IsValid()) return;
 
-	if (IsSurfaceConvex(Forward, Backward, bottom)) return EEnvironmentSurface::Convex;
+	const FSpiderDistanceFieldData* Field = FindProbeDistanceField();
+	int32 NumIssued = 0;
+	for (int32 Index = 0; Index < ProbeSet.NumRays; ++Index)
+	{
+		if (!IsProbeActive(Index)) continue;
+
+		FHitResult& Hit = OutProbes.GetHit(Index);
+		LineTraceProbe(Field, Hit, Starts[Index], Ends[Index], NumIssued);
+
+#if ENABLE_DRAW_DEBUG
+		if (FSpiderDebugDraw::IsEnabled())
+		{
+			DrawProbe(Hit, Starts[Index], Ends[Index], GetProbeColor(Index), FLinearColor::Green);
+		}
+#endif
+	}
 
-	return EEnvironmentSurface::Plane;
+	if (SwarmManager)
+	{
+		SwarmManager->GetTraceScheduler().NotifyTracesIssued(NumIssued);
+	}
 }
 
-void ASmartSpiderCharacter::TraceEnvHandle(float DeltaTime)
+const FSpiderDistanceFieldData* ASmartSpiderCharacter::FindProbeDistanceField() const
 {
-	bNeedStickToSurface = false;
-	SurfaceNormal = GetActorUpVector();
+	if (!bUseDistanceField || !SwarmManager) return nullptr;
 
-	FAcceptableHitResult HitResultForwarwd;
-	TraceForward(HitResultForwarwd);
+	const FSpiderProbeParams& Params = GetProbeParams();
+	const float Reach = FMath::Abs(Params.TracingOffset_Eye) + FMath::Max(Params.TracingDistance_Surface, Params.TracingDistance_Stick);
+	return SwarmManager->FindDistanceField(FBox::BuildAABB(GetActorLocation(), FVector(Reach)));
+}
 
-	FAcceptableHitResult HitResultBackward;
-	TraceBackward(HitResultBackward);
+bool ASmartSpiderCharacter::LineTraceProbe(const FSpiderDistanceFieldData* Field, FHitResult& OutHit, const FVector& Start, const FVector& End, int32& InOutNumTraces)
+{
+	UWorld* World = GetWorld();
+	if (!Field || !Field->Bounds.IsInside(Start) || !Field->Bounds.IsInside(End))
+	{
+		++InOutNumTraces;
+		return World->LineTraceSingleByObjectType(OutHit, Start, End, ProbeObjectQueryParams, ProbeQueryParams);
+	}
 
-	FAcceptableHitResult HitResultBottom;
-	TraceBottom(HitResultBottom);
+	INC_DWORD_STAT(STAT_SpiderDistanceFieldProbes);
+	Field->LineTrace(Start, End, OutHit);
 
-	EEnvironmentSurface CurrentSurface = GetSurfaceType(HitResultForwarwd, HitResultBackward, HitResultBottom);
-	CurrentSurface = OnSurfaceHandle(DeltaTime, CurrentSurface, HitResultForwarwd, HitResultBackward, HitResultBottom);
-	if (CurrentSurface != LastSurfaceType)
+	// Traces are shortened to the nearest hit so far, so a traced hit is always nearer.
+	FVector TraceEnd = OutHit.bBlockingHit ? OutHit.ImpactPoint : End;
+	auto UseTracedHit = [&](const FHitResult& TracedHit)
 	{
-		OnSurfaceChange(LastSurfaceType, CurrentSurface, SurfaceNormal);
-		if (LastSurfaceType == EEnvironmentSurface::Convex) 
+		OutHit = TracedHit;
+		OutHit.TraceEnd = End;
+		OutHit.Time = TracedHit.Distance / FVector::Dist(Start, End);
+		TraceEnd = TracedHit.ImpactPoint;
+	};
+
+	// Field holds only static bodies of baked object types, movable platforms of them are traced.
+	FHitResult DynamicHit;
+	++InOutNumTraces;
+	if (World->LineTraceSingleByObjectType(DynamicHit, Start, TraceEnd, ProbeObjectQueryParams, ProbeDynamicQueryParams))
+	{
+		UseTracedHit(DynamicHit);
+	}
+
+	const FCollisionObjectQueryParams UnbakedObjectQueryParams = GetUnbakedObjectQueryParams(*Field);
+	if (UnbakedObjectQueryParams.IsValid())
+	{
+		FHitResult UnbakedHit;
+		++InOutNumTraces;
+		if (World->LineTraceSingleByObjectType(UnbakedHit, Start, TraceEnd, UnbakedObjectQueryParams, ProbeQueryParams))
 		{
-			OnCrossSurfaceEnd();
+			UseTracedHit(UnbakedHit);
 		}
 	}
 
-	LastSurfaceType = CurrentSurface;
+	return OutHit.bBlockingHit;
+}
+
+void ASmartSpiderCharacter::ClassifyProbes(FTraceResult& Probes) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderClassifyProbes);
 
-	if (SurfaceNormal.Equals(FVector::UpVector))
+	FSpiderSurfaceClassifier::Classify(Probes, GetAcceptableDistanceSq_Surface(), GetProbeParams().TracingDistanceTestToleranceSq);
+}
+
+void ASmartSpiderCharacter::ApplySurface(float DeltaTime, FTraceResult& Probes)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderApplySurface);
+	SCOPE_CYCLE_UOBJECT(Spider, this);
+
+	ActiveProbes = &Probes;
+	ActiveDeltaTime = DeltaTime;
+	SetNeedStickToSurface(false);
+	SurfaceNormalState() = GetActorUpVector();
+
+	EEnvironmentSurface CurrentSurface = OnSurfaceHandle(DeltaTime, Probes.SurfaceType, Probes);
+	const EEnvironmentSurface LastSurface = LastSurfaceTypeState();
+	if (CurrentSurface != LastSurface)
 	{
-		Cast<UPrimitiveComponent>(GetRootComponent())->SetEnableGravity(true);
-		GetCharacterMovement()->SetMovementMode(MOVE_Walking);
-		GetCharacterMovement()->bOrientRotationToMovement = true;
+		IncSpiderTransitionStat(CurrentSurface);
+
+		SCOPE_CYCLE_COUNTER(STAT_SpiderBlueprintEvents);
+		OnSurfaceChange(LastSurface, CurrentSurface, SurfaceNormalState());
+		if (LastSurface == EEnvironmentSurface::Convex) 
+		{
+			OnCrossSurfaceEnd();
+		}
 	}
-	else
+
+	LastSurfaceTypeState() = CurrentSurface;
+
+	const FVector CurrentSurfaceNormal = SurfaceNormalState();
+	if (IsNeedStickToSurface())
 	{
-		Cast<UPrimitiveComponent>(GetRootComponent())->SetEnableGravity(false);
-		GetCharacterMovement()->SetMovementMode(MOVE_Flying);
-		GetCharacterMovement()->bOrientRotationToMovement = false;
+		StickToSurface(CurrentSurfaceNormal);
 	}
 
-	if (bNeedStickToSurface)
+	// Spider on the air holds on only if it found something to stick to.
+	const bool bAttached = CurrentSurface != EEnvironmentSurface::OnAir || SpiderMovement->HasPendingSurfaceTransition();
+	SpiderMovement->SetSurface(CurrentSurfaceNormal, bAttached);
+	if (bAttached && !SpiderMovement->IsWallWalking())
+	{
+		SpiderMovement->StartWallWalking();
+	}
+	else if (!bAttached && SpiderMovement->IsWallWalking())
 	{
-		StickToSurface(SurfaceNormal);
+		// Falls off ledges like a character, probes pick up the surface again once something is under the body.
+		SpiderMovement->SetMovementMode(MOVE_Falling);
 	}
 
 	if (bUseCustomRotationRate)
 	{
+		SCOPE_CYCLE_COUNTER(STAT_SpiderBlueprintEvents);
 		OnCustomRotationUpdate();
 	}
-	else
+	else if (CurrentLODTier.bSmoothRotation)
 	{
 		UpdateRotationRate();
 	}
 
-	if (bRotationToMovement && LastSurfaceType == EEnvironmentSurface::Plane) 
+	SpiderMovement->SetOrientToVelocity(bRotationToMovement && CurrentLODTier.bSmoothRotation && CurrentSurface == EEnvironmentSurface::Plane, RotateRateInDegrees);
+
+	if (bUseProbeCache)
 	{
-		RotationToMovement(DeltaTime);
+		UpdateProbeCache(CurrentSurface, Probes);
 	}
-}
 
-FTraceResult ASmartSpiderCharacter::TraceEnv()
-{
-	FAcceptableHitResult HitResultForwarwd;
-	TraceForward(HitResultForwarwd);
+	// Cached plane is expected to answer next frame as well, async probes would be wasted.
+	if (bUseAsyncTracing && !bProbesFromCache)
+	{
+		RequestAsyncProbes();
+	}
 
-	FAcceptableHitResult HitResultBackward;
-	TraceBackward(HitResultBackward);
+	// Whole probe block is only worth copying when animation reads it.
+	LastSurfaceBase = Probes.HitResultBottom.HitResult.Component;
+	if (bLegIKConsumer)
+	{
+		LastProbes = Probes;
+		LastProbesFrame = GFrameCounter;
+		bHasLastProbes = true;
+	}
 
-	FAcceptableHitResult HitResultBottom;
-	TraceBottom(HitResultBottom);
+	bAsyncProbesReady = false;
+	bProbesFromCache = false;
+	ActiveProbes = nullptr;
+}
 
-	EEnvironmentSurface SurfaceType = GetSurfaceType(HitResultForwarwd, HitResultBackward, HitResultBottom);
-	return FTraceResult(HitResultForwarwd, HitResultBackward, HitResultBottom, SurfaceType);
+FTraceResult ASmartSpiderCharacter::TraceEnv()
+{
+	FVector Starts[FSpiderProbeSet::MaxRays];
+	FVector Ends[FSpiderProbeSet::MaxRays];
+	ProbeSet.Transform(GetActorTransform(), Starts, Ends);
+
+	FTraceResult Probes;
+	TraceProbeBatch(Starts, Ends, Probes);
+	ClassifyProbes(Probes);
+	return Probes;
 }
 
 void ASmartSpiderCharacter::StickToSurface(FVector InSurfaceNormal)
 {
+	SCOPE_CYCLE_COUNTER(STAT_SpiderStickToSurface);
+
 	FHitResult HitResult;
-	if (TraceCenter(HitResult))
+	if (FetchStickProbe(HitResult))
 	{
 		if (!IsStickAndAlignWithSurface(HitResult.ImpactPoint, InSurfaceNormal))
 		{
-			FVector UpDir = GetActorUpVector();
-			FVector InterpNormal = UKismetMathLibrary::VInterpTo(UpDir, InSurfaceNormal, UGameplayStatics::GetWorldDeltaSeconds(this), StickToSurfaceSpeed);
+			// Blueprint callers outside of surface handlers stick by frame time.
+			const float DeltaTime = ActiveProbes ? ActiveDeltaTime : UGameplayStatics::GetWorldDeltaSeconds(this);
+			FVector InterpNormal = InterpSurfaceNormal(GetActorUpVector(), InSurfaceNormal, DeltaTime);
 			TransitionToSurface(CalcDesireStickLocation(HitResult.ImpactPoint, InterpNormal), InterpNormal);
 		}
 	}
 }
 
-void ASmartSpiderCharacter::TransitionToSurface(FVector TransitionLocation, FVector InSurfaceNormal)
+FVector ASmartSpiderCharacter::InterpSurfaceNormal(const FVector& Current, const FVector& Target, float DeltaTime) const
 {
-	FVector RightDir = GetActorRightVector();
-	FVector ForwardDir = FVector::CrossProduct(RightDir, InSurfaceNormal);
-	FVector DesireRightDir = FVector::CrossProduct(InSurfaceNormal, ForwardDir);
+	float StepTime;
+	const int32 NumSubsteps = SpiderMovement->GetSurfaceSubsteps(DeltaTime, StepTime);
 
-	FRotator Rotation = UKismetMathLibrary::MakeRotationFromAxes(ForwardDir, DesireRightDir, InSurfaceNormal);
-	FTransform DesireTransform = FTransform(Rotation, TransitionLocation);
-	SetActorTransform(DesireTransform, false, nullptr, ETeleportType::TeleportPhysics);
+	FVector Normal = Current;
+	for (int32 Substep = 0; Substep < NumSubsteps; ++Substep)
+	{
+		Normal = UKismetMathLibrary::VInterpTo(Normal, Target, StepTime, StickToSurfaceSpeed);
+	}
+
+	return Normal;
+}
+
+void ASmartSpiderCharacter::TransitionToSurface(FVector TransitionLocation, FVector InSurfaceNormal)
+{
+	SpiderMovement->RequestSurfaceTransition(TransitionLocation, InSurfaceNormal);
 }
 
 void ASmartSpiderCharacter::UpdateRotationRate()
@@ -333,11 +1203,11 @@ void ASmartSpiderCharacter::UpdateRotationRate()
 
 bool ASmartSpiderCharacter::TraceForward(FAcceptableHitResult& OutHitResult)
 {
-	FVector EyePos = GetEyePosition();
-	FVector EndPos = EyePos + GetTraceDirForward() * TracingDistance_Surface;
+	FVector EyePos, EndPos;
+	GetProbeSegment(ESpiderProbe::Forward, EyePos, EndPos);
 	if (DoLineTrace(OutHitResult.HitResult, EyePos, EndPos, TracingColor_Forward))
 	{
-		OutHitResult.TestAgainstHitResult(AcceptableDistanceSq_SurfaceDetected, TracingDistanceTestToleranceSq);
+		OutHitResult.TestAgainstHitResult(GetAcceptableDistanceSq_Surface(), GetProbeParams().TracingDistanceTestToleranceSq);
 	}
 
 	return OutHitResult.HitResult.bBlockingHit;
@@ -345,11 +1215,11 @@ bool ASmartSpiderCharacter::TraceForward(FAcceptableHitResult& OutHitResult)
 
 bool ASmartSpiderCharacter::TraceBackward(FAcceptableHitResult& OutHitResult)
 {
-	FVector EyePos = GetEyePosition();
-	FVector EndPos = EyePos + GetTraceDirBackward() * TracingDistance_Surface;
+	FVector EyePos, EndPos;
+	GetProbeSegment(ESpiderProbe::Backward, EyePos, EndPos);
 	if (DoLineTrace(OutHitResult.HitResult, EyePos, EndPos, TracingColor_Backward))
 	{
-		OutHitResult.TestAgainstHitResult(AcceptableDistanceSq_SurfaceDetected, TracingDistanceTestToleranceSq);
+		OutHitResult.TestAgainstHitResult(GetAcceptableDistanceSq_Surface(), GetProbeParams().TracingDistanceTestToleranceSq);
 	}
 
 	return OutHitResult.HitResult.bBlockingHit;
@@ -357,18 +1227,18 @@ bool ASmartSpiderCharacter::TraceBackward(FAcceptableHitResult& OutHitResult)
 
 bool ASmartSpiderCharacter::TraceCenter(FHitResult& OutHitResult)
 {
-	FVector ActorLocation = GetActorLocation();
-	FVector EndLocation = ActorLocation - GetActorUpVector() * TracingDistance_Stick;
+	FVector ActorLocation, EndLocation;
+	GetProbeSegment(ESpiderProbe::Center, ActorLocation, EndLocation);
 	return DoLineTrace(OutHitResult, ActorLocation, EndLocation, TracingColor_Center);
 }
 
 bool ASmartSpiderCharacter::TraceBottom(FAcceptableHitResult& OutHitResult)
 {
-	FVector BottomLocation = GetBottomLocation();
-	FVector EndLocation = BottomLocation - GetActorUpVector() * TracingDistance_Surface;
+	FVector BottomLocation, EndLocation;
+	GetProbeSegment(ESpiderProbe::Bottom, BottomLocation, EndLocation);
 	if (DoLineTrace(OutHitResult.HitResult, BottomLocation, EndLocation, TracingColor_Bottom))
 	{
-		OutHitResult.TestAgainstHitResult(AcceptableDistanceSq_SurfaceDetected, TracingDistanceTestToleranceSq);
+		OutHitResult.TestAgainstHitResult(GetAcceptableDistanceSq_Surface(), GetProbeParams().TracingDistanceTestToleranceSq);
 	}
 
 	return OutHitResult.HitResult.bBlockingHit;
@@ -376,16 +1246,161 @@ bool ASmartSpiderCharacter::TraceBottom(FAcceptableHitResult& OutHitResult)
 
 bool ASmartSpiderCharacter::TraceBottomAssistor(FAcceptableHitResult& OutHitResult)
 {
-	FVector BottomLocation = GetBottomAssistorLocation();
-	FVector EndLocation = BottomLocation - GetActorUpVector() * TracingDistance_Surface;
+	FVector BottomLocation, EndLocation;
+	GetProbeSegment(ESpiderProbe::BottomAssistor, BottomLocation, EndLocation);
 	if (DoLineTrace(OutHitResult.HitResult, BottomLocation, EndLocation, TracingColor_BottomAssistor))
 	{
-		OutHitResult.TestAgainstHitResult(AcceptableDistanceSq_SurfaceDetected, TracingDistanceTestToleranceSq);
+		OutHitResult.TestAgainstHitResult(GetAcceptableDistanceSq_Surface(), GetProbeParams().TracingDistanceTestToleranceSq);
 	}
 
 	return OutHitResult.HitResult.bBlockingHit;
 }
 
+FLinearColor ASmartSpiderCharacter::GetProbeColor(int32 RayIndex) const
+{
+	if (RayIndex >= (int32)ESpiderProbe::Count)
+	{
+		return ProbeSet.CustomColors[RayIndex - (int32)ESpiderProbe::Count];
+	}
+
+#if WITH_EDITORONLY_DATA
+	switch ((ESpiderProbe)RayIndex)
+	{
+		case ESpiderProbe::Forward: return TracingColor_Forward;
+		case ESpiderProbe::Backward: return TracingColor_Backward;
+		case ESpiderProbe::Bottom: return TracingColor_Bottom;
+		case ESpiderProbe::BottomAssistor: return TracingColor_BottomAssistor;
+		case ESpiderProbe::Center: return TracingColor_Center;
+		default: break;
+	}
+#endif
+
+	return FLinearColor::Red;
+}
+
+bool ASmartSpiderCharacter::FetchStickProbe(FHitResult& OutHit)
+{
+	FVector Start, End;
+	GetProbeSegment(ESpiderProbe::Center, Start, End);
+
+	if (!ActiveProbes)
+	{
+		return DoLineTrace(OutHit, Start, End, GetProbeColor((int32)ESpiderProbe::Center));
+	}
+
+	OutHit = ActiveProbes->HitResultCenter;
+	if (OutHit.bBlockingHit && !FMath::IsNearlyZero(FVector::DotProduct(End - Start, OutHit.ImpactNormal)))
+	{
+		// Async probes were issued at last frame, re-project the hit plane on current ray, otherwise sticking will drag spider back by one frame of movement.
+		FVector ImpactPoint = FMath::LinePlaneIntersection(Start, End, OutHit.ImpactPoint, OutHit.ImpactNormal);
+		OutHit.TraceStart = Start;
+		OutHit.TraceEnd = End;
+		OutHit.ImpactPoint = ImpactPoint;
+		OutHit.Location = ImpactPoint;
+	}
+
+	return OutHit.bBlockingHit;
+}
+
+void ASmartSpiderCharacter::RequestAsyncProbes()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderAsyncProbes);
+
+	UWorld* World = GetWorld();
+	if (!World) return;
+
+	if (!ProbeObjectQueryParams.IsValid()) return;
+
+	// Field probes only trace bodies missing from the field, cheap enough to stay synchronous.
+	if (FindProbeDistanceField())
+	{
+		for (FTraceHandle& Handle : AsyncProbeHandles)
+		{
+			Handle = FTraceHandle();
+		}
+		return;
+	}
+
+	FVector Starts[FSpiderProbeSet::MaxRays];
+	FVector Ends[FSpiderProbeSet::MaxRays];
+	ProbeSet.Transform(GetActorTransform(), Starts, Ends);
+
+	int32 NumRequested = 0;
+	for (int32 Index = 0; Index < ProbeSet.NumRays; ++Index)
+	{
+		if (!IsProbeActive(Index))
+		{
+			AsyncProbeHandles[Index] = FTraceHandle();
+			continue;
+		}
+
+		AsyncProbeHandles[Index] = World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, Starts[Index], Ends[Index], ProbeObjectQueryParams, ProbeQueryParams);
+		++NumRequested;
+	}
+
+	if (SwarmManager)
+	{
+		SwarmManager->GetTraceScheduler().NotifyTracesIssued(NumRequested);
+	}
+}
+
+void ASmartSpiderCharacter::UpdateProbeCache(EEnvironmentSurface CurrentSurface, const FTraceResult& Probes)
+{
+	if (CurrentSurface != EEnvironmentSurface::Plane)
+	{
+		ProbeCache.Invalidate();
+		return;
+	}
+
+	// Keep the anchor, so cache expires after moving @ProbeCacheDistance.
+	if (bProbesFromCache) return;
+
+	const FHitResult& Forward = Probes.HitResultForward.HitResult;
+	const FHitResult& Backward = Probes.HitResultBackward.HitResult;
+	const FHitResult& Bottom = Probes.HitResultBottom.HitResult;
+
+	const float PlaneTolerance = 1.f;
+	const float BottomPlaneDistance = FVector::DotProduct(Bottom.ImpactNormal, Bottom.ImpactPoint);
+	const bool bSamePlane = Forward.bBlockingHit && Backward.bBlockingHit && Bottom.bBlockingHit &&
+							Forward.Component == Bottom.Component && Backward.Component == Bottom.Component &&
+							Forward.ImpactNormal.Equals(Bottom.ImpactNormal, 0.01f) && Backward.ImpactNormal.Equals(Bottom.ImpactNormal, 0.01f) &&
+							FMath::IsNearlyEqual(FVector::DotProduct(Bottom.ImpactNormal, Forward.ImpactPoint), BottomPlaneDistance, PlaneTolerance) &&
+							FMath::IsNearlyEqual(FVector::DotProduct(Bottom.ImpactNormal, Backward.ImpactPoint), BottomPlaneDistance, PlaneTolerance);
+
+	if (bSamePlane)
+	{
+		ProbeCache.Store(Bottom, GetActorLocation());
+	}
+	else
+	{
+		ProbeCache.Invalidate();
+	}
+}
+
+bool ASmartSpiderCharacter::ConsumeAsyncProbes()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderAsyncProbes);
+
+	UWorld* World = GetWorld();
+	if (!World) return false;
+
+	// Handles issued more than one frame ago are expired, e.g. spider did not trace since it stopped moving.
+	for (int32 Index = 0; Index < ProbeSet.NumRays; ++Index)
+	{
+		if (!IsProbeActive(Index))
+		{
+			AsyncProbeHits[Index] = FHitResult();
+			continue;
+		}
+
+		if (!World->QueryTraceData(AsyncProbeHandles[Index], AsyncTraceDatum)) return false;
+
+		AsyncProbeHits[Index] = AsyncTraceDatum.OutHits.Num() > 0 ? AsyncTraceDatum.OutHits[0] : FHitResult(AsyncTraceDatum.Start, AsyncTraceDatum.End);
+	}
+
+	return true;
+}
+
 #if WITH_EDITOR
 void ASmartSpiderCharacter::PostEditChangeProperty(struct FPropertyChangedEvent& PropertyChangedEvent)
 {
@@ -397,9 +1412,22 @@ void ASmartSpiderCharacter::PostEditChangeProperty(struct FPropertyChangedEvent&
 		if (PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, SightsDistanceSq)))
 		{
 			SightsSensorRadius->SetSphereRadius(FMath::Sqrt(SightsDistanceSq));
+			SetSensorRanges(FMath::Sqrt(SightsDistanceSq), FMath::Sqrt(HearingDistanceSq));
 		}else if (PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, HearingDistanceSq)))
 		{
 			HearingSensorRadius->SetSphereRadius(FMath::Sqrt(HearingDistanceSq));
+			SetSensorRanges(FMath::Sqrt(SightsDistanceSq), FMath::Sqrt(HearingDistanceSq));
+		}else if (PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, QueryObjectsType)) ||
+				PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, ActorsToIgnore)) ||
+				PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, bTraceComplex)) ||
+				PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, bIgnoreOtherSpiders)))
+		{
+			RebuildProbeQueryParams();
+		}else if (HasActorBegunPlay() && 
+				(PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, bProbeLeftRight)) ||
+				PropertyName.Equals(GET_MEMBER_NAME_STRING_CHECKED(ASmartSpiderCharacter, CustomProbeRays))))
+		{
+			InitTracingArgs();
 		}
 	}
 }
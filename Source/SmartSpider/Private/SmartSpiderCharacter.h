@@ -6,50 +6,13 @@
 #include "EnvironmentTraceHit.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "WorldCollision.h"
+#include "SpiderSwarmManager.h"
+#include "SmartSpiderSettings.h"
+#include "SpiderReplication.h"
 #include "SmartSpiderCharacter.generated.h"
 
-/* Only draw tracing rays in case of editor. */
-#if WITH_EDITOR
-	#define ENV_TRACE_TYPE EDrawDebugTrace::ForOneFrame
-#else
-	#define ENV_TRACE_TYPE EDrawDebugTrace::None
-#endif
-
-USTRUCT(BlueprintType)
-struct FTraceResult
-{
-	GENERATED_USTRUCT_BODY()
-
-	UPROPERTY(EditAnywhere)
-	FAcceptableHitResult HitResultForward;
-
-	UPROPERTY(EditAnywhere)
-	FAcceptableHitResult HitResultBackward;
-
-	UPROPERTY(EditAnywhere)
-	FAcceptableHitResult HitResultBottom;
-
-	UPROPERTY(EditAnywhere)
-	EEnvironmentSurface SurfaceType;
-
-	FTraceResult(FAcceptableHitResult Forward, FAcceptableHitResult Backward, FAcceptableHitResult bottom, EEnvironmentSurface TargetSurface)
-	{
-		HitResultForward = Forward;
-		HitResultBackward = Backward;
-		HitResultBottom = bottom;
-
-		SurfaceType = TargetSurface;
-	}
-
-	FTraceResult()
-	{
-		HitResultForward = FAcceptableHitResult();
-		HitResultBackward = FAcceptableHitResult();
-		HitResultBottom = FAcceptableHitResult();
-
-		SurfaceType = EEnvironmentSurface::Plane;
-	}
-};
+class USpiderMovementComponent;
 
 /*
 * Smart Spider climbing without surface limited.
@@ -59,27 +22,56 @@ class SMARTSPIDER_API ASmartSpiderCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
+	friend class ASpiderSwarmManager;
+	friend class FSpiderAgentSystem;
+
 protected:
-	/* Objects will tracing when query the world. */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Environment Tracing")
+	/* Objects will tracing when query the world. Use @SetQueryObjectsType at runtime. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing")
 	TArray<TEnumAsByte<EObjectTypeQuery> > QueryObjectsType;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Environment Tracing")
+	/* Use @SetTraceComplex at runtime. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing")
 	uint32 bTraceComplex: 1;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Environment Tracing")
+	/* Use @SetActorsToIgnore at runtime. Other spiders are ignored by @bIgnoreOtherSpiders, no need to add them. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing")
 	TArray<AActor*> ActorsToIgnore;
 
+	/* Probes pass through other spiders, by the mask filter of spider bodies. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing")
+	uint32 bIgnoreOtherSpiders : 1;
+
+	/* 
+	* Probe baked distance fields of static collision where a distance field volume covers spider.
+	* Movable bodies and object types not baked into the field are still traced, against far fewer bodies.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Distance Field")
+	uint32 bUseDistanceField : 1;
+
+	/* Simulated proxies follow quantized surface state instead of replicated movement of character, and do not trace environment. Opt-in, replaces movement replication. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Replication")
+	uint32 bUseSurfaceReplication : 1;
+
+	UPROPERTY(Transient, ReplicatedUsing = OnRep_SurfaceState)
+	FSpiderReplicatedSurfaceState ReplicatedSurfaceState;
+
+	UFUNCTION()
+	void OnRep_SurfaceState();
+
+	/* Fill @ReplicatedSurfaceState and scale net update frequency by distance to the nearest viewer. */
+	void UpdateReplicatedSurfaceState();
+
 	/* Interpolation speed when needs stick to surface. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Environment Tracing|Character Ability")
 	float StickToSurfaceSpeed;
 
-	/* How far spider can see. In square. */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Environment Tracing|Sensor")
+	/* How far spider can see. In square. Sensed by perception of swarm manager, use @SetSensorRanges at runtime. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing|Sensor")
 	float SightsDistanceSq;
 
-	/* How far spider can hear. In square. */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Environment Tracing|Sensor")
+	/* How far spider can hear. In square. Use @SetSensorRanges at runtime. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing|Sensor")
 	float HearingDistanceSq;
 
 	/* Force spider stick to surface at begin when spawn on the air. */
@@ -102,6 +94,17 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Character Ability")
 	uint32 bForwardOffsetWhenCrossWithConvexSurface : 1;
 
+	/* 
+	* Cross convex edges and concave corners along an arc built from probe hits, without probing until spider lands on the other plane.
+	* Falls back to rotating by @TransitionRateInDegrees when the edge can not be built from hits.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Character Ability")
+	uint32 bUseEdgeTrajectories : 1;
+
+	/* Radius of arc body turns along in concave corners, convex edges turn around the edge by feet offset. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Character Ability", meta = (EditCondition = "bUseEdgeTrajectories", ClampMin = "1.0"))
+	float ConcaveArcRadius;
+
 	/* Should disable movement when spider cross the surface. Disable for get more nature behavior. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Character Ability")
 	uint32 bDisableMovementWhenTransition:1;
@@ -116,6 +119,45 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Character Ability")
 	uint32 bStickToSurfaceIfOnAir : 1;
 
+	/* 
+	* Let swarm manager trace environment of this spider within one batched pass instead of per-actor tick.
+	* Actor tick keeps running for blueprints. Disable for single hero spiders.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Swarm")
+	uint32 bSimulateInSwarm : 1;
+
+	/* Reduce simulation fidelity by significance to players, see project settings of smart spider. Disable for hero spiders. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|LOD")
+	uint32 bUseSignificanceLOD : 1;
+
+	/* 
+	* Disable actor, movement and mesh ticks once spider stood still on a surface for @DormancyIdleTime, e.g. ambush spiders.
+	* Woken by movement input, move requests, perception, damage or its surface moving.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Dormancy")
+	uint32 bUseDormancy : 1;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Dormancy", meta = (EditCondition = "bUseDormancy", ClampMin = "0.0"))
+	float DormancyIdleTime;
+
+	/* 
+	* Issue environment probes through world async trace and consume the results at next frame.
+	* Falls back to synchronous probes when spider just spawned or teleported.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Async")
+	uint32 bUseAsyncTracing : 1;
+
+	/* Answer probes from the last plane instead of tracing, while spider walks on the same plane. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Cache")
+	uint32 bUseProbeCache : 1;
+
+	/* 
+	* How far spider can move along cached plane before probing again.
+	* Edges of the plane are detected at most this distance late.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Cache", meta = (EditCondition = "bUseProbeCache", ClampMin = "0.0"))
+	float ProbeCacheDistance;
+
 	/* 
 	* Offset from eye position to actor location.(EyePosition = Offset + ActorLocation).
 	* Mostly, sets as half of character hight with a little offset. 
@@ -151,6 +193,17 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing|Tracing Distance")
 	float TracingDistanceTestToleranceSq;
 
+	/* Add left and right probes from eye position, tilted by @TracingDegreesOffset_LeftRight. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Custom Probes")
+	uint32 bProbeLeftRight : 1;
+
+	/* 
+	* Extra rays traced in the same batch as the built-in probes, hits are in @FTraceResult::CustomHits.
+	* Left and right probes take the first slots if enabled. At most FSpiderProbeSet::MaxCustomRays in total.
+	*/
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, AdvancedDisplay, category = "Environment Tracing|Custom Probes")
+	TArray<FSpiderProbeRay> CustomProbeRays;
+
 #if WITH_EDITORONLY_DATA // Debug Only with editor
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Environment Tracing|Debug")
 	FColor TracingColor_Forward;
@@ -188,9 +241,11 @@ protected:
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Environment Tracing|Runtime")
 	float AcceptableDistanceSq_SurfaceDetected;
 
+	/* Owned by swarm manager while simulated in swarm, use @GetCurrentSurfaceType instead. */
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, category = "Environment Tracing|Runtime")
 	EEnvironmentSurface LastSurfaceType;
 
+	/* Owned by swarm manager while simulated in swarm, use @GetCurrentSurfaceNormal instead. */
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, category = "Environment Tracing|Runtime")
 	FVector SurfaceNormal;
 
@@ -200,46 +255,338 @@ protected:
 	UPROPERTY(VisibleInstanceOnly, BlueprintReadWrite, category = "Runtime|Animation")
 	uint32 bDeath : 1;
 
+	/* Actors in sight range with line of sight at the last check. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Transient, category = "Environment Tracing|Sensor")
+	TArray<AActor*> SensedActors;
+
+	/* Significance LOD tier, 0 for full fidelity. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Environment Tracing|Runtime")
+	int32 SignificanceTier;
+
+	/* Character movement of spider, surface following is integrated by its wall walking mode. */
+	UPROPERTY(Transient)
+	USpiderMovementComponent* SpiderMovement;
+
+	/* Fidelity of @SignificanceTier. */
+	FSpiderLODTier CurrentLODTier;
+
+	/* Frame time accumulated since last environment tracing. */
+	float EnvDeltaTime;
+
+	uint32 bRegisteredSignificance : 1;
+
+	UPROPERTY(Transient)
+	ASpiderSwarmManager* SwarmManager;
+
+	/* Valid while simulated by @SwarmManager. */
+	FSpiderSwarmHandle SwarmHandle;
+
+	/* Probe tuning gathered from tracing offsets and distances. */
+	FSpiderProbeParams ProbeParams;
+
+	/* Probe rays built from @ProbeParams and custom rays. */
+	FSpiderProbeSet ProbeSet;
+
+	/* Probe result block being applied, so surface handlers read probes instead of tracing again. */
+	const FTraceResult* ActiveProbes;
+
+	/* Time step of probe result block being applied. */
+	float ActiveDeltaTime;
+
+	/* Query params of probes, rebuilt only when query objects, ignored actors or complex tracing change. */
+	FCollisionObjectQueryParams ProbeObjectQueryParams;
+	FCollisionQueryParams ProbeQueryParams;
+
+	/* Probe params limited to movable bodies, the rest of baked object types is in distance field. */
+	FCollisionQueryParams ProbeDynamicQueryParams;
+
+	/* Async probes requested at last frame. */
+	FTraceHandle AsyncProbeHandles[FSpiderProbeSet::MaxRays];
+
+	/* Async probes result consumed at current frame. */
+	FHitResult AsyncProbeHits[FSpiderProbeSet::MaxRays];
+
+	/* Reused when consuming async probes to keep its hits allocation. */
+	FTraceDatum AsyncTraceDatum;
+
+	/* Whether @AsyncProbeHits is valid while handling environment tracing. */
+	uint32 bAsyncProbesReady : 1;
+
+	/* Force synchronous probes at next environment tracing, e.g. just spawned or teleported. */
+	uint32 bForceSyncProbes : 1;
+
+	FSpiderProbeCache ProbeCache;
+
+	/* Whether probes are answered by @ProbeCache while handling environment tracing. */
+	uint32 bProbesFromCache : 1;
+
+	/* Hidden and inert in agent pool of swarm manager. */
+	uint32 bPooled : 1;
+
+	/* Ticks disabled until woken, see @bUseDormancy. */
+	uint32 bDormant : 1;
+
+	/* Mesh ticked when spider went dormant, so waking does not enable a mesh paused by others. */
+	uint32 bDormantMeshTick : 1;
+
+	/* Time spider stood still, reset by any movement. */
+	float IdleTime;
+
+	/* Movable surface dormant spider stands on, wakes spider once moved. */
+	TWeakObjectPtr<UPrimitiveComponent> DormantSurface;
+	FDelegateHandle DormantSurfaceMovedHandle;
+
+	bool CanEnterDormancy() const;
+	void EnterDormancy();
+	void ReleaseDormantSurface();
+	void OnDormantSurfaceMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	/* Probes applied at @LastProbesFrame, copied only for leg placement of animation, see @bLegIKConsumer. */
+	FTraceResult LastProbes;
+	uint64 LastProbesFrame;
+	uint32 bHasLastProbes : 1;
+	uint32 bLegIKConsumer : 1;
+
+	/* Component under body at last applied probes, base of dormancy and replication. */
+	TWeakObjectPtr<UPrimitiveComponent> LastSurfaceBase;
+
 public:
 	// Sets default values for this character's properties
-	ASmartSpiderCharacter();
+	ASmartSpiderCharacter(const FObjectInitializer& ObjectInitializer);
 
 
 	virtual void Tick(float DeltaSeconds) override;
 
+	virtual void AddMovementInput(FVector WorldDirection, float ScaleValue = 1.0f, bool bForce = false) override;
+	virtual void LaunchCharacter(FVector LaunchVelocity, bool bXYOverride, bool bZOverride) override;
+	virtual float TakeDamage(float DamageAmount, struct FDamageEvent const& DamageEvent, class AController* EventInstigator, AActor* DamageCauser) override;
+
+	virtual void TeleportSucceeded(bool bIsATest) override;
+	virtual void PostInitializeComponents() override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	UFUNCTION(BlueprintCallable, category = "SmartSpider")
+	void SetQueryObjectsType(const TArray<TEnumAsByte<EObjectTypeQuery> >& InQueryObjectsType);
+
+	UFUNCTION(BlueprintCallable, category = "SmartSpider")
+	void SetActorsToIgnore(const TArray<AActor*>& InActorsToIgnore);
+
+	UFUNCTION(BlueprintCallable, category = "SmartSpider")
+	void SetTraceComplex(bool bInTraceComplex);
+
+	/* Distances are not squared. */
+	UFUNCTION(BlueprintCallable, category = "SmartSpider|Perception")
+	void SetSensorRanges(float SightDistance, float HearingDistance);
+
+	UFUNCTION(BlueprintPure, category = "SmartSpider|Perception")
+	bool IsActorSensed(AActor* Target) const { return SensedActors.Contains(Target); }
+
+	FORCEINLINE const TArray<AActor*>& GetSensedActors() const { return SensedActors; }
+
+	/* Called by perception of swarm manager, fires sensed and lost events on change. */
+	void SetActorSensed(AActor* Target, bool bSensed);
+	void HearNoise(const FVector& Location, float Loudness, AActor* NoiseInstigator);
+
+	/* Environment tracing part of tick, called by swarm manager when simulated in swarm. */
+	void SimulateEnv(float DeltaSeconds);
+
+	/* Count idle time and go dormant once it reaches @DormancyIdleTime, called every simulated frame. */
+	void UpdateDormancy(float DeltaSeconds);
+
+	/* Restore ticks of dormant spider and restart idle time, no-op for awake spiders besides that. */
+	UFUNCTION(BlueprintCallable, category = "SmartSpider")
+	void WakeUp();
+
+	UFUNCTION(BlueprintPure, category = "SmartSpider")
+	bool IsDormant() const { return !!bDormant; }
+
+	FORCEINLINE bool ShouldTraceEnv() const { return !bTracingEnvWithHasVelocityOnly || GetVelocity().SizeSquared() > 0; }
+
+	/* Accumulate frame time, returns true if environment should be traced at this frame according to LOD tier. */
+	bool PrepareEnvTracing(float DeltaSeconds);
+	FORCEINLINE float ConsumeEnvDeltaTime() { const float DeltaTime = EnvDeltaTime; EnvDeltaTime = 0; return DeltaTime; }
+
+	/* Traces spider expects to issue at next environment tracing, acquired from trace scheduler. */
+	int32 GetExpectedProbeCost() const;
+
+	/* Keep moving along last surface plane while trace scheduler defers spider. */
+	void ExtrapolateOnSurface();
+
+	/* Significance of spider to a viewpoint, the higher the nearer. Called on worker threads. */
+	float CalcSignificance(const FTransform& Viewpoint) const;
+
+	/* Apply fidelity of LOD tier, re-snap to surface when promoted back to full fidelity. */
+	void SetSignificanceTier(int32 NewTier);
+
+	/* Copy LOD tier from project settings and apply its tick interval, false if tier is not configured. */
+	bool ApplyLODTier(int32 Tier);
+
+	/* 
+	* Environment tracing is split into three phases:
+	* gather probes on game thread, classify probes without touching actor(any thread), apply the surface on game thread.
+	*/
+	void GatherProbes(FTraceResult& OutProbes);
+
+	/* Gather with world probe segments computed by caller, e.g. by probe kernels of swarm manager. */
+	void GatherProbes(FTraceResult& OutProbes, const FVector* Starts, const FVector* Ends);
+	void ClassifyProbes(FTraceResult& Probes) const;
+	void ApplySurface(float DeltaTime, FTraceResult& Probes);
+
+	UFUNCTION(BlueprintPure, category = "SmartSpider")
+	EEnvironmentSurface GetCurrentSurfaceType() const;
+
+	UFUNCTION(BlueprintPure, category = "SmartSpider")
+	FVector GetCurrentSurfaceNormal() const;
+
+	FORCEINLINE bool IsSimulatedInSwarm() const { return SwarmHandle.IsValid(); }
+
+	/* Take over state of lightweight agent when promoted. */
+	void ActivateFromPool(const FTransform& Transform, const FVector& Velocity, EEnvironmentSurface Surface, const FVector& InSurfaceNormal);
+
+	/* Hide and stop simulation, the agent takes over from here. */
+	void DeactivateToPool();
+
+	FORCEINLINE bool IsPooled() const { return !!bPooled; }
+
+	/* Client copy of server spider, moved by replicated surface state. */
+	FORCEINLINE bool IsSurfaceReplicatedProxy() const { return bUseSurfaceReplication && Role == ROLE_SimulatedProxy; }
+
+	FORCEINLINE USpiderMovementComponent* GetSpiderMovement() const { return SpiderMovement; }
+
+	/* Probe result block being applied, only valid inside surface handlers and events fired by them. */
+	FORCEINLINE const FTraceResult* GetActiveProbes() const { return ActiveProbes; }
+
+	/* Probes of last environment tracing, null until spider traced once. */
+	FORCEINLINE const FTraceResult* GetLastProbes() const { return bHasLastProbes ? &LastProbes : nullptr; }
+	FORCEINLINE uint64 GetLastProbesFrame() const { return LastProbesFrame; }
+
+	/* Set by anim instance placing legs from last probes, they are not kept otherwise. */
+	FORCEINLINE void SetLegIKConsumer(bool bConsumer)
+	{
+		bLegIKConsumer = bConsumer;
+		bHasLastProbes &= bConsumer;
+	}
+
+	FORCEINLINE int32 GetSignificanceTier() const { return SignificanceTier; }
+	FORCEINLINE ASpiderSwarmManager* GetSwarmManager() const { return SwarmManager; }
+
+	FORCEINLINE const FCollisionObjectQueryParams& GetProbeObjectQueryParams() const { return ProbeObjectQueryParams; }
+	FORCEINLINE const FCollisionQueryParams& GetProbeQueryParams() const { return ProbeQueryParams; }
+
+	FORCEINLINE float GetFeetOffset() const { return GetCharacterMovement()->UpdatedComponent->Bounds.BoxExtent.Z; }
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	void InitTracingArgs();
 
 	FVector CalcSurfaceTracingDistance();
 	FORCEINLINE bool DoLineTrace(FHitResult& OutHit, const FVector Start, const FVector End, FLinearColor TraceColor = FLinearColor::Red, FLinearColor TraceHitColor = FLinearColor::Green);
 
+	void RebuildProbeQueryParams();
+
+	/* Mark bodies of spider, so probes of other spiders can ignore them. */
+	void ApplySpiderMaskFilter();
+
+#if ENABLE_DRAW_DEBUG
+	/* Record probe to debug draw of swarm manager, or draw it right away without one, see SmartSpider.DebugProbes. */
+	void DrawProbe(const FHitResult& Hit, const FVector& Start, const FVector& End, FLinearColor TraceColor, FLinearColor TraceHitColor) const;
+#endif
+
+	FORCEINLINE void GetProbeSegment(ESpiderProbe Probe, FVector& OutStart, FVector& OutEnd) const { ProbeSet.GetSegment((int32)Probe, GetActorTransform(), OutStart, OutEnd); }
+	FLinearColor GetProbeColor(int32 RayIndex) const;
+
+	/* Trace active rays of probe set synchronously into result block. */
+	void TraceProbeBatch(const FVector* Starts, const FVector* Ends, FTraceResult& OutProbes);
+
+	/* Distance field covering every probe of spider, null if none or disabled. */
+	const FSpiderDistanceFieldData* FindProbeDistanceField() const;
+
+	/* Probe object types left out of distance field, traced along with it. */
+	FORCEINLINE FCollisionObjectQueryParams GetUnbakedObjectQueryParams(const FSpiderDistanceFieldData& Field) const
+	{
+		return FCollisionObjectQueryParams(ProbeObjectQueryParams.GetQueryBitfield() & ~Field.ObjectTypeMask);
+	}
+
+	/* Sample distance field and trace bodies not baked into it if it covers the segment, trace the world otherwise. Physics traces are counted into @InOutNumTraces. */
+	bool LineTraceProbe(const FSpiderDistanceFieldData* Field, FHitResult& OutHit, const FVector& Start, const FVector& End, int32& InOutNumTraces);
+
+	/* Center probe of active result block re-projected on current ray, or a synchronous trace outside environment tracing. */
+	bool FetchStickProbe(FHitResult& OutHit);
+
+	/* Kick off async probes with current transform, results will be consumed at next frame. */
+	void RequestAsyncProbes();
+	bool ConsumeAsyncProbes();
+
+	/* Store the plane of probes if all of them hit the same plane, otherwise invalidate cache. */
+	void UpdateProbeCache(EEnvironmentSurface CurrentSurface, const FTraceResult& Probes);
+
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
-	bool IsOnAir(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
+	bool IsOnAir(const FTraceResult& Probes);
 
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
-	bool IsSurfacePlane(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
+	bool IsSurfacePlane(const FTraceResult& Probes);
 
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
-	bool IsSurfaceConvex(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
+	bool IsSurfaceConvex(const FTraceResult& Probes);
 
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
-	bool IsSurfaceConcave(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
+	bool IsSurfaceConcave(const FTraceResult& Probes);
 
-	EEnvironmentSurface OnAirHandle(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
-	EEnvironmentSurface OnSurfaceHandlePlane(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
-	EEnvironmentSurface OnSurfaceHandleConvex(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
-	EEnvironmentSurface OnSurfaceHandleConcave(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
+	EEnvironmentSurface OnAirHandle(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes);
+	EEnvironmentSurface OnSurfaceHandlePlane(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes);
+	EEnvironmentSurface OnSurfaceHandleConvex(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes);
+	EEnvironmentSurface OnSurfaceHandleConcave(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes);
 
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
 	bool IsStickAndAlignWithSurface(FVector QueryPosition, FVector InSurfaceNornal);
 
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
 	FVector CalcDesireStickLocation(FVector QueryLocation, FVector InSurfaceNornal);
-	void RotationToMovement(float DeltaTime);
 
-	FORCEINLINE float GetFeetOffset() const { return GetCharacterMovement()->UpdatedComponent->Bounds.BoxExtent.Z; }
+	/* Start crossing the edge between the plane spider stands on and @ToNormal along trajectory, false if it can not be built. */
+	bool StartEdgeTrajectory(const FTraceResult& Probes, const FVector& ToPoint, const FVector& ToNormal, bool bConvex);
+
+	/* Trace back toward spider from below the edge bottom probe passed over, finds the far face of convex edge. */
+	bool TraceEdgeWrap(const FTraceResult& Probes, FHitResult& OutHit);
+
+	/* Plane spider stands on from center probe, or from its own up if center probe missed. */
+	void GetStandingPlane(const FTraceResult& Probes, FVector& OutPoint, FVector& OutNormal) const;
+
+	/* Trace down synchronously and teleport onto the surface without interpolation, e.g. spawned on the air. */
+	void SnapToSurface(float TraceDistance);
+
+	/* 
+	* Reduced tiers keep only the probes surface classification and sticking rely on.
+	* Bottom assistor is not read by classification, it is only traced on demand by @TraceBottomAssistor.
+	*/
+	FORCEINLINE bool IsProbeActive(int32 RayIndex) const
+	{
+		if (RayIndex == (int32)ESpiderProbe::BottomAssistor) return false;
+
+		return !CurrentLODTier.bReducedProbes || 
+				RayIndex == (int32)ESpiderProbe::Forward || RayIndex == (int32)ESpiderProbe::Bottom || RayIndex == (int32)ESpiderProbe::Center;
+	}
+
+	/* Runtime state accessors, the state is owned by swarm manager while simulated in swarm. */
+	FORCEINLINE const FSpiderProbeParams& GetProbeParams() const { return SwarmHandle.IsValid() ? SwarmManager->GetProbeParams(SwarmHandle) : ProbeParams; }
+	FORCEINLINE float GetAcceptableDistanceSq_Surface() const { return SwarmHandle.IsValid() ? SwarmManager->GetAcceptableDistanceSq_SurfaceDetected(SwarmHandle) : AcceptableDistanceSq_SurfaceDetected; }
+	FORCEINLINE EEnvironmentSurface& LastSurfaceTypeState() { return SwarmHandle.IsValid() ? SwarmManager->GetLastSurfaceType(SwarmHandle) : LastSurfaceType; }
+	FORCEINLINE FVector& SurfaceNormalState() { return SwarmHandle.IsValid() ? SwarmManager->GetSurfaceNormal(SwarmHandle) : SurfaceNormal; }
+	FORCEINLINE bool IsNeedStickToSurface() const { return SwarmHandle.IsValid() ? SwarmManager->IsNeedStickToSurface(SwarmHandle) : !!bNeedStickToSurface; }
+	FORCEINLINE void SetNeedStickToSurface(bool bNeed)
+	{
+		if (SwarmHandle.IsValid())
+		{
+			SwarmManager->SetNeedStickToSurface(SwarmHandle, bNeed);
+		}
+		else
+		{
+			bNeedStickToSurface = bNeed;
+		}
+	}
 public:	
 	UFUNCTION(BlueprintImplementableEvent)
 	void OnCrossSurfaceBegin();
@@ -247,6 +594,17 @@ public:
 	UFUNCTION(BlueprintImplementableEvent)
 	void OnCrossSurfaceEnd();
 
+	/* Only swarm spiders perceive, see @bSimulateInSwarm. */
+	UFUNCTION(BlueprintImplementableEvent, category = "SmartSpider|Perception")
+	void OnTargetSensed(AActor* Target);
+
+	/* Target left sight range, got occluded or destroyed, which may be null then. */
+	UFUNCTION(BlueprintImplementableEvent, category = "SmartSpider|Perception")
+	void OnTargetLost(AActor* Target);
+
+	UFUNCTION(BlueprintImplementableEvent, category = "SmartSpider|Perception")
+	void OnNoiseHeard(FVector Location, float Loudness, AActor* NoiseInstigator);
+
 	UFUNCTION(BlueprintImplementableEvent)
 	void OnSurfaceChange(EEnvironmentSurface LastSurface, EEnvironmentSurface NewSurface, FVector NewSurfaceNormal);
 	
@@ -263,6 +621,9 @@ public:
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
 	void StickToSurface(FVector InSurfaceNormal);
 
+	/* Interpolate toward surface normal in fixed substeps of movement, so sticking converges at the same rate at any tick rate. */
+	FVector InterpSurfaceNormal(const FVector& Current, const FVector& Target, float DeltaTime) const;
+
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
 	void TransitionToSurface(FVector TransitionLocation, FVector InSurfaceNormal);
 
@@ -270,9 +631,9 @@ public:
 	void UpdateRotationRate();
 
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
-	EEnvironmentSurface GetSurfaceType(FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
+	EEnvironmentSurface GetSurfaceType(const FTraceResult& Probes);
 
-	FORCEINLINE EEnvironmentSurface OnSurfaceHandle(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom);
+	FORCEINLINE EEnvironmentSurface OnSurfaceHandle(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes);
 
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
 	bool TraceForward(FAcceptableHitResult& OutHitResult);
@@ -289,35 +650,35 @@ public:
 	UFUNCTION(BlueprintCallable, category = "SmartSpider")
 	bool TraceBottomAssistor(FAcceptableHitResult& OutHitResult);
 
-	FORCEINLINE FVector GetTraceDirForward() const { return (-GetActorUpVector()).RotateAngleAxis(-TracingDegreesOffset_ForwardBackward, GetActorRightVector()); }
-	FORCEINLINE FVector GetTraceDirBackward() const { return (-GetActorUpVector()).RotateAngleAxis(TracingDegreesOffset_ForwardBackward, GetActorRightVector()); }
-	FORCEINLINE FVector GetTraceDirLeft() const { return (-GetActorUpVector()).RotateAngleAxis(-TracingDegreesOffset_LeftRight, GetActorForwardVector()); }
-	FORCEINLINE FVector GetTraceDirRight() const { return (-GetActorUpVector()).RotateAngleAxis(TracingDegreesOffset_LeftRight, GetActorForwardVector()); }
+	FORCEINLINE FVector GetTraceDirForward() const { return (-GetActorUpVector()).RotateAngleAxis(-GetProbeParams().TracingDegreesOffset_ForwardBackward, GetActorRightVector()); }
+	FORCEINLINE FVector GetTraceDirBackward() const { return (-GetActorUpVector()).RotateAngleAxis(GetProbeParams().TracingDegreesOffset_ForwardBackward, GetActorRightVector()); }
+	FORCEINLINE FVector GetTraceDirLeft() const { return (-GetActorUpVector()).RotateAngleAxis(-GetProbeParams().TracingDegreesOffset_LeftRight, GetActorForwardVector()); }
+	FORCEINLINE FVector GetTraceDirRight() const { return (-GetActorUpVector()).RotateAngleAxis(GetProbeParams().TracingDegreesOffset_LeftRight, GetActorForwardVector()); }
 
-	FORCEINLINE FVector GetEyePosition() const { return TracingOffset_Eye * GetActorUpVector() + GetActorLocation(); }
-	FORCEINLINE FVector GetBottomLocation() const { return GetActorLocation() + GetActorForwardVector() * TracingOffset_Bottom; }
-	FORCEINLINE FVector GetBottomAssistorLocation() const { return GetActorLocation() + GetActorForwardVector() * (TracingOffset_Bottom + TracingOffset_BottomAssistor); }
+	FORCEINLINE FVector GetEyePosition() const { return GetProbeParams().TracingOffset_Eye * GetActorUpVector() + GetActorLocation(); }
+	FORCEINLINE FVector GetBottomLocation() const { return GetActorLocation() + GetActorForwardVector() * GetProbeParams().TracingOffset_Bottom; }
+	FORCEINLINE FVector GetBottomAssistorLocation() const { return GetActorLocation() + GetActorForwardVector() * (GetProbeParams().TracingOffset_Bottom + GetProbeParams().TracingOffset_BottomAssistor); }
 
 #if WITH_EDITOR
 	virtual void PostEditChangeProperty(struct FPropertyChangedEvent& PropertyChangedEvent) override;
 #endif
 };
 
-FORCEINLINE EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandle(float DeltaTime, EEnvironmentSurface& Surface, FAcceptableHitResult& Forward, FAcceptableHitResult& Backward, FAcceptableHitResult& bottom)
+FORCEINLINE EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandle(float DeltaTime, EEnvironmentSurface& Surface, FTraceResult& Probes)
 {
 	switch (Surface)
 	{
 		case EEnvironmentSurface::OnAir:
-			return OnAirHandle(DeltaTime, Surface, Forward, Backward, bottom);
+			return OnAirHandle(DeltaTime, Surface, Probes);
 
 		case EEnvironmentSurface::Plane:
-			return OnSurfaceHandlePlane(DeltaTime, Surface, Forward, Backward, bottom);
+			return OnSurfaceHandlePlane(DeltaTime, Surface, Probes);
 		
 		case EEnvironmentSurface::Concave:
-			return OnSurfaceHandleConcave(DeltaTime, Surface, Forward, Backward, bottom);
+			return OnSurfaceHandleConcave(DeltaTime, Surface, Probes);
 
 		case EEnvironmentSurface::Convex:
-			return OnSurfaceHandleConvex(DeltaTime, Surface, Forward, Backward, bottom);
+			return OnSurfaceHandleConvex(DeltaTime, Surface, Probes);
 
 		default:
 			break;
@@ -328,5 +689,22 @@ FORCEINLINE EEnvironmentSurface ASmartSpiderCharacter::OnSurfaceHandle(float Del
 
 FORCEINLINE bool ASmartSpiderCharacter::DoLineTrace(FHitResult& OutHit, const FVector Start, const FVector End, FLinearColor TraceColor /* = FLinearColor::Red */, FLinearColor TraceHitColor /* = FLinearColor::Green */)
 {
-	return UKismetSystemLibrary::LineTraceSingleForObjects(this, Start, End, QueryObjectsType, bTraceComplex, ActorsToIgnore, ENV_TRACE_TYPE, OutHit, true, TraceColor, TraceHitColor, 0.0f);
+	if (!ProbeObjectQueryParams.IsValid()) return false;
+
+	int32 NumTraces = 0;
+	const bool bHit = LineTraceProbe(FindProbeDistanceField(), OutHit, Start, End, NumTraces);
+
+	if (SwarmManager)
+	{
+		SwarmManager->GetTraceScheduler().NotifyTracesIssued(NumTraces);
+	}
+
+#if ENABLE_DRAW_DEBUG
+	if (FSpiderDebugDraw::IsEnabled())
+	{
+		DrawProbe(OutHit, Start, End, TraceColor, TraceHitColor);
+	}
+#endif
+
+	return bHit;
 }
\ No newline at end of file
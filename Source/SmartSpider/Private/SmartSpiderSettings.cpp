@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SmartSpiderSettings.h"
+
+USmartSpiderSettings::USmartSpiderSettings()
+{
+	bEnableSignificanceLOD = true;
+	bUpdateSignificanceManager = true;
+	HiddenDistanceScale = 2;
+
+	LODTiers.Add(FSpiderLODTier(1500, 1, false, true, 0));
+	LODTiers.Add(FSpiderLODTier(4000, 2, true, true, 0.033f));
+	LODTiers.Add(FSpiderLODTier(8000, 4, true, false, 0.1f));
+	LODTiers.Add(FSpiderLODTier(0, 8, true, false, 0.25f));
+
+	MaxTracesPerFrame = 0;
+	SpiderMaskFilter = 1 << 5;
+
+	PathCacheSize = 64;
+	PathStartQuantization = 300;
+	PathNodeSnapDistance = 200;
+	MaxPathSearchNodes = 50000;
+	FlowFieldBudgetMs = 1;
+
+	bSensePlayerPawns = true;
+	MaxSightTracesPerFrame = 32;
+	PerceptionCellSize = 1000;
+	SightTraceChannel = ECC_Visibility;
+
+	bEnableSeparation = true;
+	SeparationRadius = 60;
+	SeparationSpeed = 150;
+
+	AgentPromoteDistance = 2500;
+	AgentDemoteDistance = 3000;
+	MaxPromotedAgents = 128;
+	MaxAgentPromotionsPerFrame = 4;
+	AgentProbeInterval = 4;
+
+	SpiderNetCullDistance = 10000;
+	NetUpdateFrequencyNear = 20;
+	NetUpdateFrequencyFar = 2;
+	NetFrequencyNearDistance = 1500;
+	NetFrequencyFarDistance = 6000;
+}
+
+int32 USmartSpiderSettings::GetLODTierIndex(float Distance) const
+{
+	for (int32 Index = 0; Index < LODTiers.Num() - 1; ++Index)
+	{
+		if (Distance <= LODTiers[Index].MaxDistance) return Index;
+	}
+
+	return FMath::Max(LODTiers.Num() - 1, 0);
+}
+
+float USmartSpiderSettings::GetNetUpdateFrequency(float Distance) const
+{
+	const FVector2D DistanceRange(NetFrequencyNearDistance, FMath::Max(NetFrequencyFarDistance, NetFrequencyNearDistance + 1.f));
+	return FMath::GetMappedRangeValueClamped(DistanceRange, FVector2D(NetUpdateFrequencyNear, NetUpdateFrequencyFar), Distance);
+}
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Engine/DeveloperSettings.h"
+#include "SmartSpiderSettings.generated.h"
+
+/* Simulation fidelity of spiders within a significance tier. */
+USTRUCT(BlueprintType)
+struct FSpiderLODTier
+{
+	GENERATED_USTRUCT_BODY()
+
+	/* Spiders farther than it from every viewpoint fall to next tier. The last tier takes all farther spiders. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "LOD", meta = (ClampMin = "0.0"))
+	float MaxDistance;
+
+	/* Probe environment every N frames. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "LOD", meta = (ClampMin = "1"))
+	int32 ProbeInterval;
+
+	/* Skip backward and bottom assistor probes. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "LOD")
+	uint32 bReducedProbes : 1;
+
+	/* Smooth rotation to movement and update rotation rate. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "LOD")
+	uint32 bSmoothRotation : 1;
+
+	/* Actor tick interval in seconds, 0 for every frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "LOD", meta = (ClampMin = "0.0"))
+	float TickInterval;
+
+	FSpiderLODTier()
+	{
+		MaxDistance = 0;
+		ProbeInterval = 1;
+		bReducedProbes = false;
+		bSmoothRotation = true;
+		TickInterval = 0;
+	}
+
+	FSpiderLODTier(float InMaxDistance, int32 InProbeInterval, bool bInReducedProbes, bool bInSmoothRotation, float InTickInterval)
+	{
+		MaxDistance = InMaxDistance;
+		ProbeInterval = InProbeInterval;
+		bReducedProbes = bInReducedProbes;
+		bSmoothRotation = bInSmoothRotation;
+		TickInterval = InTickInterval;
+	}
+};
+
+/*
+* Project wide settings of smart spider simulation.
+*/
+UCLASS(config = Game, defaultconfig, meta = (DisplayName = "Smart Spider"))
+class SMARTSPIDER_API USmartSpiderSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+	/* Assign spiders LOD tier by significance to local players or server observers. */
+	UPROPERTY(config, EditAnywhere, category = "LOD")
+	uint32 bEnableSignificanceLOD : 1;
+
+	/* Let swarm manager feed player viewpoints to significance manager, disable if the game updates it already. */
+	UPROPERTY(config, EditAnywhere, category = "LOD", meta = (EditCondition = "bEnableSignificanceLOD"))
+	uint32 bUpdateSignificanceManager : 1;
+
+	/* Distance scale of spiders behind the viewpoint. */
+	UPROPERTY(config, EditAnywhere, category = "LOD", meta = (EditCondition = "bEnableSignificanceLOD", ClampMin = "1.0"))
+	float HiddenDistanceScale;
+
+	/* Tiers from full fidelity to the cheapest one, ordered by @MaxDistance. */
+	UPROPERTY(config, EditAnywhere, category = "LOD", meta = (EditCondition = "bEnableSignificanceLOD"))
+	TArray<FSpiderLODTier> LODTiers;
+
+	/* 
+	* Hard cap of environment traces issued by all spiders per frame, 0 for unlimited.
+	* Spiders in transition are served first, stable plane walkers round-robin, the others extrapolate.
+	*/
+	UPROPERTY(config, EditAnywhere, category = "Trace Budget", meta = (ClampMin = "0"))
+	int32 MaxTracesPerFrame;
+
+	/* Mask filter set on spider bodies, probes ignore it to pass through other spiders. Only 6 bits are available. */
+	UPROPERTY(config, EditAnywhere, category = "Collision", meta = (ClampMin = "1", ClampMax = "63"))
+	int32 SpiderMaskFilter;
+
+	/* Surface paths kept for reuse by spiders starting nearby, least recently used ones are dropped first. */
+	UPROPERTY(config, EditAnywhere, category = "Navigation", meta = (ClampMin = "0"))
+	int32 PathCacheSize;
+
+	/* Spiders starting within the same cube of this size and heading to the same goal node share a path. */
+	UPROPERTY(config, EditAnywhere, category = "Navigation", meta = (ClampMin = "1.0"))
+	float PathStartQuantization;
+
+	/* Max distance from start or goal to the nearest surface node. */
+	UPROPERTY(config, EditAnywhere, category = "Navigation", meta = (ClampMin = "0.0"))
+	float PathNodeSnapDistance;
+
+	/* Search gives up after expanding this many nodes. */
+	UPROPERTY(config, EditAnywhere, category = "Navigation", meta = (ClampMin = "1"))
+	int32 MaxPathSearchNodes;
+
+	/* Milliseconds per frame spent on rebuilding flow fields of all targets. */
+	UPROPERTY(config, EditAnywhere, category = "Navigation", meta = (ClampMin = "0.01"))
+	float FlowFieldBudgetMs;
+
+	/* Player pawns are seen by swarm spiders without registering them as sight targets. */
+	UPROPERTY(config, EditAnywhere, category = "Perception")
+	uint32 bSensePlayerPawns : 1;
+
+	/* Line of sight traces issued by all swarm spiders per frame, 0 for unlimited. Pairs in range are checked round-robin. */
+	UPROPERTY(config, EditAnywhere, category = "Perception", meta = (ClampMin = "0"))
+	int32 MaxSightTracesPerFrame;
+
+	/* Cell size of spatial hash for range culling, around the common sight distance works best. */
+	UPROPERTY(config, EditAnywhere, category = "Perception", meta = (ClampMin = "10.0"))
+	float PerceptionCellSize;
+
+	UPROPERTY(config, EditAnywhere, category = "Perception")
+	TEnumAsByte<ECollisionChannel> SightTraceChannel;
+
+	/* Push swarm spiders on the same surface apart, instead of pawn overlaps. */
+	UPROPERTY(config, EditAnywhere, category = "Separation")
+	uint32 bEnableSeparation : 1;
+
+	/* Spiders closer than it push each other, also the cell size of neighbor hash. */
+	UPROPERTY(config, EditAnywhere, category = "Separation", meta = (EditCondition = "bEnableSeparation", ClampMin = "1.0"))
+	float SeparationRadius;
+
+	/* Push speed of fully overlapped spiders, fading out toward @SeparationRadius. */
+	UPROPERTY(config, EditAnywhere, category = "Separation", meta = (EditCondition = "bEnableSeparation", ClampMin = "0.0"))
+	float SeparationSpeed;
+
+	/* Lightweight agents closer than it to a viewpoint are promoted to pooled spider actors. */
+	UPROPERTY(config, EditAnywhere, category = "Agents", meta = (ClampMin = "0.0"))
+	float AgentPromoteDistance;
+
+	/* Promoted agents farther than it are demoted, keep it above @AgentPromoteDistance to avoid flapping. */
+	UPROPERTY(config, EditAnywhere, category = "Agents", meta = (ClampMin = "0.0"))
+	float AgentDemoteDistance;
+
+	/* Spider actors standing for agents at most, nearest agents are promoted first. */
+	UPROPERTY(config, EditAnywhere, category = "Agents", meta = (ClampMin = "0"))
+	int32 MaxPromotedAgents;
+
+	/* Promotions per frame, spreads actor activation over frames. */
+	UPROPERTY(config, EditAnywhere, category = "Agents", meta = (ClampMin = "1"))
+	int32 MaxAgentPromotionsPerFrame;
+
+	/* Lightweight agents probe environment every N frames. */
+	UPROPERTY(config, EditAnywhere, category = "Agents", meta = (ClampMin = "1"))
+	int32 AgentProbeInterval;
+
+	/* Instanced mesh drawn for lightweight agents, none for invisible agents. */
+	UPROPERTY(config, EditAnywhere, category = "Agents", meta = (AllowedClasses = "StaticMesh"))
+	FStringAssetReference AgentMesh;
+
+	/* Spiders farther than it from every viewer are not relevant to the connection, 0 keeps the cull distance of spider class. */
+	UPROPERTY(config, EditAnywhere, category = "Replication", meta = (ClampMin = "0.0"))
+	float SpiderNetCullDistance;
+
+	/* Net update frequency of spiders within @NetFrequencyNearDistance to the nearest viewer. */
+	UPROPERTY(config, EditAnywhere, category = "Replication", meta = (ClampMin = "0.1"))
+	float NetUpdateFrequencyNear;
+
+	/* Net update frequency of spiders beyond @NetFrequencyFarDistance, scaled linearly in between. */
+	UPROPERTY(config, EditAnywhere, category = "Replication", meta = (ClampMin = "0.1"))
+	float NetUpdateFrequencyFar;
+
+	UPROPERTY(config, EditAnywhere, category = "Replication", meta = (ClampMin = "0.0"))
+	float NetFrequencyNearDistance;
+
+	UPROPERTY(config, EditAnywhere, category = "Replication", meta = (ClampMin = "0.0"))
+	float NetFrequencyFarDistance;
+
+public:
+	USmartSpiderSettings();
+
+	/* Tier index of spider with distance to the nearest viewpoint. */
+	int32 GetLODTierIndex(float Distance) const;
+
+	/* Net update frequency of spider with distance to the nearest viewer. */
+	float GetNetUpdateFrequency(float Distance) const;
+};
@@ -3,6 +3,63 @@
 #include "SmartSpider.h"
 #include "SpiderAIController.h"
 #include "SmartSpiderCharacter.h"
+#include "SpiderSurfaceBakeVolume.h"
+
+ASpiderAIController::ASpiderAIController()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	AcceptableDistanceSq = 0;
+	WaypointAcceptanceRadius = 50;
+	RepathDistance = 200;
+	RepathInterval = 0.5f;
+
+	CurrentPathPoint = 0;
+	bHasDestination = false;
+	bWaitingForPath = false;
+	PathGoal = FVector::ZeroVector;
+	LastPathRequestTime = -MAX_FLT;
+
+	bUseFlowField = true;
+	FlowFieldTarget = nullptr;
+	FlowFieldGraph = nullptr;
+	FlowFieldNode = INDEX_NONE;
+}
+
+void ASpiderAIController::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (FlowFieldTarget)
+	{
+		if (FlowFieldTarget->IsPendingKill())
+		{
+			SetChaseTarget(nullptr, 0);
+		}
+		else if (bUseFlowField)
+		{
+			if (SpiderCharacter && !IsArrvied(FlowFieldTarget->GetActorLocation()) && !FollowFlowField())
+			{
+				// Off the graph or field not built yet, head straight to target along the surface.
+				const FVector SurfaceNormal = SpiderCharacter->GetSpiderMovement()->GetSurfaceNormal();
+				const FVector Direction = FVector::VectorPlaneProject(FlowFieldTarget->GetActorLocation() - SpiderCharacter->GetActorLocation(), SurfaceNormal).GetSafeNormal();
+				SpiderCharacter->AddMovementInput(Direction);
+			}
+			return;
+		}
+		else
+		{
+			// Keep chasing after arrival, target may move away again.
+			Destination = FlowFieldTarget->GetActorLocation();
+			bHasDestination = true;
+		}
+	}
+
+	if (bHasDestination && MoveToDestination())
+	{
+		ClearDestination();
+	}
+}
 
 void ASpiderAIController::Possess(APawn* InPawn)
 {
@@ -24,30 +81,126 @@ void ASpiderAIController::UnPossess()
 	SpiderCharacter = nullptr;
 }
 
-//void ASpiderAIController::SetDestination(FVector InDestination, float AcceptableDistance)
-//{
-//	Destination = InDestination;
-//	AcceptableDistanceSq = AcceptableDistance * AcceptableDistance;
-//}
-//
-//bool ASpiderAIController::MoveToDestination()
-//{
-//	if (IsArrvied(Destination)) return true;
-//
-//	FindPathForMoveRequest();
-//
-//	MoveTo();
-//
-//
-//	FTraceResult TraceResult = SpiderCharacter->TraceEnv();
-//	switch (TraceResult.SurfaceType)
-//	{
-//		default:
-//			break;
-//	}
-//
-//	return false;
-//}
+void ASpiderAIController::SetDestination(FVector InDestination, float AcceptableDistance)
+{
+	Destination = InDestination;
+	AcceptableDistanceSq = AcceptableDistance * AcceptableDistance;
+	bHasDestination = true;
+}
+
+void ASpiderAIController::ClearDestination()
+{
+	bHasDestination = false;
+	CurrentPath.Reset();
+	CurrentPathPoint = 0;
+}
+
+void ASpiderAIController::SetChaseTarget(AActor* Target, float AcceptableDistance)
+{
+	FlowFieldTarget = Target;
+	FlowFieldGraph = nullptr;
+	FlowFieldNode = INDEX_NONE;
+
+	if (Target)
+	{
+		SetDestination(Target->GetActorLocation(), AcceptableDistance);
+	}
+	else
+	{
+		ClearDestination();
+	}
+}
+
+bool ASpiderAIController::FollowFlowField()
+{
+	if (!SpiderCharacter) return false;
+
+	ASpiderSwarmManager* SwarmManager = ASpiderSwarmManager::Get(GetWorld());
+	if (!SwarmManager) return false;
+
+	const FVector Location = SpiderCharacter->GetActorLocation();
+	if (!FlowFieldGraph || !FlowFieldGraph->GetBounds().IsInside(Location))
+	{
+		FlowFieldGraph = ASpiderSurfaceBakeVolume::FindSurfaceGraph(this, Location);
+		FlowFieldNode = INDEX_NONE;
+	}
+
+	const FSpiderFlowField* FlowField = SwarmManager->FindOrAddFlowField(FlowFieldGraph, FlowFieldTarget);
+	FVector Direction;
+	if (!FlowField || !FlowField->SampleDirection(Location, FlowFieldNode, Direction)) return false;
+
+	SpiderCharacter->AddMovementInput(Direction);
+	return true;
+}
+
+bool ASpiderAIController::MoveToDestination()
+{
+	if (IsArrvied(Destination)) return true;
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	const bool bGoalMoved = FVector::DistSquared(PathGoal, Destination) > RepathDistance * RepathDistance;
+	if (!bWaitingForPath && (!CurrentPath.IsValid() || bGoalMoved) && Now - LastPathRequestTime >= RepathInterval)
+	{
+		RequestSurfacePath();
+	}
+
+	FollowSurfacePath();
+	return false;
+}
+
+void ASpiderAIController::RequestSurfacePath()
+{
+	if (!SpiderCharacter) return;
+
+	PathGoal = Destination;
+	LastPathRequestTime = GetWorld()->GetTimeSeconds();
+
+	const FVector Start = SpiderCharacter->GetActorLocation();
+	USpiderSurfaceGraph* Graph = ASpiderSurfaceBakeVolume::FindSurfaceGraph(this, Start);
+	ASpiderSwarmManager* SwarmManager = ASpiderSwarmManager::Get(GetWorld());
+	if (!Graph || !SwarmManager)
+	{
+		// No surface graph baked here, fall back to navmesh.
+		CurrentPath.Reset();
+		MoveToLocation(Destination, FMath::Sqrt(AcceptableDistanceSq));
+		return;
+	}
+
+	bWaitingForPath = true;
+	SwarmManager->GetPathfinder().FindPath(Graph, Start, Destination, FOnSpiderPathFound::CreateUObject(this, &ASpiderAIController::OnSurfacePathFound));
+}
+
+void ASpiderAIController::OnSurfacePathFound(FSpiderSurfacePathPtr Path)
+{
+	bWaitingForPath = false;
+	if (!SpiderCharacter) return;
+
+	CurrentPath = Path;
+
+	// Path may be searched by another spider nearby, join it at the nearest point.
+	CurrentPathPoint = Path.IsValid() ? Path->FindNearestPoint(SpiderCharacter->GetActorLocation()) : 0;
+}
+
+bool ASpiderAIController::FollowSurfacePath()
+{
+	if (!CurrentPath.IsValid() || !SpiderCharacter) return false;
+
+	const FVector Location = SpiderCharacter->GetActorLocation();
+	const float AcceptanceRadiusSq = WaypointAcceptanceRadius * WaypointAcceptanceRadius;
+	while (CurrentPathPoint < CurrentPath->Num() - 1 && FVector::DistSquared(Location, CurrentPath->Points[CurrentPathPoint]) < AcceptanceRadiusSq)
+	{
+		++CurrentPathPoint;
+	}
+
+	// Last point is the node nearest to destination, head to the destination itself from there.
+	const bool bLastPoint = CurrentPathPoint >= CurrentPath->Num() - 1;
+	const FVector Target = bLastPoint ? Destination : CurrentPath->Points[CurrentPathPoint];
+	const FVector Direction = FVector::VectorPlaneProject(Target - Location, CurrentPath->Normals[CurrentPathPoint]).GetSafeNormal();
+	if (Direction.IsZero()) return false;
+
+	SpiderCharacter->AddMovementInput(Direction);
+	return true;
+}
 
 bool ASpiderAIController::FindReversePath(FVector Dest, float AcceptanceRadius, TSubclassOf<UNavigationQueryFilter> FilterClass)
 {
@@ -76,12 +229,9 @@ bool ASpiderAIController::FindReversePath(FVector Dest, float AcceptanceRadius,
 	return true; 
 }
 
-//
-//bool ASpiderAIController::IsArrvied(FVector InDestination)
-//{
-//	if (!SpiderCharacter) return true;
-//
-//	return (SpiderCharacter->GetActorLocation() - InDestination).SizeSquared() < AcceptableDistanceSq;
-//}
-
+bool ASpiderAIController::IsArrvied(FVector InDestination)
+{
+	if (!SpiderCharacter) return true;
 
+	return (SpiderCharacter->GetActorLocation() - InDestination).SizeSquared() < AcceptableDistanceSq;
+}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "AIController.h"
+#include "SpiderPathfinder.h"
 #include "SpiderAIController.generated.h"
 
 class ASmartSpiderCharacter;
@@ -22,18 +23,76 @@ protected:
 	FVector Destination;
 	float AcceptableDistanceSq;
 
+	/* Spider switches to next path point within this distance. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "SpiderAI|Surface Path", meta = (ClampMin = "1.0"))
+	float WaypointAcceptanceRadius;
+
+	/* Search again once destination moved farther than it from goal of current path. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "SpiderAI|Surface Path", meta = (ClampMin = "0.0"))
+	float RepathDistance;
+
+	/* Min seconds between path requests. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "SpiderAI|Surface Path", meta = (ClampMin = "0.0"))
+	float RepathInterval;
+
+	/* Shared with other spiders through path cache, never modified. */
+	FSpiderSurfacePathPtr CurrentPath;
+	int32 CurrentPathPoint;
+
+	uint32 bHasDestination : 1;
+	uint32 bWaitingForPath : 1;
+
+	/* Destination the current path or the request in flight was searched for. */
+	FVector PathGoal;
+	float LastPathRequestTime;
+
+	/* Chase target by sampling flow field shared by the swarm, instead of searching paths per spider. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "SpiderAI|Flow Field")
+	uint32 bUseFlowField : 1;
+
+	UPROPERTY(BlueprintReadOnly, category = "SpiderAI|Flow Field")
+	AActor* FlowFieldTarget;
+
+	/* Graph of bake volume the spider is in, looked up again once spider leaves it. */
+	UPROPERTY(Transient)
+	USpiderSurfaceGraph* FlowFieldGraph;
+
+	/* Node spider was nearest to at last sample. */
+	int32 FlowFieldNode;
+
+	/* Steer along flow field toward target, false if spider is off the graph. */
+	bool FollowFlowField();
+
+	void RequestSurfacePath();
+	void OnSurfacePathFound(FSpiderSurfacePathPtr Path);
+
+	/* Steer along current path, false if there is no path to follow. */
+	bool FollowSurfacePath();
+
 public:
-	//UFUNCTION(BlueprintCallable, category = "SpiderAI")
-	//bool MoveToDestination();
+	ASpiderAIController();
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	/* Move along surface path to destination, true if arrived. */
+	UFUNCTION(BlueprintCallable, category = "SpiderAI")
+	bool MoveToDestination();
 
 	bool FindReversePath(FVector Dest, float AcceptanceRadius, TSubclassOf<UNavigationQueryFilter> FilterClass);
 
-	//
-	//UFUNCTION(BlueprintCallable, category = "SpiderAI")
-	//void SetDestination(FVector InDestination, float AcceptableDistance);
+	/* Set destination followed each tick, paths are searched on surface graph of bake volume the spider is in. */
+	UFUNCTION(BlueprintCallable, category = "SpiderAI")
+	void SetDestination(FVector InDestination, float AcceptableDistance);
+
+	UFUNCTION(BlueprintCallable, category = "SpiderAI")
+	void ClearDestination();
+
+	/* Chase target with flow field if @bUseFlowField, otherwise with surface paths to its location. Null to stop. */
+	UFUNCTION(BlueprintCallable, category = "SpiderAI")
+	void SetChaseTarget(AActor* Target, float AcceptableDistance);
 
 	virtual void Possess(APawn* InPawn) override;
 	virtual void UnPossess() override;
 
-	//bool IsArrvied(FVector InDestination);
+	bool IsArrvied(FVector InDestination);
 };
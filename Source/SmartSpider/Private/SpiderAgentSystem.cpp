@@ -0,0 +1,368 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderAgentSystem.h"
+#include "SmartSpiderCharacter.h"
+#include "SmartSpiderSettings.h"
+#include "SpiderMovementComponent.h"
+#include "SpiderTraceScheduler.h"
+#include "SpiderStats.h"
+#include "Components/InstancedStaticMeshComponent.h"
+
+namespace SpiderAgents
+{
+	/* Probes of agents, same as reduced probes of spider actors. */
+	static const ESpiderProbe Probes[] = { ESpiderProbe::Forward, ESpiderProbe::Bottom, ESpiderProbe::Center };
+	static const int32 NumProbes = ARRAY_COUNT(Probes);
+}
+
+FSpiderAgentSystem::FSpiderAgentSystem()
+	: NextAgentId(0)
+	, NumPromotedAgents(0)
+{
+}
+
+int32 FSpiderAgentSystem::SpawnAgent(UWorld* World, UClass* SpiderClass, const FTransform& Transform, const FVector& Velocity)
+{
+	const int32 ArchetypeIndex = FindOrAddArchetype(World, SpiderClass);
+	if (ArchetypeIndex == INDEX_NONE) return INDEX_NONE;
+
+	const FQuat Rotation = Transform.GetRotation();
+	const FVector Normal = Rotation.GetUpVector();
+
+	const int32 AgentId = NextAgentId++;
+	IdToIndex.Add(AgentId, AgentIds.Add(AgentId));
+	ArchetypeIndices.Add(ArchetypeIndex);
+	Locations.Add(Transform.GetLocation());
+	Rotations.Add(Rotation);
+	SurfaceNormals.Add(Normal);
+	Surfaces.Add(EEnvironmentSurface::Plane);
+	Velocities.Add(FVector::VectorPlaneProject(Velocity, Normal));
+	ProbeDeltaTimes.Add(0.f);
+	Actors.Add(nullptr);
+
+	return AgentId;
+}
+
+void FSpiderAgentSystem::DestroyAgent(int32 AgentId)
+{
+	if (const int32* Index = IdToIndex.Find(AgentId))
+	{
+		if (Actors[*Index].IsValid())
+		{
+			Demote(*Index);
+		}
+		RemoveAt(*Index);
+	}
+}
+
+void FSpiderAgentSystem::SetVelocity(int32 AgentId, const FVector& Velocity)
+{
+	const int32* Index = IdToIndex.Find(AgentId);
+	if (!Index) return;
+
+	if (ASmartSpiderCharacter* Spider = Actors[*Index].Get())
+	{
+		Spider->GetCharacterMovement()->Velocity = Velocity;
+	}
+	else
+	{
+		Velocities[*Index] = FVector::VectorPlaneProject(Velocity, SurfaceNormals[*Index]);
+	}
+}
+
+ASmartSpiderCharacter* FSpiderAgentSystem::GetActor(int32 AgentId) const
+{
+	const int32* Index = IdToIndex.Find(AgentId);
+	return Index ? Actors[*Index].Get() : nullptr;
+}
+
+void FSpiderAgentSystem::Reset()
+{
+	AgentIds.Reset();
+	ArchetypeIndices.Reset();
+	Locations.Reset();
+	Rotations.Reset();
+	SurfaceNormals.Reset();
+	Surfaces.Reset();
+	Velocities.Reset();
+	ProbeDeltaTimes.Reset();
+	Actors.Reset();
+	IdToIndex.Reset();
+	Archetypes.Reset();
+	NumPromotedAgents = 0;
+}
+
+int32 FSpiderAgentSystem::FindOrAddArchetype(UWorld* World, UClass* SpiderClass)
+{
+	if (!SpiderClass)
+	{
+		SpiderClass = ASmartSpiderCharacter::StaticClass();
+	}
+
+	const int32 Existing = Archetypes.IndexOfByPredicate([SpiderClass](const FSpiderAgentArchetype& Archetype) { return Archetype.SpiderClass == SpiderClass; });
+	if (Existing != INDEX_NONE) return Existing;
+
+	// Probe tuning is built at begin play, read it from a spawned actor which becomes the first pooled one.
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	ASmartSpiderCharacter* Template = World->SpawnActor<ASmartSpiderCharacter>(SpiderClass, FTransform::Identity, SpawnParams);
+	if (!Template)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to spawn %s for spider agents."), *GetNameSafe(SpiderClass));
+		return INDEX_NONE;
+	}
+
+	Template->DeactivateToPool();
+
+	FSpiderAgentArchetype& Archetype = Archetypes[Archetypes.AddDefaulted()];
+	Archetype.SpiderClass = SpiderClass;
+	Archetype.ProbeSet = Template->ProbeSet;
+	Archetype.ProbeParams = Template->ProbeParams;
+	Archetype.AcceptableDistanceSq = Template->AcceptableDistanceSq_SurfaceDetected;
+	Archetype.FeetOffset = Template->GetFeetOffset();
+	Archetype.TransitionRateInDegrees = Template->TransitionRateInDegrees;
+	Archetype.ObjectQueryParams = Template->ProbeObjectQueryParams;
+	Archetype.QueryParams = Template->ProbeQueryParams;
+	Archetype.Pool.Add(Template);
+
+	return Archetypes.Num() - 1;
+}
+
+ASmartSpiderCharacter* FSpiderAgentSystem::AcquireActor(UWorld* World, int32 ArchetypeIndex, const FTransform& Transform)
+{
+	FSpiderAgentArchetype& Archetype = Archetypes[ArchetypeIndex];
+	while (Archetype.Pool.Num() > 0)
+	{
+		ASmartSpiderCharacter* Spider = Archetype.Pool.Pop(false).Get();
+		if (Spider && !Spider->IsPendingKill()) return Spider;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<ASmartSpiderCharacter>(Archetype.SpiderClass, Transform, SpawnParams);
+}
+
+void FSpiderAgentSystem::Promote(UWorld* World, int32 Index)
+{
+	const FTransform Transform(Rotations[Index], Locations[Index]);
+	ASmartSpiderCharacter* Spider = AcquireActor(World, ArchetypeIndices[Index], Transform);
+	if (!Spider) return;
+
+	Spider->ActivateFromPool(Transform, Velocities[Index], Surfaces[Index], SurfaceNormals[Index]);
+	Actors[Index] = Spider;
+	++NumPromotedAgents;
+}
+
+void FSpiderAgentSystem::Demote(int32 Index)
+{
+	ASmartSpiderCharacter* Spider = Actors[Index].Get();
+	Actors[Index] = nullptr;
+	--NumPromotedAgents;
+	if (!Spider || Spider->IsPendingKill()) return;
+
+	Locations[Index] = Spider->GetActorLocation();
+	Rotations[Index] = Spider->GetActorQuat();
+	Surfaces[Index] = Spider->GetCurrentSurfaceType();
+	SurfaceNormals[Index] = Spider->GetCurrentSurfaceNormal();
+	Velocities[Index] = Spider->GetVelocity();
+	ProbeDeltaTimes[Index] = 0.f;
+
+	Spider->DeactivateToPool();
+	Archetypes[ArchetypeIndices[Index]].Pool.Add(Spider);
+}
+
+void FSpiderAgentSystem::RemoveAt(int32 Index)
+{
+	IdToIndex.Remove(AgentIds[Index]);
+
+	AgentIds.RemoveAtSwap(Index, 1, false);
+	ArchetypeIndices.RemoveAtSwap(Index, 1, false);
+	Locations.RemoveAtSwap(Index, 1, false);
+	Rotations.RemoveAtSwap(Index, 1, false);
+	SurfaceNormals.RemoveAtSwap(Index, 1, false);
+	Surfaces.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	ProbeDeltaTimes.RemoveAtSwap(Index, 1, false);
+	Actors.RemoveAtSwap(Index, 1, false);
+
+	// The last agent was swapped into the hole.
+	if (AgentIds.IsValidIndex(Index))
+	{
+		IdToIndex.Add(AgentIds[Index], Index);
+	}
+}
+
+void FSpiderAgentSystem::Update(UWorld* World, float DeltaTime, const TArray<FTransform>& Viewpoints, FSpiderTraceScheduler& TraceScheduler, UInstancedStaticMeshComponent* Instances)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderAgents);
+
+	const USmartSpiderSettings* Settings = GetDefault<USmartSpiderSettings>();
+	const float PromoteDistanceSq = FMath::Square(Settings->AgentPromoteDistance);
+	const float DemoteDistanceSq = FMath::Square(FMath::Max(Settings->AgentDemoteDistance, Settings->AgentPromoteDistance));
+
+	// Promoted actor was destroyed by game, so is the agent.
+	for (int32 Index = AgentIds.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Actors[Index].IsValid() && !Actors[Index].IsExplicitlyNull())
+		{
+			--NumPromotedAgents;
+			RemoveAt(Index);
+		}
+	}
+
+	ViewDistancesSq.SetNumUninitialized(AgentIds.Num(), false);
+	PromoteCandidates.Reset();
+	for (int32 Index = 0; Index < AgentIds.Num(); ++Index)
+	{
+		const bool bPromoted = Actors[Index].IsValid();
+		if (bPromoted)
+		{
+			Locations[Index] = Actors[Index]->GetActorLocation();
+		}
+
+		float DistanceSq = MAX_FLT;
+		for (const FTransform& Viewpoint : Viewpoints)
+		{
+			DistanceSq = FMath::Min(DistanceSq, FVector::DistSquared(Viewpoint.GetLocation(), Locations[Index]));
+		}
+		ViewDistancesSq[Index] = DistanceSq;
+
+		if (bPromoted && DistanceSq > DemoteDistanceSq)
+		{
+			Demote(Index);
+		}
+		else if (!bPromoted && DistanceSq < PromoteDistanceSq)
+		{
+			PromoteCandidates.Add(Index);
+		}
+	}
+
+	const TArray<float>& Distances = ViewDistancesSq;
+	PromoteCandidates.Sort([&Distances](int32 A, int32 B) { return Distances[A] < Distances[B]; });
+
+	const int32 NumToPromote = FMath::Min3(PromoteCandidates.Num(), Settings->MaxAgentPromotionsPerFrame, Settings->MaxPromotedAgents - NumPromotedAgents);
+	for (int32 Candidate = 0; Candidate < NumToPromote; ++Candidate)
+	{
+		Promote(World, PromoteCandidates[Candidate]);
+	}
+
+	// Stagger by id, so agents do not probe at the same frame.
+	const uint64 ProbeInterval = FMath::Max(Settings->AgentProbeInterval, 1);
+	for (int32 Index = 0; Index < AgentIds.Num(); ++Index)
+	{
+		if (Actors[Index].IsValid()) continue;
+
+		const bool bProbe = (GFrameCounter + AgentIds[Index]) % ProbeInterval == 0 && TraceScheduler.TryAcquire(SpiderAgents::NumProbes);
+		Simulate(World, Index, DeltaTime, bProbe);
+		if (bProbe)
+		{
+			TraceScheduler.NotifyTracesIssued(SpiderAgents::NumProbes);
+		}
+	}
+
+	if (Instances)
+	{
+		SyncInstances(Instances);
+	}
+}
+
+void FSpiderAgentSystem::Simulate(UWorld* World, int32 Index, float DeltaTime, bool bProbe)
+{
+	FVector& Location = Locations[Index];
+	FQuat& Rotation = Rotations[Index];
+	FVector& Normal = SurfaceNormals[Index];
+	FVector& Velocity = Velocities[Index];
+	EEnvironmentSurface& Surface = Surfaces[Index];
+
+	if (Surface == EEnvironmentSurface::OnAir)
+	{
+		Velocity.Z += World->GetGravityZ() * DeltaTime;
+	}
+	Location += Velocity * DeltaTime;
+
+	ProbeDeltaTimes[Index] += DeltaTime;
+	if (!bProbe) return;
+
+	const float ProbeDeltaTime = ProbeDeltaTimes[Index];
+	ProbeDeltaTimes[Index] = 0.f;
+
+	const FSpiderAgentArchetype& Archetype = Archetypes[ArchetypeIndices[Index]];
+	const FTransform Transform(Rotation, Location);
+
+	FTraceResult Probes;
+	for (ESpiderProbe Probe : SpiderAgents::Probes)
+	{
+		FVector Start, End;
+		Archetype.ProbeSet.GetSegment((int32)Probe, Transform, Start, End);
+		World->LineTraceSingleByObjectType(Probes.GetHit((int32)Probe), Start, End, Archetype.ObjectQueryParams, Archetype.QueryParams);
+	}
+
+	FSpiderSurfaceClassifier::Classify(Probes, Archetype.AcceptableDistanceSq, Archetype.ProbeParams.TracingDistanceTestToleranceSq);
+
+	const FHitResult& Forward = Probes.HitResultForward.HitResult;
+	const FHitResult& Bottom = Probes.HitResultBottom.HitResult;
+	const FHitResult& Center = Probes.HitResultCenter;
+	const bool bOnAir = !Center.bBlockingHit && FSpiderSurfaceClassifier::IsOnAir(Probes);
+
+	// Same surface handling as spider actors, applied directly instead of through movement component.
+	const FQuat OldRotation = Rotation;
+	if (bOnAir)
+	{
+		Surface = EEnvironmentSurface::OnAir;
+		return;
+	}
+
+	Surface = Probes.SurfaceType;
+	switch (Surface)
+	{
+		case EEnvironmentSurface::Plane:
+			Normal = Bottom.bBlockingHit ? Bottom.ImpactNormal : Center.bBlockingHit ? Center.ImpactNormal : Normal;
+			Rotation = USpiderMovementComponent::MakeSurfaceRotation(Rotation, Normal);
+			if (Center.bBlockingHit)
+			{
+				Location = Center.ImpactPoint + Normal * Archetype.FeetOffset;
+			}
+			break;
+
+		case EEnvironmentSurface::Concave:
+			Normal = Forward.ImpactNormal;
+			Rotation = USpiderMovementComponent::MakeSurfaceRotation(Rotation, Normal);
+			break;
+
+		case EEnvironmentSurface::Convex:
+			Location -= Rotation.GetForwardVector() * Archetype.ProbeParams.TracingOffset_BottomAssistor;
+			Rotation = Rotation * FRotator(-Archetype.TransitionRateInDegrees * ProbeDeltaTime, 0.f, 0.f).Quaternion();
+			Normal = Rotation.GetUpVector();
+			break;
+
+		default:
+			break;
+	}
+
+	// Velocity turns along with spider and stays on the surface.
+	Velocity = FVector::VectorPlaneProject((Rotation * OldRotation.Inverse()).RotateVector(Velocity), Normal);
+	if (!Velocity.IsNearlyZero())
+	{
+		Rotation = FRotationMatrix::MakeFromZX(Normal, Velocity).ToQuat();
+	}
+}
+
+void FSpiderAgentSystem::SyncInstances(UInstancedStaticMeshComponent* Instances) const
+{
+	const int32 NumAgents = AgentIds.Num();
+	while (Instances->GetInstanceCount() > NumAgents)
+	{
+		Instances->RemoveInstance(Instances->GetInstanceCount() - 1);
+	}
+	while (Instances->GetInstanceCount() < NumAgents)
+	{
+		Instances->AddInstanceWorldSpace(FTransform::Identity);
+	}
+
+	for (int32 Index = 0; Index < NumAgents; ++Index)
+	{
+		const FVector Scale = Actors[Index].IsValid() ? FVector::ZeroVector : FVector::OneVector;
+		Instances->UpdateInstanceTransform(Index, FTransform(Rotations[Index], Locations[Index], Scale), true, Index == NumAgents - 1);
+	}
+}
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+#include "EnvironmentTraceHit.h"
+#include "WorldCollision.h"
+
+class ASmartSpiderCharacter;
+class FSpiderTraceScheduler;
+class UInstancedStaticMeshComponent;
+
+/* Probe tuning and actor pool shared by agents of one spider class, read from the first pooled actor. */
+struct FSpiderAgentArchetype
+{
+	UClass* SpiderClass;
+
+	FSpiderProbeSet ProbeSet;
+	FSpiderProbeParams ProbeParams;
+	float AcceptableDistanceSq;
+	float FeetOffset;
+	float TransitionRateInDegrees;
+
+	FCollisionObjectQueryParams ObjectQueryParams;
+	FCollisionQueryParams QueryParams;
+
+	/* Hidden actors waiting for promotion. */
+	TArray<TWeakObjectPtr<ASmartSpiderCharacter> > Pool;
+
+	FSpiderAgentArchetype()
+		: SpiderClass(nullptr)
+		, AcceptableDistanceSq(0)
+		, FeetOffset(0)
+		, TransitionRateInDegrees(0)
+	{
+	}
+};
+
+/*
+* Spiders without actor, kept in packed arrays and walked on surfaces with reduced probes.
+* Agents near players are promoted to pooled spider actors, and demoted back once they move away.
+*/
+class SMARTSPIDER_API FSpiderAgentSystem
+{
+public:
+	FSpiderAgentSystem();
+
+	/* Returns id of new agent, INDEX_NONE if spider class failed to spawn its first actor. */
+	int32 SpawnAgent(UWorld* World, UClass* SpiderClass, const FTransform& Transform, const FVector& Velocity);
+
+	/* Promoted actor goes back to pool. */
+	void DestroyAgent(int32 AgentId);
+
+	void SetVelocity(int32 AgentId, const FVector& Velocity);
+
+	/* Promoted actor of agent, null while agent is lightweight. */
+	ASmartSpiderCharacter* GetActor(int32 AgentId) const;
+
+	FORCEINLINE int32 Num() const { return AgentIds.Num(); }
+	FORCEINLINE int32 NumPromoted() const { return NumPromotedAgents; }
+
+	/* Promote and demote by distance to viewpoints, then move lightweight agents. Must not run in batched pass of swarm. */
+	void Update(UWorld* World, float DeltaTime, const TArray<FTransform>& Viewpoints, FSpiderTraceScheduler& TraceScheduler, UInstancedStaticMeshComponent* Instances);
+
+	void Reset();
+
+private:
+	/* Packed agent state, swapped on removal. */
+	TArray<int32> AgentIds;
+	TArray<int32> ArchetypeIndices;
+	TArray<FVector> Locations;
+	TArray<FQuat> Rotations;
+	TArray<FVector> SurfaceNormals;
+	TArray<EEnvironmentSurface> Surfaces;
+	TArray<FVector> Velocities;
+
+	/* Time since last probe, surface transitions of a probe frame cover all of it. */
+	TArray<float> ProbeDeltaTimes;
+	TArray<TWeakObjectPtr<ASmartSpiderCharacter> > Actors;
+
+	TMap<int32, int32> IdToIndex;
+	int32 NextAgentId;
+	int32 NumPromotedAgents;
+
+	TArray<FSpiderAgentArchetype> Archetypes;
+
+	/* Per frame scratch. */
+	TArray<float> ViewDistancesSq;
+	TArray<int32> PromoteCandidates;
+
+	int32 FindOrAddArchetype(UWorld* World, UClass* SpiderClass);
+	ASmartSpiderCharacter* AcquireActor(UWorld* World, int32 ArchetypeIndex, const FTransform& Transform);
+
+	void Promote(UWorld* World, int32 Index);
+	void Demote(int32 Index);
+	void RemoveAt(int32 Index);
+
+	void Simulate(UWorld* World, int32 Index, float DeltaTime, bool bProbe);
+
+	/* Hide instance of promoted agents by zero scale. */
+	void SyncInstances(UInstancedStaticMeshComponent* Instances) const;
+};
@@ -0,0 +1,300 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderAnimInstance.h"
+#include "SmartSpiderCharacter.h"
+#include "SpiderTraceScheduler.h"
+#include "SpiderStats.h"
+
+namespace SpiderLegIK
+{
+	/* Foot further than this many step distances from target is snapped, e.g. after teleport. */
+	static const float SnapDistanceScale = 4.f;
+}
+
+FSpiderAnimInstanceProxy::FSpiderAnimInstanceProxy()
+	: FSpiderAnimInstanceProxy(nullptr)
+{
+}
+
+FSpiderAnimInstanceProxy::FSpiderAnimInstanceProxy(UAnimInstance* InAnimInstance)
+	: FAnimInstanceProxy(InAnimInstance)
+	, StepDistance(0)
+	, StepDuration(0)
+	, StepHeight(0)
+	, LegCoverageDistance(0)
+	, LegProbeDistance(0)
+	, GaitInterval(1)
+	, MaxLegIKSignificanceTier(0)
+	, FeetLocation(FVector::ZeroVector)
+	, FrameCounter(0)
+	, SpiderId(0)
+	, bLegIKActive(false)
+	, bFeetPlanted(false)
+{
+}
+
+void FSpiderAnimInstanceProxy::Initialize(UAnimInstance* InAnimInstance)
+{
+	FAnimInstanceProxy::Initialize(InAnimInstance);
+
+	const USpiderAnimInstance* Instance = CastChecked<USpiderAnimInstance>(InAnimInstance);
+	Legs = Instance->Legs;
+	StepDistance = Instance->StepDistance;
+	StepDuration = FMath::Max(Instance->StepDuration, KINDA_SMALL_NUMBER);
+	StepHeight = Instance->StepHeight;
+	LegCoverageDistance = Instance->LegCoverageDistance;
+	LegProbeDistance = Instance->LegProbeDistance;
+	GaitInterval = FMath::Max(Instance->GaitInterval, 1);
+	MaxLegIKSignificanceTier = Instance->MaxLegIKSignificanceTier;
+
+	LegStates.Reset();
+	LegStates.SetNum(Legs.Num());
+	bFeetPlanted = false;
+
+	if (ASmartSpiderCharacter* Spider = Cast<ASmartSpiderCharacter>(InAnimInstance->GetOwningActor()))
+	{
+		Spider->SetLegIKConsumer(true);
+	}
+}
+
+void FSpiderAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	FAnimInstanceProxy::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	ASmartSpiderCharacter* Spider = Cast<ASmartSpiderCharacter>(InAnimInstance->GetOwningActor());
+	bLegIKActive = Spider && !Spider->IsPooled() && Spider->GetSignificanceTier() <= MaxLegIKSignificanceTier && Spider->GetLastProbes();
+	if (!bLegIKActive)
+	{
+		bFeetPlanted = false;
+		return;
+	}
+
+	ActorTransform = Spider->GetActorTransform();
+	FeetLocation = Spider->GetActorLocation() - Spider->GetActorUpVector() * Spider->GetFeetOffset();
+	FrameCounter = GFrameCounter;
+	SpiderId = Spider->GetUniqueID();
+
+	GatherProbeHits(Spider);
+
+	UWorld* World = Spider->GetWorld();
+	ConsumeLegProbes(World);
+
+	// Feet of dormant spider stay planted, targets do not move so uncovered legs keep their last probe.
+	if (!Spider->IsDormant())
+	{
+		RequestLegProbes(World, Spider);
+	}
+}
+
+void FSpiderAnimInstanceProxy::GatherProbeHits(const ASmartSpiderCharacter* Spider)
+{
+	// Hits of probes inactive at reduced LOD are left default, not blocking.
+	const FTraceResult& Probes = *Spider->GetLastProbes();
+	const FHitResult* Hits[] =
+	{
+		&Probes.HitResultForward.HitResult,
+		&Probes.HitResultBackward.HitResult,
+		&Probes.HitResultBottom.HitResult,
+		&Probes.HitResultCenter,
+	};
+
+	ProbeLocations.Reset();
+	ProbeNormals.Reset();
+	for (const FHitResult* Hit : Hits)
+	{
+		if (!Hit->bBlockingHit) continue;
+
+		ProbeLocations.Add(Hit->ImpactPoint);
+		ProbeNormals.Add(Hit->ImpactNormal);
+	}
+
+	for (const FHitResult& Hit : Probes.CustomHits)
+	{
+		if (!Hit.bBlockingHit) continue;
+
+		ProbeLocations.Add(Hit.ImpactPoint);
+		ProbeNormals.Add(Hit.ImpactNormal);
+	}
+}
+
+void FSpiderAnimInstanceProxy::ConsumeLegProbes(UWorld* World)
+{
+	for (FSpiderLegState& State : LegStates)
+	{
+		if (!State.ProbeHandle.IsValid()) continue;
+
+		// Missed probe keeps the previous hit, leg falls back to rest location only if it never hit.
+		if (World->QueryTraceData(State.ProbeHandle, TraceDatum) && TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit)
+		{
+			State.ProbeLocation = TraceDatum.OutHits[0].ImpactPoint;
+			State.ProbeNormal = TraceDatum.OutHits[0].ImpactNormal;
+			State.bProbeHit = true;
+		}
+
+		State.ProbeHandle = FTraceHandle();
+	}
+}
+
+void FSpiderAnimInstanceProxy::RequestLegProbes(UWorld* World, ASmartSpiderCharacter* Spider)
+{
+	const FCollisionObjectQueryParams& ObjectQueryParams = Spider->GetProbeObjectQueryParams();
+	if (!ObjectQueryParams.IsValid()) return;
+
+	// Legs were flagged by last update, only on their gait frame so uncovered legs share the cost across frames.
+	int32 NumRequested = 0;
+	for (int32 LegIndex = 0; LegIndex < LegStates.Num(); ++LegIndex)
+	{
+		if (LegStates[LegIndex].bNeedsProbe && IsGaitFrame(LegIndex))
+		{
+			++NumRequested;
+		}
+	}
+
+	// Over budget legs keep their last probe and retry at next gait frame.
+	ASpiderSwarmManager* SwarmManager = Spider->GetSwarmManager();
+	if (NumRequested == 0 || (SwarmManager && !SwarmManager->GetTraceScheduler().TryAcquire(NumRequested))) return;
+
+	const FVector Up = ActorTransform.GetRotation().GetUpVector() * LegProbeDistance;
+	for (int32 LegIndex = 0; LegIndex < LegStates.Num(); ++LegIndex)
+	{
+		FSpiderLegState& State = LegStates[LegIndex];
+		if (!State.bNeedsProbe || !IsGaitFrame(LegIndex)) continue;
+
+		const FVector Rest = GetRestLocation(LegIndex);
+		State.ProbeHandle = World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, Rest + Up, Rest - Up, ObjectQueryParams, Spider->GetProbeQueryParams());
+	}
+
+	if (SwarmManager)
+	{
+		SwarmManager->GetTraceScheduler().NotifyTracesIssued(NumRequested);
+	}
+}
+
+FVector FSpiderAnimInstanceProxy::CalcFootTarget(int32 LegIndex)
+{
+	FSpiderLegState& State = LegStates[LegIndex];
+	const FVector Rest = GetRestLocation(LegIndex);
+
+	int32 Nearest = INDEX_NONE;
+	float NearestDistanceSq = FMath::Square(LegCoverageDistance);
+	for (int32 Index = 0; Index < ProbeLocations.Num(); ++Index)
+	{
+		const float DistanceSq = FVector::DistSquared(ProbeLocations[Index], Rest);
+		if (DistanceSq <= NearestDistanceSq)
+		{
+			NearestDistanceSq = DistanceSq;
+			Nearest = Index;
+		}
+	}
+
+	State.bNeedsProbe = Nearest == INDEX_NONE;
+	if (!State.bNeedsProbe)
+	{
+		return FVector::PointPlaneProject(Rest, ProbeLocations[Nearest], ProbeNormals[Nearest]);
+	}
+
+	return State.bProbeHit ? FVector::PointPlaneProject(Rest, State.ProbeLocation, State.ProbeNormal) : Rest;
+}
+
+void FSpiderAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	FAnimInstanceProxy::Update(DeltaSeconds);
+
+	if (!bLegIKActive) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_SpiderLegIK);
+
+	const FVector Up = ActorTransform.GetRotation().GetUpVector();
+	const float SnapDistanceSq = FMath::Square(StepDistance * SpiderLegIK::SnapDistanceScale);
+	const float StepDistanceSq = FMath::Square(StepDistance);
+
+	uint32 SteppingGroups = 0;
+	for (int32 LegIndex = 0; LegIndex < LegStates.Num(); ++LegIndex)
+	{
+		FSpiderLegState& State = LegStates[LegIndex];
+		State.Target = CalcFootTarget(LegIndex);
+
+		if (!bFeetPlanted || FVector::DistSquared(State.FootLocation, State.Target) > SnapDistanceSq)
+		{
+			State.FootLocation = State.Target;
+			State.bStepping = false;
+			continue;
+		}
+
+		if (State.bStepping)
+		{
+			SteppingGroups |= 1u << Legs[LegIndex].GaitGroup;
+		}
+	}
+
+	for (int32 LegIndex = 0; LegIndex < LegStates.Num(); ++LegIndex)
+	{
+		FSpiderLegState& State = LegStates[LegIndex];
+		const uint32 GroupMask = 1u << Legs[LegIndex].GaitGroup;
+
+		// Planted foot stays in world, it steps only when no other group is in the air.
+		if (!State.bStepping)
+		{
+			if (!IsGaitFrame(LegIndex) || (SteppingGroups & ~GroupMask) != 0) continue;
+			if (FVector::DistSquared(State.FootLocation, State.Target) <= StepDistanceSq) continue;
+
+			State.bStepping = true;
+			State.StepStart = State.FootLocation;
+			State.StepAlpha = 0;
+			SteppingGroups |= GroupMask;
+		}
+
+		// Step follows target while in the air, body keeps moving under it.
+		State.StepAlpha = FMath::Min(State.StepAlpha + DeltaSeconds / StepDuration, 1.f);
+		State.FootLocation = FMath::Lerp(State.StepStart, State.Target, State.StepAlpha) + Up * (FMath::Sin(PI * State.StepAlpha) * StepHeight);
+		if (State.StepAlpha >= 1.f)
+		{
+			State.bStepping = false;
+		}
+	}
+
+	bFeetPlanted = true;
+}
+
+void FSpiderAnimInstanceProxy::PostUpdate(UAnimInstance* InAnimInstance) const
+{
+	FAnimInstanceProxy::PostUpdate(InAnimInstance);
+
+	USpiderAnimInstance* Instance = CastChecked<USpiderAnimInstance>(InAnimInstance);
+	Instance->bLegIKActive = bLegIKActive;
+	if (!bLegIKActive) return;
+
+	Instance->FootLocations.SetNumUninitialized(LegStates.Num(), false);
+	for (int32 LegIndex = 0; LegIndex < LegStates.Num(); ++LegIndex)
+	{
+		Instance->FootLocations[LegIndex] = LegStates[LegIndex].FootLocation;
+	}
+}
+
+USpiderAnimInstance::USpiderAnimInstance()
+{
+	// Tetrapod gait, alternating diagonal groups.
+	Legs.Add(FSpiderLegSettings(FVector(30, -35, 0), 0));
+	Legs.Add(FSpiderLegSettings(FVector(30, 35, 0), 1));
+	Legs.Add(FSpiderLegSettings(FVector(10, -45, 0), 1));
+	Legs.Add(FSpiderLegSettings(FVector(10, 45, 0), 0));
+	Legs.Add(FSpiderLegSettings(FVector(-10, -45, 0), 0));
+	Legs.Add(FSpiderLegSettings(FVector(-10, 45, 0), 1));
+	Legs.Add(FSpiderLegSettings(FVector(-30, -35, 0), 1));
+	Legs.Add(FSpiderLegSettings(FVector(-30, 35, 0), 0));
+
+	StepDistance = 12;
+	StepDuration = 0.12f;
+	StepHeight = 6;
+	LegCoverageDistance = 25;
+	LegProbeDistance = 20;
+	GaitInterval = 2;
+	MaxLegIKSignificanceTier = 1;
+	bLegIKActive = false;
+}
+
+FAnimInstanceProxy* USpiderAnimInstance::CreateAnimInstanceProxy()
+{
+	return new FSpiderAnimInstanceProxy(this);
+}
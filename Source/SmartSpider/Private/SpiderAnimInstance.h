@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "WorldCollision.h"
+#include "SpiderAnimInstance.generated.h"
+
+class ASmartSpiderCharacter;
+
+/* Rest placement of one leg. */
+USTRUCT(BlueprintType)
+struct FSpiderLegSettings
+{
+	GENERATED_USTRUCT_BODY()
+
+	/* Foot at rest, in actor space relative to feet location. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg")
+	FVector RestOffset;
+
+	/* Legs of one group step together, and never while another group is stepping. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg", meta = (ClampMin = "0", ClampMax = "31"))
+	int32 GaitGroup;
+
+	FSpiderLegSettings()
+		: RestOffset(FVector::ZeroVector)
+		, GaitGroup(0)
+	{
+	}
+
+	FSpiderLegSettings(const FVector& InRestOffset, int32 InGaitGroup)
+		: RestOffset(InRestOffset)
+		, GaitGroup(InGaitGroup)
+	{
+	}
+};
+
+/* Runtime state of one leg, owned by animation proxy. */
+struct FSpiderLegState
+{
+	FVector FootLocation;
+	FVector StepStart;
+	FVector Target;
+	float StepAlpha;
+	uint32 bStepping : 1;
+
+	/* Not covered by body probes, probe of its own is issued at its gait frame. */
+	uint32 bNeedsProbe : 1;
+
+	/* Last probe of leg, kept until next one answered. */
+	FTraceHandle ProbeHandle;
+	FVector ProbeLocation;
+	FVector ProbeNormal;
+	uint32 bProbeHit : 1;
+
+	FSpiderLegState()
+		: FootLocation(FVector::ZeroVector)
+		, StepStart(FVector::ZeroVector)
+		, Target(FVector::ZeroVector)
+		, StepAlpha(0)
+		, bStepping(false)
+		, bNeedsProbe(false)
+		, ProbeLocation(FVector::ZeroVector)
+		, ProbeNormal(FVector::UpVector)
+		, bProbeHit(false)
+	{
+	}
+};
+
+/*
+* Leg placement solved on animation worker threads.
+* Game thread part only copies probe hits of spider and issues async probes of uncovered legs.
+*/
+USTRUCT()
+struct SMARTSPIDER_API FSpiderAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FSpiderAnimInstanceProxy();
+	FSpiderAnimInstanceProxy(UAnimInstance* InAnimInstance);
+
+	virtual void Initialize(UAnimInstance* InAnimInstance) override;
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+	virtual void Update(float DeltaSeconds) override;
+	virtual void PostUpdate(UAnimInstance* InAnimInstance) const override;
+
+private:
+	/* Tuning copied from anim instance. */
+	TArray<FSpiderLegSettings> Legs;
+	float StepDistance;
+	float StepDuration;
+	float StepHeight;
+	float LegCoverageDistance;
+	float LegProbeDistance;
+	int32 GaitInterval;
+	int32 MaxLegIKSignificanceTier;
+
+	/* Snapshot of spider taken at pre update. */
+	FTransform ActorTransform;
+	FVector FeetLocation;
+	TArray<FVector> ProbeLocations;
+	TArray<FVector> ProbeNormals;
+	uint64 FrameCounter;
+	uint32 SpiderId;
+
+	TArray<FSpiderLegState> LegStates;
+
+	uint32 bLegIKActive : 1;
+
+	/* Feet were solved at last update, snap them otherwise. */
+	uint32 bFeetPlanted : 1;
+
+	/* Reused when consuming async leg probes to keep its hits allocation. */
+	FTraceDatum TraceDatum;
+
+	void GatherProbeHits(const ASmartSpiderCharacter* Spider);
+	void ConsumeLegProbes(UWorld* World);
+	void RequestLegProbes(UWorld* World, ASmartSpiderCharacter* Spider);
+
+	FORCEINLINE bool IsGaitFrame(int32 LegIndex) const { return (FrameCounter + LegIndex + SpiderId) % GaitInterval == 0; }
+	FORCEINLINE FVector GetRestLocation(int32 LegIndex) const { return FeetLocation + ActorTransform.TransformVector(Legs[LegIndex].RestOffset); }
+
+	/* Rest location projected onto the nearest surface known, flags leg if body probes do not cover it. */
+	FVector CalcFootTarget(int32 LegIndex);
+};
+
+/*
+* Anim instance of spider placing eight feet on surfaces from probes spider already traced.
+* Feed @FootLocations to two bone IK or FABRIK nodes in world space, they run on worker threads as well.
+*/
+UCLASS(ClassGroup = Spider)
+class SMARTSPIDER_API USpiderAnimInstance : public UAnimInstance
+{
+	GENERATED_BODY()
+
+	friend struct FSpiderAnimInstanceProxy;
+
+protected:
+	/* Ordered left to right, front to back by default: L1, R1, L2, R2, L3, R3, L4, R4. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK")
+	TArray<FSpiderLegSettings> Legs;
+
+	/* Planted foot steps once its target is further than this. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK", meta = (ClampMin = "0.0"))
+	float StepDistance;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK", meta = (ClampMin = "0.01"))
+	float StepDuration;
+
+	/* Height of foot arc at middle of a step. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK", meta = (ClampMin = "0.0"))
+	float StepHeight;
+
+	/* Body probe hit within the distance from rest location of leg covers the leg. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK", meta = (ClampMin = "0.0"))
+	float LegCoverageDistance;
+
+	/* Half length of probe of uncovered leg, along up of spider around its rest location. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK", meta = (ClampMin = "0.0"))
+	float LegProbeDistance;
+
+	/* Frames between step decisions of a leg, legs and spiders are staggered across them. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK", meta = (ClampMin = "1"))
+	int32 GaitInterval;
+
+	/* Leg IK is off for spiders of higher significance tier, feet keep animated pose. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Leg IK", meta = (ClampMin = "0"))
+	int32 MaxLegIKSignificanceTier;
+
+	/* World space foot targets, one frame behind the solve. */
+	UPROPERTY(Transient, BlueprintReadOnly, category = "Leg IK")
+	TArray<FVector> FootLocations;
+
+	/* Blend leg IK nodes by it. */
+	UPROPERTY(Transient, BlueprintReadOnly, category = "Leg IK")
+	uint32 bLegIKActive : 1;
+
+public:
+	USpiderAnimInstance();
+
+	UFUNCTION(BlueprintPure, category = "SmartSpider|Leg IK")
+	FVector GetFootLocation(int32 LegIndex) const { return FootLocations.IsValidIndex(LegIndex) ? FootLocations[LegIndex] : FVector::ZeroVector; }
+
+	FORCEINLINE bool IsLegIKActive() const { return !!bLegIKActive; }
+
+protected:
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override;
+};
@@ -0,0 +1,413 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderBenchmark.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "SmartSpiderCharacter.h"
+#include "SpiderMovementComponent.h"
+#include "SpiderSwarmManager.h"
+#include "Engine/StaticMeshActor.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+#include "Misc/FileHelper.h"
+
+namespace SpiderBenchmark
+{
+	static void SpawnBox(UWorld* World, UStaticMesh* Cube, const FVector& Center, const FVector& Size)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		AStaticMeshActor* Box = World->SpawnActor<AStaticMeshActor>(Center, FRotator::ZeroRotator, SpawnParams);
+		if (!Box) return;
+
+		// Static mobility refuses mesh changes once registered in game world.
+		UStaticMeshComponent* Mesh = Box->GetStaticMeshComponent();
+		Mesh->SetMobility(EComponentMobility::Movable);
+		Mesh->SetStaticMesh(Cube);
+		Mesh->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+		Box->SetActorScale3D(Size / 100.f);
+	}
+
+	/* Sum of malloc and realloc calls of all threads, counted by the engine allocator in stats builds. */
+	static FORCEINLINE int64 GetNumAllocations()
+	{
+#if STATS
+		return (int64)FMalloc::TotalMallocCalls + (int64)FMalloc::TotalReallocCalls;
+#else
+		return -1;
+#endif
+	}
+
+	static bool IsAboveBand(double Current, double Expected, double Tolerance, double AbsoluteSlack, double& OutLimit)
+	{
+		// Absolute slack keeps near zero metrics from failing on noise.
+		OutLimit = Expected * (1.0 + Tolerance) + AbsoluteSlack;
+		return Current > OutLimit;
+	}
+}
+
+FSpiderBenchmarkParams::FSpiderBenchmarkParams()
+{
+	SpiderCounts.Add(1);
+	SpiderCounts.Add(100);
+	SpiderCounts.Add(1000);
+	WarmupFrames = 60;
+	Frames = 300;
+	DeltaTime = 1.f / 60.f;
+	SpiderClass = nullptr;
+	TimeTolerance = 0.25f;
+	CountTolerance = 0.1f;
+	OutputDir = FPaths::GameSavedDir() / TEXT("SmartSpider") / TEXT("Benchmark");
+	BaselineDir = FPaths::GameDir() / TEXT("Build") / TEXT("SmartSpider") / TEXT("BenchmarkBaseline");
+	bUpdateBaseline = false;
+}
+
+void FSpiderBenchmarkParams::ParseCommandLine(const TCHAR* CommandLine)
+{
+	FString Counts;
+	if (FParse::Value(CommandLine, TEXT("SpiderBenchmarkCounts="), Counts))
+	{
+		TArray<FString> CountStrings;
+		Counts.ParseIntoArray(CountStrings, TEXT(","));
+		SpiderCounts.Reset();
+		for (const FString& Count : CountStrings)
+		{
+			SpiderCounts.Add(FMath::Max(FCString::Atoi(*Count), 1));
+		}
+	}
+
+	if (FParse::Value(CommandLine, TEXT("SpiderBenchmarkFrames="), Frames))
+	{
+		Frames = FMath::Max(Frames, 1);
+	}
+
+	if (FParse::Value(CommandLine, TEXT("SpiderBenchmarkWarmup="), WarmupFrames))
+	{
+		WarmupFrames = FMath::Max(WarmupFrames, 0);
+	}
+
+	FParse::Value(CommandLine, TEXT("SpiderBenchmarkTimeTolerance="), TimeTolerance);
+	FParse::Value(CommandLine, TEXT("SpiderBenchmarkCountTolerance="), CountTolerance);
+	FParse::Value(CommandLine, TEXT("SpiderBenchmarkOutput="), OutputDir);
+	FParse::Value(CommandLine, TEXT("SpiderBenchmarkBaseline="), BaselineDir);
+
+	FString ClassPath;
+	if (FParse::Value(CommandLine, TEXT("SpiderBenchmarkClass="), ClassPath))
+	{
+		SpiderClass = LoadClass<ASmartSpiderCharacter>(nullptr, *ClassPath);
+		if (!SpiderClass)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("SmartSpider benchmark: spider class %s not found, use ASmartSpiderCharacter."), *ClassPath);
+		}
+	}
+
+	bUpdateBaseline = FParse::Param(CommandLine, TEXT("SpiderBenchmarkUpdateBaseline"));
+}
+
+FString FSpiderBenchmarkParams::GetOutputPath(int32 NumSpiders) const
+{
+	return OutputDir / FString::Printf(TEXT("Spiders_%d.json"), NumSpiders);
+}
+
+FString FSpiderBenchmarkParams::GetBaselinePath(int32 NumSpiders) const
+{
+	return BaselineDir / FString::Printf(TEXT("Spiders_%d.json"), NumSpiders);
+}
+
+void FSpiderBenchmark::BuildLevel(UWorld* World)
+{
+	UStaticMesh* Cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (!Cube)
+	{
+		UE_LOG(LogTemp, Error, TEXT("SmartSpider benchmark: engine cube mesh is missing."));
+		return;
+	}
+
+	const float Thickness = 50;
+
+	// Flat floor.
+	SpiderBenchmark::SpawnBox(World, Cube, FVector(0, 0, -Thickness * 0.5f), FVector(12000, 12000, Thickness));
+
+	// Box rooms with ceiling, open toward the center.
+	const float RoomSize = 2000;
+	const float RoomHeight = 600;
+	for (int32 Corner = 0; Corner < 4; ++Corner)
+	{
+		const FVector Dir((Corner & 1) ? 1.f : -1.f, (Corner & 2) ? 1.f : -1.f, 0.f);
+		const FVector Center = Dir * 3500;
+		const float Half = RoomSize * 0.5f;
+
+		SpiderBenchmark::SpawnBox(World, Cube, Center + FVector(Dir.X * Half, 0, RoomHeight * 0.5f), FVector(Thickness, RoomSize, RoomHeight));
+		SpiderBenchmark::SpawnBox(World, Cube, Center + FVector(0, Dir.Y * Half, RoomHeight * 0.5f), FVector(RoomSize, Thickness, RoomHeight));
+		SpiderBenchmark::SpawnBox(World, Cube, Center + FVector(-Dir.X * Half, Dir.Y * Half * 0.5f, RoomHeight * 0.5f), FVector(Thickness, Half, RoomHeight));
+		SpiderBenchmark::SpawnBox(World, Cube, Center + FVector(0, 0, RoomHeight + Thickness * 0.5f), FVector(RoomSize, RoomSize, Thickness));
+	}
+
+	// Pillars for convex edges.
+	for (int32 X = -1; X <= 1; ++X)
+	{
+		for (int32 Y = -1; Y <= 1; ++Y)
+		{
+			if (X == 0 && Y == 0) continue;
+			SpiderBenchmark::SpawnBox(World, Cube, FVector(X * 1200, Y * 1200, 400), FVector(200, 200, 800));
+		}
+	}
+
+	// L shaped walls for concave corners.
+	for (int32 Side = 0; Side < 4; ++Side)
+	{
+		const FVector Dir = FVector(1, 0, 0).RotateAngleAxis(90.f * Side, FVector::UpVector);
+		const FVector Right = FVector::CrossProduct(FVector::UpVector, Dir);
+		const FVector Corner = Dir * 2200;
+
+		SpiderBenchmark::SpawnBox(World, Cube, Corner + Right * 400 + FVector(0, 0, 300), (Right * 800 + Dir * Thickness).GetAbs() + FVector(0, 0, 600));
+		SpiderBenchmark::SpawnBox(World, Cube, Corner - Dir * 400 + FVector(0, 0, 300), (Dir * 800 + Right * Thickness).GetAbs() + FVector(0, 0, 600));
+	}
+}
+
+FSpiderBenchmarkResult FSpiderBenchmark::RunScenario(const FSpiderBenchmarkParams& Params, int32 NumSpiders)
+{
+	FSpiderBenchmarkResult Result;
+	Result.NumSpiders = NumSpiders;
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("SpiderBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+
+	// No game mode, so no player pawns to disturb the measurement.
+	World->GetWorldSettings()->NotifyBeginPlay();
+
+	BuildLevel(World);
+
+	UClass* SpiderClass = Params.SpiderClass ? Params.SpiderClass : ASmartSpiderCharacter::StaticClass();
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	struct FScriptedSpider
+	{
+		ASmartSpiderCharacter* Spider;
+		float Heading;
+		float TurnRate;
+		EEnvironmentSurface LastSurface;
+	};
+
+	// Deterministic grid and headings, so runs are comparable.
+	FRandomStream Stream(NumSpiders);
+	TArray<FScriptedSpider> Spiders;
+	const int32 GridSize = FMath::CeilToInt(FMath::Sqrt((float)NumSpiders));
+	const float Spacing = 80;
+	for (int32 Index = 0; Index < NumSpiders; ++Index)
+	{
+		const FVector Location((Index % GridSize - GridSize * 0.5f) * Spacing, (Index / GridSize - GridSize * 0.5f) * Spacing, 60.f);
+		ASmartSpiderCharacter* Spider = World->SpawnActor<ASmartSpiderCharacter>(SpiderClass, Location, FRotator(0, Stream.FRandRange(0, 360), 0), SpawnParams);
+		if (!Spider) continue;
+
+		// Scripted input without controllers.
+		Spider->GetCharacterMovement()->bRunPhysicsWithNoController = true;
+		Spiders.Add(FScriptedSpider{ Spider, Stream.FRandRange(0, 2 * PI), Stream.FRandRange(-1, 1), Spider->GetCurrentSurfaceType() });
+	}
+
+	ASpiderSwarmManager* SwarmManager = ASpiderSwarmManager::Get(World);
+
+	double TickSeconds = 0;
+	int64 TracesIssued = 0;
+	int64 AllocationsStart = -1;
+	int32 NumTransitions = 0;
+	float Time = 0;
+
+	const int32 TotalFrames = Params.WarmupFrames + Params.Frames;
+	for (int32 Frame = 0; Frame < TotalFrames; ++Frame)
+	{
+		const bool bMeasure = Frame >= Params.WarmupFrames;
+		if (Frame == Params.WarmupFrames)
+		{
+			AllocationsStart = SpiderBenchmark::GetNumAllocations();
+		}
+
+		Time += Params.DeltaTime;
+		for (FScriptedSpider& Scripted : Spiders)
+		{
+			if (Scripted.Spider->IsPendingKill()) continue;
+
+			const float Heading = Scripted.Heading + Scripted.TurnRate * Time;
+			const FVector Normal = Scripted.Spider->GetCurrentSurfaceNormal();
+			FVector Direction = FVector::VectorPlaneProject(FVector(FMath::Cos(Heading), FMath::Sin(Heading), 0.f), Normal);
+			if (Direction.IsNearlyZero())
+			{
+				Direction = Scripted.Spider->GetActorForwardVector();
+			}
+
+			Scripted.Spider->AddMovementInput(Direction.GetSafeNormal());
+		}
+
+		// Engine loop is not running while the test executes, frame counter drives LOD staggering and trace budget.
+		++GFrameCounter;
+
+		const double StartTime = FPlatformTime::Seconds();
+		World->Tick(LEVELTICK_All, Params.DeltaTime);
+		const double EndTime = FPlatformTime::Seconds();
+
+		for (FScriptedSpider& Scripted : Spiders)
+		{
+			if (Scripted.Spider->IsPendingKill()) continue;
+
+			const EEnvironmentSurface Surface = Scripted.Spider->GetCurrentSurfaceType();
+			if (bMeasure && Surface != Scripted.LastSurface)
+			{
+				++NumTransitions;
+			}
+			Scripted.LastSurface = Surface;
+		}
+
+		if (bMeasure)
+		{
+			TickSeconds += EndTime - StartTime;
+
+			// Trace scheduler rolls over at the first access of a frame, last frame stats are of the previous tick.
+			TracesIssued += SwarmManager ? SwarmManager->GetTraceBudgetStats().TracesIssued : 0;
+		}
+	}
+
+	const int64 AllocationsEnd = SpiderBenchmark::GetNumAllocations();
+	if (AllocationsStart >= 0 && AllocationsEnd >= AllocationsStart)
+	{
+		Result.AllocationsPerFrame = (double)(AllocationsEnd - AllocationsStart) / Params.Frames;
+	}
+
+	Result.MsPerFrame = TickSeconds * 1000.0 / Params.Frames;
+	Result.MsPerSpider = Result.MsPerFrame / FMath::Max(NumSpiders, 1);
+	Result.TracesPerFrame = (double)TracesIssued / Params.Frames;
+	Result.TransitionsPerSecond = NumTransitions / (Params.Frames * Params.DeltaTime);
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+	return Result;
+}
+
+bool FSpiderBenchmark::CompareWithBaseline(const FSpiderBenchmarkParams& Params, const FSpiderBenchmarkResult& Result, TArray<FString>& OutRegressions)
+{
+	const FString BaselinePath = Params.GetBaselinePath(Result.NumSpiders);
+	FString BaselineText;
+	if (!FFileHelper::LoadFileToString(BaselineText, *BaselinePath)) return false;
+
+	TSharedPtr<FJsonObject> Baseline;
+	TSharedRef<TJsonReader<> > Reader = TJsonReaderFactory<>::Create(BaselineText);
+	if (!FJsonSerializer::Deserialize(Reader, Baseline) || !Baseline.IsValid())
+	{
+		OutRegressions.Add(FString::Printf(TEXT("Baseline %s is not valid json."), *BaselinePath));
+		return true;
+	}
+
+	auto CheckMetric = [&](const TCHAR* Name, double Current, double Tolerance, double AbsoluteSlack)
+	{
+		double Expected = 0;
+		if (!Baseline->TryGetNumberField(Name, Expected) || Expected < 0) return;
+
+		double Limit = 0;
+		if (SpiderBenchmark::IsAboveBand(Current, Expected, Tolerance, AbsoluteSlack, Limit))
+		{
+			OutRegressions.Add(FString::Printf(TEXT("%s %.4f exceeds baseline %.4f (limit %.4f)"), Name, Current, Expected, Limit));
+		}
+	};
+
+	// Timing of tiny scenarios is dominated by noise, small absolute slack keeps a single spider from flapping.
+	CheckMetric(TEXT("MsPerSpider"), Result.MsPerSpider, Params.TimeTolerance, 0.002);
+	CheckMetric(TEXT("TracesPerFrame"), Result.TracesPerFrame, Params.CountTolerance, 1.0);
+	if (Result.AllocationsPerFrame >= 0)
+	{
+		CheckMetric(TEXT("AllocationsPerFrame"), Result.AllocationsPerFrame, Params.CountTolerance, 1.0);
+	}
+
+	return true;
+}
+
+bool FSpiderBenchmark::WriteResult(const FString& Path, const FSpiderBenchmarkParams& Params, const FSpiderBenchmarkResult& Result, const TArray<FString>& Regressions)
+{
+	TSharedRef<FJsonObject> Root = MakeShareable(new FJsonObject());
+	Root->SetNumberField(TEXT("Version"), 2);
+	Root->SetNumberField(TEXT("Frames"), Params.Frames);
+	Root->SetNumberField(TEXT("DeltaTime"), Params.DeltaTime);
+	Root->SetNumberField(TEXT("Spiders"), Result.NumSpiders);
+	Root->SetNumberField(TEXT("MsPerFrame"), Result.MsPerFrame);
+	Root->SetNumberField(TEXT("MsPerSpider"), Result.MsPerSpider);
+	Root->SetNumberField(TEXT("TracesPerFrame"), Result.TracesPerFrame);
+	Root->SetNumberField(TEXT("TransitionsPerSecond"), Result.TransitionsPerSecond);
+	Root->SetNumberField(TEXT("AllocationsPerFrame"), Result.AllocationsPerFrame);
+
+	TArray<TSharedPtr<FJsonValue> > RegressionValues;
+	for (const FString& Regression : Regressions)
+	{
+		RegressionValues.Add(MakeShareable(new FJsonValueString(Regression)));
+	}
+	Root->SetArrayField(TEXT("Regressions"), RegressionValues);
+	Root->SetBoolField(TEXT("Passed"), Regressions.Num() == 0);
+
+	FString Output;
+	TSharedRef<TJsonWriter<> > Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Root, Writer);
+
+	return FFileHelper::SaveStringToFile(Output, *Path);
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FSpiderSwarmBenchmarkTest, "SmartSpider.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FSpiderSwarmBenchmarkTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	FSpiderBenchmarkParams Params;
+	Params.ParseCommandLine(FCommandLine::Get());
+
+	for (int32 NumSpiders : Params.SpiderCounts)
+	{
+		OutBeautifiedNames.Add(FString::Printf(TEXT("%d Spiders"), NumSpiders));
+		OutTestCommands.Add(FString::FromInt(NumSpiders));
+	}
+}
+
+bool FSpiderSwarmBenchmarkTest::RunTest(const FString& Parameters)
+{
+	FSpiderBenchmarkParams Params;
+	Params.ParseCommandLine(FCommandLine::Get());
+
+	const int32 NumSpiders = FMath::Max(FCString::Atoi(*Parameters), 1);
+	const FSpiderBenchmarkResult Result = FSpiderBenchmark::RunScenario(Params, NumSpiders);
+
+	AddLogItem(FString::Printf(TEXT("%d spiders: %.3f ms/frame, %.4f ms/spider, %.1f traces/frame, %.2f transitions/s, %.1f allocations/frame"),
+		NumSpiders, Result.MsPerFrame, Result.MsPerSpider, Result.TracesPerFrame, Result.TransitionsPerSecond, Result.AllocationsPerFrame));
+
+	TArray<FString> Regressions;
+	if (Params.bUpdateBaseline)
+	{
+		const FString BaselinePath = Params.GetBaselinePath(NumSpiders);
+		if (!FSpiderBenchmark::WriteResult(BaselinePath, Params, Result, Regressions))
+		{
+			AddError(FString::Printf(TEXT("Failed to write baseline %s."), *BaselinePath));
+		}
+	}
+	else if (!FSpiderBenchmark::CompareWithBaseline(Params, Result, Regressions))
+	{
+		AddWarning(FString::Printf(TEXT("No baseline at %s, run with -SpiderBenchmarkUpdateBaseline to record one."), *Params.GetBaselinePath(NumSpiders)));
+	}
+
+	for (const FString& Regression : Regressions)
+	{
+		AddError(FString::Printf(TEXT("%d spiders: %s"), NumSpiders, *Regression));
+	}
+
+	const FString OutputPath = Params.GetOutputPath(NumSpiders);
+	if (!FSpiderBenchmark::WriteResult(OutputPath, Params, Result, Regressions))
+	{
+		AddWarning(FString::Printf(TEXT("Failed to write results %s."), *OutputPath));
+	}
+
+	return Regressions.Num() == 0;
+}
+
+#endif
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/* Arguments of swarm benchmark, parsed from command line of the automation run. */
+struct FSpiderBenchmarkParams
+{
+	/* Spider counts, one test per count. */
+	TArray<int32> SpiderCounts;
+
+	/* Frames simulated before measuring, so spiders settle on surfaces. */
+	int32 WarmupFrames;
+	int32 Frames;
+	float DeltaTime;
+
+	/* Spider class to spawn, null for ASmartSpiderCharacter. */
+	UClass* SpiderClass;
+
+	/* Relative regression allowed against baseline, timings are noisier than counts so they get their own band. */
+	float TimeTolerance;
+	float CountTolerance;
+
+	FString OutputDir;
+	FString BaselineDir;
+
+	/* Write the result as the new baseline instead of comparing. */
+	bool bUpdateBaseline;
+
+	FSpiderBenchmarkParams();
+
+	/* e.g. -SpiderBenchmarkCounts=1,100,1000 -SpiderBenchmarkFrames=300 -SpiderBenchmarkClass=/Game/BP_Spider.BP_Spider_C -SpiderBenchmarkUpdateBaseline */
+	void ParseCommandLine(const TCHAR* CommandLine);
+
+	FString GetOutputPath(int32 NumSpiders) const;
+	FString GetBaselinePath(int32 NumSpiders) const;
+};
+
+/* Measurements of one scenario. */
+struct FSpiderBenchmarkResult
+{
+	int32 NumSpiders;
+	double MsPerFrame;
+	double MsPerSpider;
+	double TracesPerFrame;
+	double TransitionsPerSecond;
+
+	/* Malloc and realloc calls of all threads, negative if stats are compiled out. */
+	double AllocationsPerFrame;
+
+	FSpiderBenchmarkResult()
+		: NumSpiders(0), MsPerFrame(0), MsPerSpider(0), TracesPerFrame(0), TransitionsPerSecond(0), AllocationsPerFrame(-1)
+	{
+	}
+};
+
+/*
+* Headless swarm benchmark on a procedural level of floor, box rooms, pillars, corners and ceilings.
+* Spiders walk scripted headings for fixed frames in a private game world, so it runs with -nullrhi.
+* Run as automation tests, e.g. UE4Editor-Cmd Project -nullrhi -ExecCmds="Automation RunTests SmartSpider.Benchmark; Quit".
+*/
+class FSpiderBenchmark
+{
+public:
+	static FSpiderBenchmarkResult RunScenario(const FSpiderBenchmarkParams& Params, int32 NumSpiders);
+
+	/* Regressions of result against baseline of the same spider count, false if baseline is missing. */
+	static bool CompareWithBaseline(const FSpiderBenchmarkParams& Params, const FSpiderBenchmarkResult& Result, TArray<FString>& OutRegressions);
+
+	static bool WriteResult(const FString& Path, const FSpiderBenchmarkParams& Params, const FSpiderBenchmarkResult& Result, const TArray<FString>& Regressions);
+
+private:
+	static void BuildLevel(UWorld* World);
+};
+
+#endif
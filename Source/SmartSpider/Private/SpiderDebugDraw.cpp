@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderDebugDraw.h"
+
+#if ENABLE_DRAW_DEBUG
+
+static TAutoConsoleVariable<int32> CVarSpiderDebugProbes(
+	TEXT("SmartSpider.DebugProbes"),
+	0,
+	TEXT("Draw environment probes of spiders.\n")
+	TEXT(" 0: off\n")
+	TEXT(" 1: all spiders\n")
+	TEXT(" 2: spiders selected in editor\n")
+	TEXT(" 3: spiders nearest to player viewpoint, see SmartSpider.DebugProbes.Nearest"));
+
+static TAutoConsoleVariable<int32> CVarSpiderDebugProbesNearest(
+	TEXT("SmartSpider.DebugProbes.Nearest"),
+	8,
+	TEXT("Number of spiders drawn when SmartSpider.DebugProbes is 3."));
+
+static TAutoConsoleVariable<int32> CVarSpiderDebugProbesMaxSegments(
+	TEXT("SmartSpider.DebugProbes.MaxSegments"),
+	8192,
+	TEXT("Probes recorded per frame at most, oldest are dropped beyond it."));
+
+namespace SpiderDebugDraw
+{
+	enum EMode
+	{
+		Off = 0,
+		All = 1,
+		Selected = 2,
+		Nearest = 3,
+	};
+
+	static const float ImpactPointSize = 16.f;
+}
+
+FSpiderDebugDraw::FSpiderDebugDraw()
+	: Head(0)
+	, Count(0)
+{
+}
+
+bool FSpiderDebugDraw::IsEnabled()
+{
+	return CVarSpiderDebugProbes.GetValueOnGameThread() != SpiderDebugDraw::Off;
+}
+
+bool FSpiderDebugDraw::ShouldRecord(const AActor* Spider)
+{
+	switch (CVarSpiderDebugProbes.GetValueOnGameThread())
+	{
+		case SpiderDebugDraw::All:
+		case SpiderDebugDraw::Nearest:
+			return true;
+
+		// Spiders of PIE world are selectable after eject or in simulate.
+		case SpiderDebugDraw::Selected:
+#if WITH_EDITOR
+			return Spider->IsSelected();
+#else
+			return false;
+#endif
+
+		default:
+			return false;
+	}
+}
+
+void FSpiderDebugDraw::RecordProbe(const AActor* Spider, const FHitResult& Hit, const FVector& Start, const FVector& End, const FLinearColor& TraceColor, const FLinearColor& TraceHitColor)
+{
+	const int32 Capacity = FMath::Max(CVarSpiderDebugProbesMaxSegments.GetValueOnGameThread(), 1);
+	if (Segments.Num() != Capacity)
+	{
+		Segments.SetNumUninitialized(Capacity);
+		Head = 0;
+		Count = 0;
+	}
+
+	FSpiderDebugSegment& Segment = Segments[Head];
+	Segment.Start = Start;
+	Segment.End = End;
+	Segment.ImpactPoint = Hit.ImpactPoint;
+	Segment.TraceColor = TraceColor.ToFColor(true);
+	Segment.TraceHitColor = TraceHitColor.ToFColor(true);
+	Segment.SpiderId = Spider->GetUniqueID();
+	Segment.bHit = Hit.bBlockingHit;
+
+	Head = (Head + 1) % Capacity;
+	Count = FMath::Min(Count + 1, Capacity);
+}
+
+void FSpiderDebugDraw::Flush(UWorld* World)
+{
+	if (Count == 0) return;
+
+	ULineBatcherComponent* LineBatcher = World ? World->LineBatcher : nullptr;
+	if (!LineBatcher || !IsEnabled())
+	{
+		Reset();
+		return;
+	}
+
+	const bool bNearestOnly = CVarSpiderDebugProbes.GetValueOnGameThread() == SpiderDebugDraw::Nearest;
+	if (bNearestOnly)
+	{
+		FilterNearestSpiders(World, CVarSpiderDebugProbesNearest.GetValueOnGameThread());
+	}
+
+	const int32 Capacity = Segments.Num();
+	const int32 Oldest = (Head - Count + Capacity) % Capacity;
+	Lines.Reset();
+	for (int32 Offset = 0; Offset < Count; ++Offset)
+	{
+		const FSpiderDebugSegment& Segment = Segments[(Oldest + Offset) % Capacity];
+		if (bNearestOnly && !NearestSpiders.Contains(Segment.SpiderId)) continue;
+
+		if (Segment.bHit)
+		{
+			Lines.Add(FBatchedLine(Segment.Start, Segment.ImpactPoint, Segment.TraceColor, 0.f, 0.f, SDPG_World));
+			Lines.Add(FBatchedLine(Segment.ImpactPoint, Segment.End, Segment.TraceHitColor, 0.f, 0.f, SDPG_World));
+			LineBatcher->DrawPoint(Segment.ImpactPoint, Segment.TraceColor, SpiderDebugDraw::ImpactPointSize, SDPG_World);
+		}
+		else
+		{
+			Lines.Add(FBatchedLine(Segment.Start, Segment.End, Segment.TraceColor, 0.f, 0.f, SDPG_World));
+		}
+	}
+
+	LineBatcher->DrawLines(Lines);
+
+	Head = 0;
+	Count = 0;
+}
+
+void FSpiderDebugDraw::FilterNearestSpiders(UWorld* World, int32 MaxSpiders)
+{
+	FVector ViewLocation = FVector::ZeroVector;
+	FRotator ViewRotation;
+	if (APlayerController* PlayerController = World->GetFirstPlayerController())
+	{
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	}
+
+	// Probes start around spider, the closest start stands for the spider.
+	const int32 Capacity = Segments.Num();
+	const int32 Oldest = (Head - Count + Capacity) % Capacity;
+	SpiderDistancesSq.Reset();
+	for (int32 Offset = 0; Offset < Count; ++Offset)
+	{
+		const FSpiderDebugSegment& Segment = Segments[(Oldest + Offset) % Capacity];
+		const float DistanceSq = FVector::DistSquared(Segment.Start, ViewLocation);
+		if (float* SpiderDistanceSq = SpiderDistancesSq.Find(Segment.SpiderId))
+		{
+			*SpiderDistanceSq = FMath::Min(*SpiderDistanceSq, DistanceSq);
+		}
+		else
+		{
+			SpiderDistancesSq.Add(Segment.SpiderId, DistanceSq);
+		}
+	}
+
+	SpiderDistancesSq.ValueSort(TLess<float>());
+
+	NearestSpiders.Reset();
+	for (const TPair<uint32, float>& Pair : SpiderDistancesSq)
+	{
+		if (NearestSpiders.Num() >= MaxSpiders) break;
+		NearestSpiders.Add(Pair.Key);
+	}
+}
+
+void FSpiderDebugDraw::Reset()
+{
+	Head = 0;
+	Count = 0;
+}
+
+#endif
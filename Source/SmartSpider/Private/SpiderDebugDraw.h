@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+#include "Components/LineBatchComponent.h"
+
+#if ENABLE_DRAW_DEBUG
+
+/* Probe ray recorded for debug drawing, split at impact point if hit. */
+struct FSpiderDebugSegment
+{
+	FVector Start;
+	FVector End;
+	FVector ImpactPoint;
+	FColor TraceColor;
+	FColor TraceHitColor;
+
+	/* Unique id of spider, for nearest spiders filter. */
+	uint32 SpiderId;
+	bool bHit;
+};
+
+/*
+* Probe visualization of all spiders of a world, switched by console variable SmartSpider.DebugProbes.
+* Probes are recorded into a bounded ring buffer and drawn by line batcher in one pass per frame,
+* so nothing but a console variable read is paid when it is off.
+*/
+class SMARTSPIDER_API FSpiderDebugDraw
+{
+public:
+	FSpiderDebugDraw();
+
+	/* Cheap check before building anything to record. */
+	static bool IsEnabled();
+
+	/* Whether probes of spider pass the filter of current mode, nearest spiders are filtered at flush. */
+	static bool ShouldRecord(const AActor* Spider);
+
+	void RecordProbe(const AActor* Spider, const FHitResult& Hit, const FVector& Start, const FVector& End, const FLinearColor& TraceColor, const FLinearColor& TraceHitColor);
+
+	/* Draw recorded probes for one frame and empty the buffer. */
+	void Flush(UWorld* World);
+
+	void Reset();
+
+private:
+	TArray<FSpiderDebugSegment> Segments;
+
+	/* Next slot to write, oldest segments are overwritten once buffer is full. */
+	int32 Head;
+	int32 Count;
+
+	/* Per flush scratch. */
+	TArray<FBatchedLine> Lines;
+	TMap<uint32, float> SpiderDistancesSq;
+	TSet<uint32> NearestSpiders;
+
+	/* Keep spiders closest to player viewpoint when mode is nearest spiders. */
+	void FilterNearestSpiders(UWorld* World, int32 MaxSpiders);
+};
+
+#endif
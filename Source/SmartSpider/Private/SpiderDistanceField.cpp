@@ -0,0 +1,308 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderDistanceField.h"
+
+namespace SpiderDistanceField
+{
+	/* Bump when layout of serialized arrays or what is baked changes. */
+	static const int32 SerializeVersion = 2;
+
+	/* Marching steps at least this many voxels, so grazing rays do not stall along surfaces. */
+	static const float MinStepVoxels = 0.1f;
+
+	/* Marching steps this much of sampled distance, quantized distances may overestimate slightly. */
+	static const float StepScale = 0.9f;
+
+	static const int32 MaxSteps = 64;
+}
+
+FSpiderDistanceFieldData::FSpiderDistanceFieldData()
+	: Origin(FVector::ZeroVector)
+	, VoxelSize(10)
+	, MaxDistance(40)
+	, NumBricks(FIntVector::ZeroValue)
+	, ObjectTypeMask(0)
+{
+	Bounds.Init();
+}
+
+bool FSpiderDistanceFieldData::Serialize(FArchive& Ar)
+{
+	int32 Version = SpiderDistanceField::SerializeVersion;
+	Ar << Version;
+
+	if (Ar.IsLoading() && Version > SpiderDistanceField::SerializeVersion)
+	{
+		Ar.SetError();
+		return false;
+	}
+
+	Ar << Origin;
+	Ar << VoxelSize;
+	Ar << MaxDistance;
+	Ar << NumBricks;
+	Ar << Bounds;
+	Ar << ObjectTypeMask;
+
+	BrickIndices.BulkSerialize(Ar);
+	Samples.BulkSerialize(Ar);
+
+	// Version 1 left stationary bodies out of the field, and spiders no longer trace static bodies of baked types.
+	if (Version < 2)
+	{
+		*this = FSpiderDistanceFieldData();
+		return false;
+	}
+
+	return true;
+}
+
+float FSpiderDistanceFieldData::SampleDistance(const FVector& Location) const
+{
+	if (IsEmpty()) return MaxDistance;
+
+	const FVector Local = (Location - Origin) / VoxelSize;
+	const FIntVector Cell(FMath::FloorToInt(Local.X), FMath::FloorToInt(Local.Y), FMath::FloorToInt(Local.Z));
+	const FIntVector Brick(Cell.X / BrickCells, Cell.Y / BrickCells, Cell.Z / BrickCells);
+	if (Cell.X < 0 || Cell.Y < 0 || Cell.Z < 0 || Brick.X >= NumBricks.X || Brick.Y >= NumBricks.Y || Brick.Z >= NumBricks.Z)
+	{
+		return MaxDistance;
+	}
+
+	const int32 BrickIndex = GetBrickIndex(Brick);
+	if (BrickIndex == EmptyBrick) return MaxDistance;
+	if (BrickIndex == SolidBrick) return -MaxDistance;
+
+	// Cell and the samples after it are in the same brick, border samples are shared with the next brick.
+	const FIntVector InBrick = Cell - Brick * BrickCells;
+	const uint8* BrickData = &Samples[BrickIndex + (InBrick.Z * BrickSize + InBrick.Y) * BrickSize + InBrick.X];
+	const int32 StrideY = BrickSize;
+	const int32 StrideZ = BrickSize * BrickSize;
+	const FVector Alpha = Local - FVector(Cell.X, Cell.Y, Cell.Z);
+
+	const float X00 = FMath::Lerp(DequantizeDistance(BrickData[0]), DequantizeDistance(BrickData[1]), Alpha.X);
+	const float X10 = FMath::Lerp(DequantizeDistance(BrickData[StrideY]), DequantizeDistance(BrickData[StrideY + 1]), Alpha.X);
+	const float X01 = FMath::Lerp(DequantizeDistance(BrickData[StrideZ]), DequantizeDistance(BrickData[StrideZ + 1]), Alpha.X);
+	const float X11 = FMath::Lerp(DequantizeDistance(BrickData[StrideZ + StrideY]), DequantizeDistance(BrickData[StrideZ + StrideY + 1]), Alpha.X);
+
+	return FMath::Lerp(FMath::Lerp(X00, X10, Alpha.Y), FMath::Lerp(X01, X11, Alpha.Y), Alpha.Z);
+}
+
+FVector FSpiderDistanceFieldData::SampleNormal(const FVector& Location) const
+{
+	const float Offset = VoxelSize * 0.5f;
+	const FVector Gradient(
+		SampleDistance(Location + FVector(Offset, 0.f, 0.f)) - SampleDistance(Location - FVector(Offset, 0.f, 0.f)),
+		SampleDistance(Location + FVector(0.f, Offset, 0.f)) - SampleDistance(Location - FVector(0.f, Offset, 0.f)),
+		SampleDistance(Location + FVector(0.f, 0.f, Offset)) - SampleDistance(Location - FVector(0.f, 0.f, Offset)));
+
+	return Gradient.GetSafeNormal();
+}
+
+bool FSpiderDistanceFieldData::LineTrace(const FVector& Start, const FVector& End, FHitResult& OutHit) const
+{
+	OutHit = FHitResult(Start, End);
+
+	const FVector Delta = End - Start;
+	const float Length = Delta.Size();
+	if (Length < KINDA_SMALL_NUMBER) return false;
+
+	const FVector Dir = Delta / Length;
+	const float MinStep = VoxelSize * SpiderDistanceField::MinStepVoxels;
+
+	// Sphere tracing, steps by distance to the nearest surface until the sign flips, then the crossing is interpolated.
+	float Time = 0.f;
+	float Distance = SampleDistance(Start);
+	float HitTime = Distance <= 0.f ? 0.f : -1.f;
+	for (int32 Step = 0; HitTime < 0.f && Time < Length && Step < SpiderDistanceField::MaxSteps; ++Step)
+	{
+		const float NextTime = FMath::Min(Time + FMath::Max(Distance * SpiderDistanceField::StepScale, MinStep), Length);
+		const float NextDistance = SampleDistance(Start + Dir * NextTime);
+		if (NextDistance <= 0.f)
+		{
+			HitTime = FMath::Lerp(Time, NextTime, Distance / FMath::Max(Distance - NextDistance, KINDA_SMALL_NUMBER));
+		}
+
+		Time = NextTime;
+		Distance = NextDistance;
+	}
+
+	if (HitTime < 0.f) return false;
+
+	const FVector ImpactPoint = Start + Dir * HitTime;
+	const FVector Normal = SampleNormal(ImpactPoint);
+
+	OutHit.bBlockingHit = true;
+	OutHit.bStartPenetrating = HitTime == 0.f;
+	OutHit.Time = HitTime / Length;
+	OutHit.Distance = HitTime;
+	OutHit.Location = ImpactPoint;
+	OutHit.ImpactPoint = ImpactPoint;
+	OutHit.Normal = Normal;
+	OutHit.ImpactNormal = Normal;
+
+	return true;
+}
+
+USpiderDistanceField::USpiderDistanceField()
+	: Data(MakeShareable(new FSpiderDistanceFieldData()))
+{
+	NumStoredBricks = 0;
+	SizeKB = 0;
+}
+
+void USpiderDistanceField::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	if (Ar.IsLoading())
+	{
+		TSharedRef<FSpiderDistanceFieldData, ESPMode::ThreadSafe> LoadedData = MakeShareable(new FSpiderDistanceFieldData());
+		if (!LoadedData->Serialize(Ar))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Distance field %s was baked by an incompatible version and is dropped, rebake it."), *GetPathName());
+			LoadedData = MakeShareable(new FSpiderDistanceFieldData());
+		}
+		Data = LoadedData;
+	}
+	else
+	{
+		const_cast<FSpiderDistanceFieldData&>(*Data).Serialize(Ar);
+	}
+
+	UpdateStats();
+}
+
+void USpiderDistanceField::UpdateStats()
+{
+	NumStoredBricks = Data->Samples.Num() / FSpiderDistanceFieldData::BrickSamples;
+	SizeKB = (Data->Samples.Num() + Data->BrickIndices.Num() * sizeof(int32)) / 1024;
+}
+
+#if WITH_EDITOR
+void USpiderDistanceField::Bake(UWorld* World, const FBox& InBounds, const FSpiderDistanceFieldBakeParams& Params, const TArray<AActor*>& ActorsToIgnore)
+{
+	check(World);
+
+	typedef FSpiderDistanceFieldData FField;
+
+	TSharedRef<FSpiderDistanceFieldData, ESPMode::ThreadSafe> NewData = MakeShareable(new FSpiderDistanceFieldData());
+	FSpiderDistanceFieldData& Field = *NewData;
+
+	FCollisionObjectQueryParams ObjectQueryParams;
+	for (const TEnumAsByte<EObjectTypeQuery>& ObjectType : Params.QueryObjectsType)
+	{
+		const ECollisionChannel Channel = UEngineTypes::ConvertToCollisionChannel(ObjectType);
+		ObjectQueryParams.AddObjectTypesToQuery(Channel);
+		Field.ObjectTypeMask |= ECC_TO_BITFIELD(Channel);
+	}
+
+	static const FName BakeTraceTag(TEXT("SpiderDistanceFieldBake"));
+	FCollisionQueryParams QueryParams(BakeTraceTag, false);
+	QueryParams.AddIgnoredActors(ActorsToIgnore);
+
+	const float VoxelSize = Params.VoxelSize;
+	const float BrickSpan = VoxelSize * FField::BrickCells;
+	const FVector Size = InBounds.GetSize();
+
+	Field.Origin = InBounds.Min;
+	Field.VoxelSize = VoxelSize;
+	Field.MaxDistance = Params.MaxDistance;
+	Field.NumBricks = FIntVector(FMath::Max(FMath::CeilToInt(Size.X / BrickSpan), 1), FMath::Max(FMath::CeilToInt(Size.Y / BrickSpan), 1), FMath::Max(FMath::CeilToInt(Size.Z / BrickSpan), 1));
+	Field.Bounds = FBox(Field.Origin, Field.Origin + FVector(Field.NumBricks.X, Field.NumBricks.Y, Field.NumBricks.Z) * BrickSpan);
+	Field.BrickIndices.Init(FField::EmptyBrick, Field.NumBricks.X * Field.NumBricks.Y * Field.NumBricks.Z);
+
+	TArray<FOverlapResult> Overlaps;
+	TArray<UPrimitiveComponent*> Components;
+	float Distances[FField::BrickSamples];
+	bool Inside[FField::BrickSamples];
+
+	for (int32 BrickZ = 0; BrickZ < Field.NumBricks.Z && ObjectQueryParams.IsValid(); ++BrickZ)
+	{
+		for (int32 BrickY = 0; BrickY < Field.NumBricks.Y; ++BrickY)
+		{
+			for (int32 BrickX = 0; BrickX < Field.NumBricks.X; ++BrickX)
+			{
+				const FVector BrickMin = Field.Origin + FVector(BrickX, BrickY, BrickZ) * BrickSpan;
+				const FBox QueryBox(BrickMin - FVector(Params.MaxDistance), BrickMin + FVector(BrickSpan + Params.MaxDistance));
+
+				// Movable components are left to physics traces of spiders, stationary ones can not move in game.
+				Overlaps.Reset();
+				Components.Reset();
+				World->OverlapMultiByObjectType(Overlaps, QueryBox.GetCenter(), FQuat::Identity, ObjectQueryParams, FCollisionShape::MakeBox(QueryBox.GetExtent()), QueryParams);
+				for (const FOverlapResult& Overlap : Overlaps)
+				{
+					UPrimitiveComponent* Component = Overlap.GetComponent();
+					if (Component && Component->Mobility != EComponentMobility::Movable)
+					{
+						Components.AddUnique(Component);
+					}
+				}
+
+				if (Components.Num() == 0) continue;
+
+				bool bAnyNear = false;
+				bool bAnyOutside = false;
+				for (int32 Sample = 0; Sample < FField::BrickSamples; ++Sample)
+				{
+					const FVector Location = BrickMin + FVector(Sample % FField::BrickSize, (Sample / FField::BrickSize) % FField::BrickSize, Sample / (FField::BrickSize * FField::BrickSize)) * VoxelSize;
+
+					float Distance = Params.MaxDistance;
+					for (UPrimitiveComponent* Component : Components)
+					{
+						FVector ClosestPoint;
+						const float ComponentDistance = Component->GetDistanceToCollision(Location, ClosestPoint);
+						if (ComponentDistance >= 0.f)
+						{
+							Distance = FMath::Min(Distance, ComponentDistance);
+						}
+					}
+
+					Inside[Sample] = Distance <= 0.f;
+					Distances[Sample] = Distance;
+					bAnyNear |= Distance < Params.MaxDistance;
+					bAnyOutside |= !Inside[Sample];
+				}
+
+				int32& BrickIndex = Field.BrickIndices[(BrickZ * Field.NumBricks.Y + BrickY) * Field.NumBricks.X + BrickX];
+				if (!bAnyNear) continue;
+				if (!bAnyOutside)
+				{
+					BrickIndex = FField::SolidBrick;
+					continue;
+				}
+
+				// Physics only tells inside, depth is taken from the nearest outside neighbor so the surface falls between the two.
+				static const FIntVector NeighborOffsets[] = { FIntVector(1, 0, 0), FIntVector(-1, 0, 0), FIntVector(0, 1, 0), FIntVector(0, -1, 0), FIntVector(0, 0, 1), FIntVector(0, 0, -1) };
+				BrickIndex = Field.Samples.AddUninitialized(FField::BrickSamples);
+				for (int32 Sample = 0; Sample < FField::BrickSamples; ++Sample)
+				{
+					float Distance = Distances[Sample];
+					if (Inside[Sample])
+					{
+						const FIntVector SampleCell(Sample % FField::BrickSize, (Sample / FField::BrickSize) % FField::BrickSize, Sample / (FField::BrickSize * FField::BrickSize));
+						Distance = -Params.MaxDistance;
+						for (const FIntVector& Offset : NeighborOffsets)
+						{
+							const FIntVector Neighbor = SampleCell + Offset;
+							if (Neighbor.X < 0 || Neighbor.Y < 0 || Neighbor.Z < 0 || Neighbor.X >= FField::BrickSize || Neighbor.Y >= FField::BrickSize || Neighbor.Z >= FField::BrickSize) continue;
+
+							const int32 NeighborSample = (Neighbor.Z * FField::BrickSize + Neighbor.Y) * FField::BrickSize + Neighbor.X;
+							if (!Inside[NeighborSample])
+							{
+								Distance = FMath::Max(Distance, Distances[NeighborSample] - VoxelSize);
+							}
+						}
+					}
+
+					Field.Samples[BrickIndex + Sample] = FField::QuantizeDistance(Distance, Params.MaxDistance);
+				}
+			}
+		}
+	}
+
+	Data = NewData;
+	UpdateStats();
+}
+#endif
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Engine/DataAsset.h"
+#include "EnvironmentTraceHit.h"
+#include "SpiderDistanceField.generated.h"
+
+/* Tuning of distance field bake. */
+USTRUCT(BlueprintType)
+struct FSpiderDistanceFieldBakeParams
+{
+	GENERATED_USTRUCT_BODY()
+
+	/* Climbable objects, keep the same as @QueryObjectsType of spiders. Spiders still trace other object types. */
+	UPROPERTY(EditAnywhere, category = "Bake")
+	TArray<TEnumAsByte<EObjectTypeQuery> > QueryObjectsType;
+
+	/* Distance between samples. Walls thinner than it may be missed by probes. */
+	UPROPERTY(EditAnywhere, category = "Bake", meta = (ClampMin = "1.0"))
+	float VoxelSize;
+
+	/* Distances are stored within this band around surfaces, bricks further from any surface are not stored. */
+	UPROPERTY(EditAnywhere, category = "Bake", meta = (ClampMin = "1.0"))
+	float MaxDistance;
+
+	FSpiderDistanceFieldBakeParams()
+	{
+		QueryObjectsType.Add(UEngineTypes::ConvertToObjectType(ECollisionChannel::ECC_WorldStatic));
+		VoxelSize = 10;
+		MaxDistance = 40;
+	}
+};
+
+/*
+* Signed distance to static and stationary climbable collision, sampled on a grid and split into bricks of BrickSize^3 samples.
+* Only bricks crossing the band around surfaces are stored, at one byte per sample. Neighbor bricks share border samples,
+* so trilinear sampling reads a single brick. Immutable once built, so spiders can sample it from worker threads.
+*/
+struct SMARTSPIDER_API FSpiderDistanceFieldData
+{
+	static const int32 BrickSize = 8;
+	static const int32 BrickCells = BrickSize - 1;
+	static const int32 BrickSamples = BrickSize * BrickSize * BrickSize;
+
+	/* Brick index of bricks not stored, further than max distance outside or inside of collision. */
+	static const int32 EmptyBrick = -1;
+	static const int32 SolidBrick = -2;
+
+	FVector Origin;
+	float VoxelSize;
+	float MaxDistance;
+	FIntVector NumBricks;
+	FBox Bounds;
+
+	/* Collision channels baked into the field, as bits of ECollisionChannel. */
+	int32 ObjectTypeMask;
+
+	/* Dense grid of bricks, index of first sample in @Samples or EmptyBrick or SolidBrick. */
+	TArray<int32> BrickIndices;
+
+	/* Quantized distances of stored bricks, X fastest. */
+	TArray<uint8> Samples;
+
+	FSpiderDistanceFieldData();
+
+	/* Plain arrays are bulk serialized, loading does no per-element parsing. False if data of another version is dropped. */
+	bool Serialize(FArchive& Ar);
+
+	FORCEINLINE bool IsEmpty() const { return BrickIndices.Num() == 0; }
+	FORCEINLINE int32 GetBrickIndex(const FIntVector& Brick) const { return BrickIndices[(Brick.Z * NumBricks.Y + Brick.Y) * NumBricks.X + Brick.X]; }
+
+	/* Signed distance, negative inside of collision, max distance outside of bounds or far from surfaces. */
+	float SampleDistance(const FVector& Location) const;
+
+	/* Unit gradient of distance, the surface normal near surfaces. */
+	FVector SampleNormal(const FVector& Location) const;
+
+	/* March segment along the field, hit has no component. Segment should be inside bounds. */
+	bool LineTrace(const FVector& Start, const FVector& End, FHitResult& OutHit) const;
+
+	static FORCEINLINE uint8 QuantizeDistance(float Distance, float InMaxDistance)
+	{
+		return (uint8)FMath::RoundToInt((FMath::Clamp(Distance / InMaxDistance, -1.f, 1.f) * 0.5f + 0.5f) * 255.f);
+	}
+
+	FORCEINLINE float DequantizeDistance(uint8 Value) const
+	{
+		return (Value / 255.f * 2.f - 1.f) * MaxDistance;
+	}
+};
+
+typedef TSharedRef<const FSpiderDistanceFieldData, ESPMode::ThreadSafe> FSpiderDistanceFieldDataRef;
+
+/* Asset of baked distance field, one per sublevel so it streams with the level. */
+UCLASS(BlueprintType)
+class SMARTSPIDER_API USpiderDistanceField : public UDataAsset
+{
+	GENERATED_BODY()
+
+protected:
+	FSpiderDistanceFieldDataRef Data;
+
+	UPROPERTY(VisibleAnywhere, Transient, category = "Distance Field")
+	int32 NumStoredBricks;
+
+	/* Memory of stored samples and brick grid, in kilobytes. */
+	UPROPERTY(VisibleAnywhere, Transient, category = "Distance Field")
+	int32 SizeKB;
+
+	void UpdateStats();
+
+public:
+	USpiderDistanceField();
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	FORCEINLINE const FSpiderDistanceFieldDataRef& GetData() const { return Data; }
+
+	FORCEINLINE bool IsEmpty() const { return Data->IsEmpty(); }
+	FORCEINLINE const FBox& GetBounds() const { return Data->Bounds; }
+
+#if WITH_EDITOR
+	/* Sample distance to static collision within bounds of the world, replaces current field. */
+	void Bake(UWorld* World, const FBox& InBounds, const FSpiderDistanceFieldBakeParams& Params, const TArray<AActor*>& ActorsToIgnore);
+#endif
+};
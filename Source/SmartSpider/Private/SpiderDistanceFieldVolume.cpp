@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderDistanceFieldVolume.h"
+#include "SpiderSwarmManager.h"
+
+ASpiderDistanceFieldVolume::ASpiderDistanceFieldVolume()
+{
+	DistanceField = nullptr;
+}
+
+void ASpiderDistanceFieldVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (DistanceField && !DistanceField->IsEmpty())
+	{
+		if (ASpiderSwarmManager* SwarmManager = ASpiderSwarmManager::Get(GetWorld()))
+		{
+			SwarmManager->RegisterDistanceField(DistanceField);
+		}
+	}
+}
+
+void ASpiderDistanceFieldVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Sublevel streamed out.
+	if (DistanceField)
+	{
+		if (ASpiderSwarmManager* SwarmManager = ASpiderSwarmManager::Get(GetWorld(), false))
+		{
+			SwarmManager->UnregisterDistanceField(DistanceField);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ASpiderDistanceFieldVolume::BakeDistanceField()
+{
+#if WITH_EDITOR
+	if (!DistanceField)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s has no distance field asset to bake into."), *GetName());
+		return;
+	}
+
+	TArray<AActor*> IgnoredActors = ActorsToIgnore;
+	IgnoredActors.Add(this);
+
+	DistanceField->Modify();
+	DistanceField->Bake(GetWorld(), GetComponentsBoundingBox(true), BakeParams, IgnoredActors);
+	DistanceField->MarkPackageDirty();
+
+	UE_LOG(LogTemp, Log, TEXT("%s baked distance field into %s."), *GetName(), *DistanceField->GetPathName());
+#endif
+}
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Volume.h"
+#include "SpiderDistanceField.h"
+#include "SpiderDistanceFieldVolume.generated.h"
+
+/*
+* Bounds of static climbable collision baked into a distance field asset, spiders within it probe the field instead of tracing.
+* Place one in each sublevel with its own asset, the field is registered to spiders while the sublevel is loaded.
+*/
+UCLASS(ClassGroup = Spider)
+class SMARTSPIDER_API ASpiderDistanceFieldVolume : public AVolume
+{
+	GENERATED_BODY()
+
+protected:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Distance Field")
+	USpiderDistanceField* DistanceField;
+
+	UPROPERTY(EditAnywhere, category = "Distance Field")
+	FSpiderDistanceFieldBakeParams BakeParams;
+
+	/* Actors which should not be baked, e.g. static meshes spiders should not climb. */
+	UPROPERTY(EditAnywhere, category = "Distance Field")
+	TArray<AActor*> ActorsToIgnore;
+
+public:
+	ASpiderDistanceFieldVolume();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/* Sample static collision within the volume into @DistanceField, save the asset afterwards. */
+	UFUNCTION(CallInEditor, category = "Distance Field")
+	void BakeDistanceField();
+
+	FORCEINLINE USpiderDistanceField* GetDistanceField() const { return DistanceField; }
+};
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderEdgeTrajectory.h"
+
+namespace SpiderEdgeTrajectory
+{
+	/* Planes closer than it in angle are the same surface, radians. */
+	static const float MinAngle = FMath::DegreesToRadians(5.f);
+}
+
+FSpiderEdgeTrajectory::FSpiderEdgeTrajectory()
+	: Start(FVector::ZeroVector)
+	, Pivot(FVector::ZeroVector)
+	, EdgeDir(FVector::ForwardVector)
+	, ApproachDir(FVector::ForwardVector)
+	, FromNormal(FVector::UpVector)
+	, ToNormal(FVector::UpVector)
+	, ApproachLength(0)
+	, Radius(0)
+	, Angle(0)
+	, Side(1)
+{
+}
+
+bool FSpiderEdgeTrajectory::Build(FSpiderEdgeTrajectory& OutTrajectory, const FVector& Location, const FVector& Direction,
+	const FVector& FromPoint, const FVector& FromNormal, const FVector& ToPoint, const FVector& ToNormal,
+	float FeetOffset, bool bConvex, float ConcaveRadius, float MaxApproachLength)
+{
+	const float Angle = FMath::Acos(FMath::Clamp(FVector::DotProduct(FromNormal, ToNormal), -1.f, 1.f));
+	if (Angle < SpiderEdgeTrajectory::MinAngle) return false;
+
+	const FVector EdgeDir = FVector::CrossProduct(FromNormal, ToNormal).GetSafeNormal();
+	if (EdgeDir.IsZero()) return false;
+
+	// Up turning from the first normal to the second around edge direction sweeps the body across the edge.
+	const float Side = bConvex ? 1.f : -1.f;
+	const FVector ApproachDir = Side * FVector::CrossProduct(EdgeDir, FromNormal);
+
+	// Walking along the edge or away from it.
+	if (FVector::DotProduct(FVector::VectorPlaneProject(Direction, FromNormal).GetSafeNormal(), ApproachDir) < KINDA_SMALL_NUMBER) return false;
+
+	// Second plane faces away from spider over a convex edge, toward it in a concave corner.
+	if (Side * FVector::DotProduct(ToNormal, ApproachDir) <= 0.f) return false;
+
+	// Pivot line is where both planes offset by feet offset less the arc radius meet, the edge itself for convex.
+	const float Radius = bConvex ? FeetOffset : FMath::Max(ConcaveRadius, 1.f);
+	const float PlaneOffset = FeetOffset - Side * Radius;
+	const FPlane FromPlane(FromPoint + FromNormal * PlaneOffset, FromNormal);
+	const FPlane ToPlane(ToPoint + ToNormal * PlaneOffset, ToNormal);
+
+	FVector LinePoint, LineDir;
+	if (!FMath::IntersectPlanes2(LinePoint, LineDir, FromPlane, ToPlane)) return false;
+
+	FSpiderEdgeTrajectory& Trajectory = OutTrajectory;
+	Trajectory.EdgeDir = EdgeDir;
+	Trajectory.ApproachDir = ApproachDir;
+	Trajectory.FromNormal = FromNormal;
+	Trajectory.ToNormal = ToNormal;
+	Trajectory.Radius = Radius;
+	Trajectory.Angle = Angle;
+	Trajectory.Side = Side;
+	Trajectory.Pivot = LinePoint + EdgeDir * FVector::DotProduct(Location - LinePoint, EdgeDir);
+
+	// Spider found the edge late, e.g. bottom probe missed when body was already past it. Start on the arc.
+	const FVector ArcStart = Trajectory.Pivot + FromNormal * (Side * Radius);
+	Trajectory.ApproachLength = FMath::Max(FVector::DotProduct(ArcStart - Location, ApproachDir), 0.f);
+	if (Trajectory.ApproachLength > MaxApproachLength) return false;
+
+	Trajectory.Start = ArcStart - ApproachDir * Trajectory.ApproachLength;
+	return true;
+}
+
+void FSpiderEdgeTrajectory::Evaluate(float Distance, FVector& OutLocation, FVector& OutUp, FVector& OutTangent) const
+{
+	if (Distance <= ApproachLength)
+	{
+		OutLocation = Start + ApproachDir * FMath::Max(Distance, 0.f);
+		OutUp = FromNormal;
+		OutTangent = ApproachDir;
+		return;
+	}
+
+	const float Turned = FMath::Min((Distance - ApproachLength) / Radius, Angle);
+	OutUp = FQuat(EdgeDir, Turned).RotateVector(FromNormal);
+	OutLocation = Pivot + OutUp * (Side * Radius);
+	OutTangent = Side * FVector::CrossProduct(EdgeDir, OutUp);
+}
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+
+/*
+* Closed-form path of spider body around an edge between two surface planes.
+* Body walks straight on the first plane to the arc start, then turns around a pivot line parallel to the edge until up matches the second plane.
+* Convex arcs pivot on the edge itself with feet offset as radius, concave arcs pivot inside the corner.
+* Path is laid out in the plane across the edge, movement along the edge is added by the follower.
+*/
+struct SMARTSPIDER_API FSpiderEdgeTrajectory
+{
+	/* Body location where path starts, on the first plane. */
+	FVector Start;
+
+	/* Point of pivot line across from @Start. */
+	FVector Pivot;
+
+	/* Unit direction of edge, up turns around it from @FromNormal to @ToNormal. */
+	FVector EdgeDir;
+
+	/* Walking direction on the first plane toward the edge, across it. */
+	FVector ApproachDir;
+
+	FVector FromNormal;
+	FVector ToNormal;
+
+	float ApproachLength;
+	float Radius;
+	float Angle;
+
+	/* 1 for convex edge, body is outside of the arc. -1 for concave corner, body is inside. */
+	float Side;
+
+	FSpiderEdgeTrajectory();
+
+	/*
+	* Build path of body at location crossing from plane to plane, planes are given by a point and normal of each.
+	* Returns false if planes are nearly parallel, do not form the edge kind asked for, or the edge is further than max approach.
+	*/
+	static bool Build(FSpiderEdgeTrajectory& OutTrajectory, const FVector& Location, const FVector& Direction,
+		const FVector& FromPoint, const FVector& FromNormal, const FVector& ToPoint, const FVector& ToNormal,
+		float FeetOffset, bool bConvex, float ConcaveRadius, float MaxApproachLength);
+
+	FORCEINLINE float GetLength() const { return ApproachLength + Radius * Angle; }
+
+	/* Body location, up and unit walking direction at distance along path, clamped to the path. */
+	void Evaluate(float Distance, FVector& OutLocation, FVector& OutUp, FVector& OutTangent) const;
+};
@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderFlowField.h"
+#include "SmartSpiderSettings.h"
+
+namespace SpiderFlowField
+{
+	/* Nodes settled between deadline checks. */
+	static const int32 NodesPerTimeCheck = 64;
+
+	/* Edges walked from node hint before falling back to cell lookup. */
+	static const int32 MaxHintSteps = 4;
+}
+
+FSpiderFlowField::FSpiderFlowField(const USpiderSurfaceGraph* InGraphAsset, const AActor* InTarget)
+	: GraphAsset(InGraphAsset)
+	, Graph(InGraphAsset->GetData())
+	, Target(InTarget)
+	, GoalNode(INDEX_NONE)
+	, BuildGoalNode(INDEX_NONE)
+	, PendingGoalNode(INDEX_NONE)
+	, LastUsedFrame(GFrameCounter)
+{
+}
+
+void FSpiderFlowField::SetGoal(const FVector& GoalLocation)
+{
+	const int32 Node = FindNode(GoalLocation, PendingGoalNode);
+	if (Node != INDEX_NONE)
+	{
+		PendingGoalNode = Node;
+	}
+}
+
+void FSpiderFlowField::StartBuild()
+{
+	const int32 NumNodes = Graph->Num();
+	BuildGoalNode = PendingGoalNode;
+	BuildNextNodes.Init(INDEX_NONE, NumNodes);
+	BuildCosts.Init(MAX_FLT, NumNodes);
+	OpenNodes.Reset();
+
+	BuildCosts[BuildGoalNode] = 0.f;
+	OpenNodes.HeapPush(FOpenNode{ BuildGoalNode, 0.f });
+}
+
+bool FSpiderFlowField::Update(double Deadline)
+{
+	if (BuildGoalNode != PendingGoalNode && PendingGoalNode != GoalNode)
+	{
+		StartBuild();
+	}
+	if (BuildGoalNode == INDEX_NONE) return true;
+
+	// Dijkstra from goal, edges are baked in both directions so outgoing edges lead back toward goal.
+	const FSpiderSurfaceGraphData& GraphData = *Graph;
+	int32 NumSettled = 0;
+	while (OpenNodes.Num() > 0)
+	{
+		if (++NumSettled % SpiderFlowField::NodesPerTimeCheck == 0 && FPlatformTime::Seconds() > Deadline) return false;
+
+		FOpenNode Current;
+		OpenNodes.HeapPop(Current, false);
+		if (Current.Cost > BuildCosts[Current.Node]) continue;
+
+		for (int32 Edge = GraphData.GetEdgeBegin(Current.Node); Edge < GraphData.GetEdgeEnd(Current.Node); ++Edge)
+		{
+			const int32 Neighbor = GraphData.EdgeTargets[Edge];
+			const float NewCost = Current.Cost + GraphData.EdgeCosts[Edge];
+			if (NewCost < BuildCosts[Neighbor])
+			{
+				BuildCosts[Neighbor] = NewCost;
+				BuildNextNodes[Neighbor] = Current.Node;
+				OpenNodes.HeapPush(FOpenNode{ Neighbor, NewCost });
+			}
+		}
+	}
+
+	Exchange(NextNodes, BuildNextNodes);
+	GoalNode = BuildGoalNode;
+	BuildGoalNode = INDEX_NONE;
+	return PendingGoalNode == GoalNode;
+}
+
+int32 FSpiderFlowField::FindNode(const FVector& Location, int32 NodeHint) const
+{
+	const FSpiderSurfaceGraphData& GraphData = *Graph;
+	if (NodeHint != INDEX_NONE && NodeHint < GraphData.Num())
+	{
+		int32 Node = NodeHint;
+		float DistanceSq = FVector::DistSquared(Location, GraphData.NodePositions[Node]);
+		for (int32 Step = 0; Step < SpiderFlowField::MaxHintSteps; ++Step)
+		{
+			int32 CloserNode = Node;
+			for (int32 Edge = GraphData.GetEdgeBegin(Node); Edge < GraphData.GetEdgeEnd(Node); ++Edge)
+			{
+				const int32 Neighbor = GraphData.EdgeTargets[Edge];
+				const float NeighborDistanceSq = FVector::DistSquared(Location, GraphData.NodePositions[Neighbor]);
+				if (NeighborDistanceSq < DistanceSq)
+				{
+					DistanceSq = NeighborDistanceSq;
+					CloserNode = Neighbor;
+				}
+			}
+
+			if (CloserNode == Node) break;
+			Node = CloserNode;
+		}
+
+		if (DistanceSq <= FMath::Square(GraphData.CellSize)) return Node;
+	}
+
+	return GraphData.FindNearestNode(Location, GetDefault<USmartSpiderSettings>()->PathNodeSnapDistance);
+}
+
+bool FSpiderFlowField::SampleDirection(const FVector& Location, int32& NodeHint, FVector& OutDirection) const
+{
+	if (!IsReady()) return false;
+
+	NodeHint = FindNode(Location, NodeHint);
+	if (NodeHint == INDEX_NONE) return false;
+
+	const FSpiderSurfaceGraphData& GraphData = *Graph;
+	int32 NextNode = NextNodes[NodeHint];
+	if (NextNode == INDEX_NONE) return false;
+
+	// Aim one node further once close to the next one, so spiders do not stall on node centers.
+	if (NextNodes[NextNode] != INDEX_NONE && FVector::DistSquared(Location, GraphData.NodePositions[NextNode]) < FMath::Square(GraphData.CellSize * 0.5f))
+	{
+		NextNode = NextNodes[NextNode];
+	}
+
+	OutDirection = FVector::VectorPlaneProject(GraphData.NodePositions[NextNode] - Location, GraphData.NodeNormals[NodeHint]).GetSafeNormal();
+	return !OutDirection.IsZero();
+}
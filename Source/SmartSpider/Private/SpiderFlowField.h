@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SpiderSurfaceGraph.h"
+
+/*
+* Integration field over surface graph toward one target, for swarms converging on it.
+* Every node points to the next node on its shortest path to the target, so spiders sample steering in O(1).
+* Field is rebuilt across frames within a time budget when target reaches another node,
+* spiders keep following the last complete field meanwhile.
+*/
+class SMARTSPIDER_API FSpiderFlowField
+{
+public:
+	FSpiderFlowField(const USpiderSurfaceGraph* InGraphAsset, const AActor* InTarget);
+
+	/* Queue rebuild if goal falls on another node, ignored if off the graph. */
+	void SetGoal(const FVector& GoalLocation);
+
+	/* Advance rebuild until deadline in FPlatformTime::Seconds, true if nothing left to build. */
+	bool Update(double Deadline);
+
+	FORCEINLINE bool IsReady() const { return GoalNode != INDEX_NONE; }
+	FORCEINLINE bool IsBuilding() const { return BuildGoalNode != INDEX_NONE; }
+
+	/*
+	* Steering direction on surface from location toward target, false if off the graph or at goal node.
+	* Node hint is kept by caller across ticks and walked to the nearest node locally.
+	*/
+	bool SampleDirection(const FVector& Location, int32& NodeHint, FVector& OutDirection) const;
+
+	FORCEINLINE const AActor* GetTarget() const { return Target.Get(); }
+	FORCEINLINE const USpiderSurfaceGraph* GetGraphAsset() const { return GraphAsset.Get(); }
+
+	/* Graph asset was rebaked or collected, field should be dropped. */
+	FORCEINLINE bool IsStale() const { return !Target.IsValid() || !GraphAsset.IsValid() || &GraphAsset->GetData().Get() != &Graph.Get(); }
+
+	FORCEINLINE void MarkUsed() { LastUsedFrame = GFrameCounter; }
+	FORCEINLINE uint64 GetLastUsedFrame() const { return LastUsedFrame; }
+
+private:
+	struct FOpenNode
+	{
+		int32 Node;
+		float Cost;
+
+		FORCEINLINE bool operator<(const FOpenNode& Other) const { return Cost < Other.Cost; }
+	};
+
+	TWeakObjectPtr<const USpiderSurfaceGraph> GraphAsset;
+	FSpiderSurfaceGraphDataRef Graph;
+	TWeakObjectPtr<const AActor> Target;
+
+	/* Complete field sampled by spiders. */
+	int32 GoalNode;
+	TArray<int32> NextNodes;
+
+	/* Field being built, swapped in once complete. */
+	int32 BuildGoalNode;
+	TArray<int32> BuildNextNodes;
+	TArray<float> BuildCosts;
+	TArray<FOpenNode> OpenNodes;
+
+	/* Latest goal node, a rebuild in progress for an older goal restarts. */
+	int32 PendingGoalNode;
+
+	uint64 LastUsedFrame;
+
+	void StartBuild();
+
+	/* Nearest node to location, by walking edges from hint if it is still close. */
+	int32 FindNode(const FVector& Location, int32 NodeHint) const;
+};
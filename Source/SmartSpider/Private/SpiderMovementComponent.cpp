@@ -0,0 +1,354 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderMovementComponent.h"
+#include "SmartSpiderCharacter.h"
+#include "SpiderStats.h"
+
+USpiderMovementComponent::USpiderMovementComponent()
+{
+	SurfaceNormal = FVector::UpVector;
+	bAttachedToSurface = false;
+	SurfaceTurnRate = 540;
+	bOrientToVelocity = false;
+	SeparationVelocity = FVector::ZeroVector;
+	EdgeProgress = 0;
+	EdgeAlong = 0;
+	bFollowingEdgeTrajectory = false;
+
+	SurfaceSubstepTime = 1.f / 60.f;
+	MaxSurfaceSubsteps = 8;
+
+	NetLocationSmoothingSpeed = 10;
+	NetRotationSmoothingSpeed = 8;
+	NetMaxExtrapolationTime = 0.5f;
+	NetSnapDistance = 300;
+	bUseSurfaceReplication = false;
+	NetTargetLocation = FVector::ZeroVector;
+	NetTargetRotation = FQuat::Identity;
+	NetTargetVelocity = FVector::ZeroVector;
+	NetTargetAge = 0;
+	bHasNetTarget = false;
+
+	// Spider orients to the surface within movement update, yaw only rotation would fight with it.
+	bOrientRotationToMovement = false;
+	bUseControllerDesiredRotation = false;
+
+	ClearPendingSurfaceMove();
+}
+
+void USpiderMovementComponent::StartWallWalking()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderStartWallWalking);
+	SetMovementMode(MOVE_Custom, (uint8)ESpiderMovementMode::WallWalk);
+}
+
+void USpiderMovementComponent::SetSurface(const FVector& InSurfaceNormal, bool bAttached)
+{
+	SurfaceNormal = InSurfaceNormal;
+	bAttachedToSurface = bAttached;
+}
+
+void USpiderMovementComponent::SetOrientToVelocity(bool bOrient, float TurnRate)
+{
+	bOrientToVelocity = bOrient;
+	SurfaceTurnRate = TurnRate;
+}
+
+void USpiderMovementComponent::RequestSurfaceTransition(const FVector& Location, const FVector& InSurfaceNormal)
+{
+	PendingSurfaceLocation = Location;
+	PendingSurfaceNormal = InSurfaceNormal;
+	bHasPendingSurfaceTransition = true;
+}
+
+void USpiderMovementComponent::StartEdgeTrajectory(const FSpiderEdgeTrajectory& Trajectory)
+{
+	EdgeTrajectory = Trajectory;
+	EdgeProgress = 0;
+	EdgeAlong = 0;
+	bFollowingEdgeTrajectory = true;
+
+	// Trajectory holds the whole crossing, adjustments requested along with it would be applied twice.
+	ClearPendingSurfaceMove();
+}
+
+void USpiderMovementComponent::CancelEdgeTrajectory()
+{
+	bFollowingEdgeTrajectory = false;
+}
+
+void USpiderMovementComponent::ClearPendingSurfaceMove()
+{
+	PendingSurfaceLocation = FVector::ZeroVector;
+	PendingSurfaceNormal = FVector::UpVector;
+	bHasPendingSurfaceTransition = false;
+	PendingSurfaceOffset = FVector::ZeroVector;
+	PendingLocalRotation = FQuat::Identity;
+}
+
+FQuat USpiderMovementComponent::MakeSurfaceRotation(const FQuat& CurrentRotation, const FVector& InSurfaceNormal)
+{
+	FVector ForwardDir = FVector::CrossProduct(CurrentRotation.GetRightVector(), InSurfaceNormal);
+	if (ForwardDir.IsNearlyZero())
+	{
+		// Right vector stands on the surface, keep forward instead.
+		ForwardDir = FVector::VectorPlaneProject(CurrentRotation.GetForwardVector(), InSurfaceNormal);
+	}
+
+	return FRotationMatrix::MakeFromZX(InSurfaceNormal, ForwardDir).ToQuat();
+}
+
+void USpiderMovementComponent::PhysCustom(float deltaTime, int32 Iterations)
+{
+	if (CustomMovementMode == (uint8)ESpiderMovementMode::WallWalk)
+	{
+		PhysWallWalk(deltaTime, Iterations);
+		return;
+	}
+
+	Super::PhysCustom(deltaTime, Iterations);
+}
+
+void USpiderMovementComponent::PhysWallWalk(float deltaTime, int32 Iterations)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderPhysWallWalk);
+
+	if (deltaTime < MIN_TICK_TIME) return;
+
+	float StepTime;
+	const int32 NumSubsteps = GetSurfaceSubsteps(deltaTime, StepTime);
+	const float StepFraction = 1.f / NumSubsteps;
+
+	// Surface adjustments requested since last update are spread over substeps, so they follow the movement instead of landing at once.
+	const FQuat StepLocalRotation = FQuat::Slerp(FQuat::Identity, PendingLocalRotation, StepFraction);
+	const bool bEdgeRotation = !PendingLocalRotation.Equals(FQuat::Identity);
+	const FVector StepSurfaceOffset = PendingSurfaceOffset * StepFraction;
+	const FVector StepTransitionOffset = bHasPendingSurfaceTransition ? (PendingSurfaceLocation - UpdatedComponent->GetComponentLocation()) * StepFraction : FVector::ZeroVector;
+	FVector FloorNormal = bHasPendingSurfaceTransition ? PendingSurfaceNormal : SurfaceNormal;
+
+	for (int32 Substep = 0; Substep < NumSubsteps && UpdatedComponent; ++Substep)
+	{
+		if (bFollowingEdgeTrajectory && StepEdgeTrajectory(StepTime))
+		{
+			FloorNormal = SurfaceNormal;
+			continue;
+		}
+
+		if (bAttachedToSurface)
+		{
+			Acceleration = FVector::VectorPlaneProject(Acceleration, FloorNormal);
+			if (!HasAnimRootMotion())
+			{
+				CalcVelocity(StepTime, GroundFriction, false, GetMaxBrakingDeceleration());
+			}
+			Velocity = FVector::VectorPlaneProject(Velocity, FloorNormal);
+		}
+		else
+		{
+			Velocity.Z += GetGravityZ() * StepTime;
+		}
+
+		const FVector Separation = bAttachedToSurface ? FVector::VectorPlaneProject(SeparationVelocity, FloorNormal) : FVector::ZeroVector;
+
+		// Velocity, separation, sticking, edge offset and surface alignment of a substep all go into one sweep.
+		const FQuat OldRotation = UpdatedComponent->GetComponentQuat();
+		FVector Delta = (Velocity + Separation) * StepTime + StepSurfaceOffset + StepTransitionOffset;
+		FQuat NewRotation = OldRotation * StepLocalRotation;
+		if (bHasPendingSurfaceTransition)
+		{
+			// Aligned at the last substep.
+			NewRotation = FQuat::Slerp(NewRotation, MakeSurfaceRotation(NewRotation, PendingSurfaceNormal), 1.f / (NumSubsteps - Substep));
+		}
+
+		// Velocity and floor turn with the spider over an edge, so it wraps around instead of running off.
+		if (bEdgeRotation && bAttachedToSurface)
+		{
+			const FQuat EdgeRotation = OldRotation * StepLocalRotation * OldRotation.Inverse();
+			Velocity = EdgeRotation.RotateVector(Velocity);
+			FloorNormal = EdgeRotation.RotateVector(FloorNormal);
+		}
+
+		if (bOrientToVelocity && bAttachedToSurface)
+		{
+			NewRotation = TurnToVelocity(NewRotation, StepTime);
+		}
+
+		FHitResult Hit(1.f);
+		SafeMoveUpdatedComponent(Delta, NewRotation, true, Hit);
+		if (Hit.Time < 1.f)
+		{
+			HandleImpact(Hit, StepTime, Delta);
+			SlideAlongSurface(Delta, 1.f - Hit.Time, Hit.Normal, Hit, true);
+		}
+	}
+
+	ClearPendingSurfaceMove();
+}
+
+bool USpiderMovementComponent::StepEdgeTrajectory(float StepTime)
+{
+	FVector Location, Up, Tangent;
+	EdgeTrajectory.Evaluate(EdgeProgress, Location, Up, Tangent);
+
+	Acceleration = FVector::VectorPlaneProject(Acceleration, Up);
+	if (!HasAnimRootMotion())
+	{
+		CalcVelocity(StepTime, GroundFriction, false, GetMaxBrakingDeceleration());
+	}
+	Velocity = FVector::VectorPlaneProject(Velocity, Up);
+
+	// Turned back before the arc, spider walks on the plane it came from.
+	const float NewProgress = EdgeProgress + FVector::DotProduct(Velocity, Tangent) * StepTime;
+	if (NewProgress < 0.f)
+	{
+		bFollowingEdgeTrajectory = false;
+		SurfaceNormal = EdgeTrajectory.FromNormal;
+		return false;
+	}
+
+	EdgeProgress = FMath::Min(NewProgress, EdgeTrajectory.GetLength());
+	EdgeAlong += FVector::DotProduct(Velocity, EdgeTrajectory.EdgeDir) * StepTime;
+
+	FVector NewLocation, NewUp, NewTangent;
+	EdgeTrajectory.Evaluate(EdgeProgress, NewLocation, NewUp, NewTangent);
+	NewLocation += EdgeTrajectory.EdgeDir * EdgeAlong;
+
+	// Velocity turns with the body, so it leaves the arc along the new plane.
+	Velocity = FQuat::FindBetweenNormals(Up, NewUp).RotateVector(Velocity);
+	SurfaceNormal = NewUp;
+	bAttachedToSurface = true;
+
+	FQuat NewRotation = MakeSurfaceRotation(UpdatedComponent->GetComponentQuat(), NewUp);
+	if (bOrientToVelocity)
+	{
+		NewRotation = TurnToVelocity(NewRotation, StepTime);
+	}
+
+	const FVector Delta = NewLocation - UpdatedComponent->GetComponentLocation();
+	FHitResult Hit(1.f);
+	SafeMoveUpdatedComponent(Delta, NewRotation, true, Hit);
+	if (Hit.Time < 1.f)
+	{
+		// Something stands on the path, environment tracing takes over from where spider stopped.
+		HandleImpact(Hit, StepTime, Delta);
+		SlideAlongSurface(Delta, 1.f - Hit.Time, Hit.Normal, Hit, true);
+		bFollowingEdgeTrajectory = false;
+		return true;
+	}
+
+	if (EdgeProgress >= EdgeTrajectory.GetLength())
+	{
+		SurfaceNormal = EdgeTrajectory.ToNormal;
+		bFollowingEdgeTrajectory = false;
+	}
+
+	return true;
+}
+
+int32 USpiderMovementComponent::GetSurfaceSubsteps(float DeltaTime, float& OutStepTime) const
+{
+	if (SurfaceSubstepTime <= 0.f || DeltaTime <= SurfaceSubstepTime)
+	{
+		OutStepTime = DeltaTime;
+		return 1;
+	}
+
+	// Steps longer than the fixed step only when capped by max substeps, e.g. at hitches.
+	const int32 NumSubsteps = FMath::Min(FMath::CeilToInt(DeltaTime / SurfaceSubstepTime), FMath::Max(MaxSurfaceSubsteps, 1));
+	OutStepTime = DeltaTime / NumSubsteps;
+	return NumSubsteps;
+}
+
+void USpiderMovementComponent::SetNetTarget(const FVector& Location, const FQuat& Rotation, const FVector& InVelocity, const FVector& InSurfaceNormal, bool bAttached)
+{
+	SetSurface(InSurfaceNormal, bAttached);
+
+	NetTargetLocation = Location;
+	NetTargetRotation = Rotation;
+	NetTargetVelocity = InVelocity;
+	NetTargetAge = 0;
+
+	if (!UpdatedComponent) return;
+
+	if (!bHasNetTarget || FVector::DistSquared(UpdatedComponent->GetComponentLocation(), Location) > FMath::Square(NetSnapDistance))
+	{
+		UpdatedComponent->SetWorldLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+
+	bHasNetTarget = true;
+}
+
+void USpiderMovementComponent::SimulatedTick(float DeltaSeconds)
+{
+	if (!bUseSurfaceReplication)
+	{
+		Super::SimulatedTick(DeltaSeconds);
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_SpiderNetSmoothing);
+
+	if (!bHasNetTarget || !UpdatedComponent || DeltaSeconds < MIN_TICK_TIME) return;
+
+	// Predict along the surface from the last state, then pull the error out over time instead of snapping.
+	const float PredictTime = FMath::Min(NetTargetAge + DeltaSeconds, NetMaxExtrapolationTime);
+	const FVector PredictedLocation = NetTargetLocation + NetTargetVelocity * PredictTime;
+	const bool bExtrapolating = NetTargetAge < NetMaxExtrapolationTime;
+	NetTargetAge += DeltaSeconds;
+
+	FVector NewLocation = UpdatedComponent->GetComponentLocation() + (bExtrapolating ? NetTargetVelocity * DeltaSeconds : FVector::ZeroVector);
+	NewLocation += (PredictedLocation - NewLocation) * FMath::Min(DeltaSeconds * NetLocationSmoothingSpeed, 1.f);
+
+	const FQuat NewRotation = FMath::QInterpTo(UpdatedComponent->GetComponentQuat(), NetTargetRotation, DeltaSeconds, NetRotationSmoothingSpeed);
+
+	Velocity = bExtrapolating ? NetTargetVelocity : FVector::ZeroVector;
+	UpdatedComponent->SetWorldLocationAndRotation(NewLocation, NewRotation, false, nullptr, ETeleportType::None);
+}
+
+FQuat USpiderMovementComponent::TurnToVelocity(const FQuat& Rotation, float deltaTime) const
+{
+	const FVector UpDir = Rotation.GetUpVector();
+	const FVector DesireForward = FVector::VectorPlaneProject(Velocity, UpDir).GetSafeNormal();
+	if (DesireForward.IsZero()) return Rotation;
+
+	const FVector Forward = Rotation.GetForwardVector();
+	const float Angle = FMath::Acos(FMath::Clamp(FVector::DotProduct(Forward, DesireForward), -1.f, 1.f));
+	const float MaxAngle = FMath::DegreesToRadians(SurfaceTurnRate * deltaTime);
+	const float Sign = FVector::DotProduct(UpDir, FVector::CrossProduct(Forward, DesireForward)) < 0.f ? -1.f : 1.f;
+
+	return FQuat(UpDir, Sign * FMath::Min(Angle, MaxAngle)) * Rotation;
+}
+
+float USpiderMovementComponent::GetMaxSpeed() const
+{
+	return IsWallWalking() ? MaxWalkSpeed : Super::GetMaxSpeed();
+}
+
+float USpiderMovementComponent::GetMaxBrakingDeceleration() const
+{
+	return IsWallWalking() ? BrakingDecelerationWalking : Super::GetMaxBrakingDeceleration();
+}
+
+void USpiderMovementComponent::RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed)
+{
+	// Path following keeps requesting while movement tick is disabled, dormant spider wakes on the first request.
+	ASmartSpiderCharacter* Spider = Cast<ASmartSpiderCharacter>(CharacterOwner);
+	if (Spider && !MoveVelocity.IsZero())
+	{
+		Spider->WakeUp();
+	}
+
+	if (!IsWallWalking())
+	{
+		Super::RequestDirectMove(MoveVelocity, bForceMaxSpeed);
+		return;
+	}
+
+	if (MoveVelocity.SizeSquared() < KINDA_SMALL_NUMBER) return;
+
+	// Path following requests velocity in world space, keep it on the surface instead of dropping Z.
+	RequestedVelocity = FVector::VectorPlaneProject(MoveVelocity, SurfaceNormal);
+	bHasRequestedVelocity = true;
+	bRequestedMoveWithMaxSpeed = bForceMaxSpeed;
+}
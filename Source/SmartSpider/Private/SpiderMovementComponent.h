@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/CharacterMovementComponent.h"
+#include "SpiderEdgeTrajectory.h"
+#include "SpiderMovementComponent.generated.h"
+
+/* Custom movement modes of spider, used with MOVE_Custom. */
+UENUM(BlueprintType)
+enum class ESpiderMovementMode : uint8
+{
+	/* Walk on surface of any orientation, the surface normal is the floor. */
+	WallWalk = 0
+};
+
+/*
+* Character movement of spider walking on surface of any orientation.
+* Environment tracing only requests surface adjustments, they are applied along with velocity by one swept move per update.
+*/
+UCLASS(ClassGroup = Spider)
+class SMARTSPIDER_API USpiderMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+protected:
+	/* Floor of wall walking. Velocity and input acceleration are kept on this plane while attached. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Spider Movement")
+	FVector SurfaceNormal;
+
+	/* Whether spider holds on the surface, detached spider falls by gravity until environment tracing finds a surface. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Spider Movement")
+	uint32 bAttachedToSurface : 1;
+
+	/* Turn toward velocity on surface, degrees per second. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Spider Movement", meta = (ClampMin = "0.0"))
+	float SurfaceTurnRate;
+
+	uint32 bOrientToVelocity : 1;
+
+	/* Wall walking and surface adjustments are integrated in steps no longer than it, so spiders ticking at low rate stay on edges. 0 for one step per update. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Spider Movement|Substepping", meta = (ClampMin = "0.0"))
+	float SurfaceSubstepTime;
+
+	/* Substeps per update at most, steps get longer than @SurfaceSubstepTime beyond it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Spider Movement|Substepping", meta = (ClampMin = "1"))
+	int32 MaxSurfaceSubsteps;
+
+	/* Simulated proxy catches up with replicated location at this rate, per second. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Spider Movement|Replication", meta = (ClampMin = "0.0"))
+	float NetLocationSmoothingSpeed;
+
+	/* Surface transitions of simulated proxy are turned at this rate instead of snapped. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Spider Movement|Replication", meta = (ClampMin = "0.0"))
+	float NetRotationSmoothingSpeed;
+
+	/* Simulated proxy keeps moving along the surface for at most this long without new state. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Spider Movement|Replication", meta = (ClampMin = "0.0"))
+	float NetMaxExtrapolationTime;
+
+	/* Simulated proxy further than it from replicated location is snapped, e.g. teleported or promoted from pool. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, category = "Spider Movement|Replication", meta = (ClampMin = "0.0"))
+	float NetSnapDistance;
+
+	/* Simulated proxy is driven by replicated surface state of spider instead of replicated movement. */
+	uint32 bUseSurfaceReplication : 1;
+
+	/* Last replicated state of simulated proxy. */
+	FVector NetTargetLocation;
+	FQuat NetTargetRotation;
+	FVector NetTargetVelocity;
+	float NetTargetAge;
+	uint32 bHasNetTarget : 1;
+
+	/* Push away from neighbor spiders, kept until replaced by swarm manager. Moves the spider without adding to velocity. */
+	FVector SeparationVelocity;
+
+	/* Surface adjustments requested since last update, applied by the next move. */
+	FVector PendingSurfaceLocation;
+	FVector PendingSurfaceNormal;
+	uint32 bHasPendingSurfaceTransition : 1;
+	FVector PendingSurfaceOffset;
+	FQuat PendingLocalRotation;
+
+	/* Edge crossing followed instead of wall walking, distances walked across and along the edge. */
+	FSpiderEdgeTrajectory EdgeTrajectory;
+	float EdgeProgress;
+	float EdgeAlong;
+	uint32 bFollowingEdgeTrajectory : 1;
+
+	void PhysWallWalk(float deltaTime, int32 Iterations);
+
+	/* One substep along @EdgeTrajectory, returns false if spider left the trajectory and wall walks this substep instead. */
+	bool StepEdgeTrajectory(float StepTime);
+	FQuat TurnToVelocity(const FQuat& Rotation, float deltaTime) const;
+	void ClearPendingSurfaceMove();
+
+	virtual void SimulatedTick(float DeltaSeconds) override;
+
+public:
+	USpiderMovementComponent();
+
+	virtual void PhysCustom(float deltaTime, int32 Iterations) override;
+	virtual float GetMaxSpeed() const override;
+	virtual float GetMaxBrakingDeceleration() const override;
+	virtual void RequestDirectMove(const FVector& MoveVelocity, bool bForceMaxSpeed) override;
+
+	UFUNCTION(BlueprintCallable, category = "Spider Movement")
+	void StartWallWalking();
+
+	FORCEINLINE bool IsWallWalking() const { return MovementMode == MOVE_Custom && CustomMovementMode == (uint8)ESpiderMovementMode::WallWalk; }
+
+	FORCEINLINE const FVector& GetSurfaceNormal() const { return SurfaceNormal; }
+	FORCEINLINE bool IsAttachedToSurface() const { return !!bAttachedToSurface; }
+
+	/* Number of substeps and their length for a time step, see @SurfaceSubstepTime. */
+	int32 GetSurfaceSubsteps(float DeltaTime, float& OutStepTime) const;
+
+	void SetSurface(const FVector& InSurfaceNormal, bool bAttached);
+	void SetOrientToVelocity(bool bOrient, float TurnRate);
+
+	/* Move to location and align up with surface normal at next update. */
+	void RequestSurfaceTransition(const FVector& Location, const FVector& InSurfaceNormal);
+	FORCEINLINE bool HasPendingSurfaceTransition() const { return !!bHasPendingSurfaceTransition; }
+
+	/* Cross the edge along trajectory from next update, surface adjustments are not needed until spider lands on the other plane. */
+	void StartEdgeTrajectory(const FSpiderEdgeTrajectory& Trajectory);
+	void CancelEdgeTrajectory();
+	FORCEINLINE bool IsFollowingEdgeTrajectory() const { return !!bFollowingEdgeTrajectory; }
+
+	FORCEINLINE void SetSeparationVelocity(const FVector& InSeparationVelocity) { SeparationVelocity = InSeparationVelocity; }
+	FORCEINLINE const FVector& GetSeparationVelocity() const { return SeparationVelocity; }
+
+	FORCEINLINE void AddSurfaceOffset(const FVector& Offset) { PendingSurfaceOffset += Offset; }
+	FORCEINLINE void AddLocalSurfaceRotation(const FQuat& Rotation) { PendingLocalRotation = PendingLocalRotation * Rotation; }
+
+	FORCEINLINE void SetUseSurfaceReplication(bool bUse) { bUseSurfaceReplication = bUse; }
+
+	/* Simulated proxy predicts along the surface from the state and smooths toward it. */
+	void SetNetTarget(const FVector& Location, const FQuat& Rotation, const FVector& InVelocity, const FVector& InSurfaceNormal, bool bAttached);
+
+	/* Rotation with up aligned to surface normal, keeping right vector of current rotation on the surface. */
+	static FQuat MakeSurfaceRotation(const FQuat& CurrentRotation, const FVector& InSurfaceNormal);
+};
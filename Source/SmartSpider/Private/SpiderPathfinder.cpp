@@ -0,0 +1,294 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderPathfinder.h"
+#include "SmartSpiderSettings.h"
+#include "SpiderStats.h"
+#include "Async/Async.h"
+
+namespace SpiderPathfinder
+{
+	/* Normals closer than it are on the same surface. */
+	static const float SameSurfaceDot = 0.985f;
+
+	/* Direction change less than it is collinear. */
+	static const float CollinearDot = 0.996f;
+
+	/* Longest detour over another surface dropped by smoothing, in points. */
+	static const int32 MaxDetourPoints = 3;
+
+	static FORCEINLINE int32 GetFacing(const FVector& Normal)
+	{
+		const FVector AbsNormal = Normal.GetAbs();
+		const int32 Axis = AbsNormal.X >= AbsNormal.Y ? (AbsNormal.X >= AbsNormal.Z ? 0 : 2) : (AbsNormal.Y >= AbsNormal.Z ? 1 : 2);
+		return Axis * 2 + (Normal[Axis] < 0.f ? 1 : 0);
+	}
+}
+
+int32 FSpiderSurfacePath::FindNearestPoint(const FVector& Location) const
+{
+	int32 NearestPoint = 0;
+	float NearestDistanceSq = MAX_FLT;
+	for (int32 Index = 0; Index < Points.Num(); ++Index)
+	{
+		const float DistanceSq = FVector::DistSquared(Location, Points[Index]);
+		if (DistanceSq < NearestDistanceSq)
+		{
+			NearestDistanceSq = DistanceSq;
+			NearestPoint = Index;
+		}
+	}
+
+	return NearestPoint;
+}
+
+FSpiderPathfinder::FSpiderPathfinder()
+{
+}
+
+void FSpiderPathfinder::Reset()
+{
+	// Callbacks of searches in flight are dropped, their results are ignored when they come back.
+	CachedPaths.Reset();
+	SearchesInFlight.Reset();
+}
+
+void FSpiderPathfinder::FindPath(const USpiderSurfaceGraph* Graph, const FVector& Start, const FVector& Goal, const FOnSpiderPathFound& OnPathFound)
+{
+	check(IsInGameThread());
+
+	if (!Graph || Graph->IsEmpty())
+	{
+		OnPathFound.ExecuteIfBound(FSpiderSurfacePathPtr());
+		return;
+	}
+
+	const USmartSpiderSettings* Settings = GetDefault<USmartSpiderSettings>();
+	const FSpiderSurfaceGraphDataRef& GraphData = Graph->GetData();
+	const int32 StartNode = GraphData->FindNearestNode(Start, Settings->PathNodeSnapDistance);
+	const int32 GoalNode = GraphData->FindNearestNode(Goal, Settings->PathNodeSnapDistance);
+	if (StartNode == INDEX_NONE || GoalNode == INDEX_NONE)
+	{
+		OnPathFound.ExecuteIfBound(FSpiderSurfacePathPtr());
+		return;
+	}
+
+	const FVector& StartPosition = GraphData->NodePositions[StartNode];
+	const float Quantization = FMath::Max(Settings->PathStartQuantization, GraphData->CellSize);
+
+	FPathKey Key;
+	Key.Graph = &GraphData.Get();
+	Key.StartKey = FSpiderSurfaceGraphData::MakeCellKey(FIntVector(FMath::FloorToInt(StartPosition.X / Quantization), FMath::FloorToInt(StartPosition.Y / Quantization), FMath::FloorToInt(StartPosition.Z / Quantization)));
+	Key.StartFacing = SpiderPathfinder::GetFacing(GraphData->NodeNormals[StartNode]);
+	Key.GoalNode = GoalNode;
+
+	if (FCachedPath* CachedPath = CachedPaths.Find(Key))
+	{
+		CachedPath->LastUsedFrame = GFrameCounter;
+		OnPathFound.ExecuteIfBound(CachedPath->Path);
+		return;
+	}
+
+	if (FSearchInFlight* SearchInFlight = SearchesInFlight.Find(Key))
+	{
+		SearchInFlight->Callbacks.Add(OnPathFound);
+		return;
+	}
+
+	TSharedPtr<const FSpiderSurfaceGraphData, ESPMode::ThreadSafe> SearchGraph = GraphData;
+	FSearchInFlight& SearchInFlight = SearchesInFlight.Add(Key);
+	SearchInFlight.Graph = SearchGraph;
+	SearchInFlight.Callbacks.Add(OnPathFound);
+
+	// Worker only touches graph data it holds a reference of, the pathfinder may be gone when the search comes back.
+	TWeakPtr<FSpiderPathfinder, ESPMode::ThreadSafe> WeakPathfinder = AsShared();
+	const int32 MaxExpandedNodes = Settings->MaxPathSearchNodes;
+	Async<void>(EAsyncExecution::ThreadPool, [SearchGraph, WeakPathfinder, Key, StartNode, GoalNode, MaxExpandedNodes]()
+	{
+		FSpiderSurfacePathPtr Path = SearchPath(*SearchGraph, StartNode, GoalNode, MaxExpandedNodes);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakPathfinder, Key, Path]()
+		{
+			TSharedPtr<FSpiderPathfinder, ESPMode::ThreadSafe> Pathfinder = WeakPathfinder.Pin();
+			if (Pathfinder.IsValid())
+			{
+				Pathfinder->CompleteSearch(Key, Path);
+			}
+		});
+	});
+}
+
+void FSpiderPathfinder::CompleteSearch(const FPathKey& Key, FSpiderSurfacePathPtr Path)
+{
+	FSearchInFlight SearchInFlight;
+	if (!SearchesInFlight.RemoveAndCopyValue(Key, SearchInFlight)) return;
+
+	if (Path.IsValid())
+	{
+		FCachedPath& CachedPath = CachedPaths.Add(Key);
+		CachedPath.Path = Path;
+		CachedPath.Graph = SearchInFlight.Graph;
+		CachedPath.LastUsedFrame = GFrameCounter;
+
+		EvictLeastRecentlyUsed(GetDefault<USmartSpiderSettings>()->PathCacheSize);
+	}
+
+	for (const FOnSpiderPathFound& Callback : SearchInFlight.Callbacks)
+	{
+		Callback.ExecuteIfBound(Path);
+	}
+}
+
+void FSpiderPathfinder::EvictLeastRecentlyUsed(int32 MaxCachedPaths)
+{
+	while (CachedPaths.Num() > FMath::Max(MaxCachedPaths, 0))
+	{
+		const FPathKey* LeastRecentlyUsed = nullptr;
+		uint64 LeastUsedFrame = MAX_uint64;
+		for (const TPair<FPathKey, FCachedPath>& Pair : CachedPaths)
+		{
+			if (Pair.Value.LastUsedFrame < LeastUsedFrame)
+			{
+				LeastUsedFrame = Pair.Value.LastUsedFrame;
+				LeastRecentlyUsed = &Pair.Key;
+			}
+		}
+
+		const FPathKey Key = *LeastRecentlyUsed;
+		CachedPaths.Remove(Key);
+	}
+}
+
+FSpiderSurfacePathPtr FSpiderPathfinder::SearchPath(const FSpiderSurfaceGraphData& Graph, int32 StartNode, int32 GoalNode, int32 MaxExpandedNodes)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderPathSearch);
+
+	struct FSearchNode
+	{
+		float Cost;
+		int32 Parent;
+		int32 ParentEdge;
+		bool bClosed;
+	};
+
+	struct FOpenNode
+	{
+		int32 Node;
+		float Score;
+	};
+
+	auto OpenNodeLess = [](const FOpenNode& A, const FOpenNode& B) { return A.Score < B.Score; };
+
+	// Edge costs are never shorter than the distance, so straight distance is admissible.
+	const FVector& GoalPosition = Graph.NodePositions[GoalNode];
+	TMap<int32, FSearchNode> SearchNodes;
+	TArray<FOpenNode> OpenNodes;
+
+	SearchNodes.Add(StartNode, FSearchNode{ 0.f, INDEX_NONE, INDEX_NONE, false });
+	OpenNodes.HeapPush(FOpenNode{ StartNode, FVector::Dist(Graph.NodePositions[StartNode], GoalPosition) }, OpenNodeLess);
+
+	bool bFound = false;
+	int32 NumExpanded = 0;
+	while (OpenNodes.Num() > 0)
+	{
+		FOpenNode Current;
+		OpenNodes.HeapPop(Current, OpenNodeLess, false);
+
+		FSearchNode& Record = SearchNodes.FindChecked(Current.Node);
+		if (Record.bClosed) continue;
+		Record.bClosed = true;
+
+		if (Current.Node == GoalNode)
+		{
+			bFound = true;
+			break;
+		}
+
+		if (++NumExpanded > MaxExpandedNodes) break;
+
+		// Adding search nodes may reallocate the map, do not hold the record.
+		const float Cost = Record.Cost;
+		for (int32 Edge = Graph.GetEdgeBegin(Current.Node); Edge < Graph.GetEdgeEnd(Current.Node); ++Edge)
+		{
+			const int32 Target = Graph.EdgeTargets[Edge];
+			const float NewCost = Cost + Graph.EdgeCosts[Edge];
+
+			const FSearchNode* TargetRecord = SearchNodes.Find(Target);
+			if (TargetRecord && (TargetRecord->bClosed || TargetRecord->Cost <= NewCost)) continue;
+
+			SearchNodes.Add(Target, FSearchNode{ NewCost, Current.Node, Edge, false });
+			OpenNodes.HeapPush(FOpenNode{ Target, NewCost + FVector::Dist(Graph.NodePositions[Target], GoalPosition) }, OpenNodeLess);
+		}
+	}
+
+	if (!bFound) return FSpiderSurfacePathPtr();
+
+	TArray<int32> PathNodes;
+	for (int32 Node = GoalNode; Node != INDEX_NONE; Node = SearchNodes.FindChecked(Node).Parent)
+	{
+		PathNodes.Add(Node);
+	}
+
+	TSharedPtr<FSpiderSurfacePath, ESPMode::ThreadSafe> Path = MakeShareable(new FSpiderSurfacePath());
+	Path->Points.Reserve(PathNodes.Num());
+	Path->Normals.Reserve(PathNodes.Num());
+	Path->Surfaces.Reserve(PathNodes.Num());
+	for (int32 Index = PathNodes.Num() - 1; Index >= 0; --Index)
+	{
+		const int32 Node = PathNodes[Index];
+		const int32 ParentEdge = SearchNodes.FindChecked(Node).ParentEdge;
+		Path->Points.Add(Graph.NodePositions[Node]);
+		Path->Normals.Add(Graph.NodeNormals[Node]);
+		Path->Surfaces.Add(ParentEdge != INDEX_NONE ? Graph.GetEdgeSurface(ParentEdge) : EEnvironmentSurface::Plane);
+	}
+
+	SmoothPath(*Path);
+	return Path;
+}
+
+void FSpiderPathfinder::SmoothPath(FSpiderSurfacePath& Path)
+{
+	auto IsSameSurface = [&Path](int32 A, int32 B)
+	{
+		return FVector::DotProduct(Path.Normals[A], Path.Normals[B]) > SpiderPathfinder::SameSurfaceDot;
+	};
+
+	auto RemovePoints = [&Path](int32 Index, int32 Count)
+	{
+		Path.Points.RemoveAt(Index, Count, false);
+		Path.Normals.RemoveAt(Index, Count, false);
+		Path.Surfaces.RemoveAt(Index, Count, false);
+	};
+
+	// Searches along an edge zigzag between both surfaces, each zigzag costs spider two transitions.
+	for (int32 Index = 1; Index < Path.Num() - 1; ++Index)
+	{
+		if (IsSameSurface(Index - 1, Index)) continue;
+
+		const int32 LastDetourEnd = FMath::Min(Index + SpiderPathfinder::MaxDetourPoints, Path.Num() - 1);
+		for (int32 Return = Index + 1; Return <= LastDetourEnd; ++Return)
+		{
+			if (IsSameSurface(Index - 1, Return))
+			{
+				RemovePoints(Index, Return - Index);
+				Path.Surfaces[Index] = EEnvironmentSurface::Plane;
+				--Index;
+				break;
+			}
+		}
+	}
+
+	// Points in the middle of a straight run on the same surface are redundant.
+	for (int32 Index = Path.Num() - 2; Index > 0; --Index)
+	{
+		if (Path.Surfaces[Index] != EEnvironmentSurface::Plane || Path.Surfaces[Index + 1] != EEnvironmentSurface::Plane) continue;
+		if (!IsSameSurface(Index - 1, Index) || !IsSameSurface(Index, Index + 1)) continue;
+
+		const FVector InDir = (Path.Points[Index] - Path.Points[Index - 1]).GetSafeNormal();
+		const FVector OutDir = (Path.Points[Index + 1] - Path.Points[Index]).GetSafeNormal();
+		if (FVector::DotProduct(InDir, OutDir) > SpiderPathfinder::CollinearDot)
+		{
+			RemovePoints(Index, 1);
+		}
+	}
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SpiderSurfaceGraph.h"
+
+/* Smoothed path over surface graph. */
+struct FSpiderSurfacePath
+{
+	TArray<FVector> Points;
+	TArray<FVector> Normals;
+
+	/* Surface crossed from the previous point to this one, plane for the first point. */
+	TArray<EEnvironmentSurface> Surfaces;
+
+	FORCEINLINE int32 Num() const { return Points.Num(); }
+
+	/* Index of point nearest to location, for spiders reusing a path searched from a nearby start. */
+	int32 FindNearestPoint(const FVector& Location) const;
+};
+
+typedef TSharedPtr<const FSpiderSurfacePath, ESPMode::ThreadSafe> FSpiderSurfacePathPtr;
+
+DECLARE_DELEGATE_OneParam(FOnSpiderPathFound, FSpiderSurfacePathPtr);
+
+/*
+* Surface path queries of a world. A* runs on worker threads, results are delivered on game thread.
+* Queries are keyed by quantized start and goal node, so spiders close to each other heading to the same goal
+* share one search through an LRU cache, and wait on the search in flight if any.
+*/
+class FSpiderPathfinder : public TSharedFromThis<FSpiderPathfinder, ESPMode::ThreadSafe>
+{
+public:
+	FSpiderPathfinder();
+
+	/* Callback is executed on game thread, immediately if the path is cached. Null path if not found. */
+	void FindPath(const USpiderSurfaceGraph* Graph, const FVector& Start, const FVector& Goal, const FOnSpiderPathFound& OnPathFound);
+
+	void Reset();
+
+	FORCEINLINE int32 NumCachedPaths() const { return CachedPaths.Num(); }
+	FORCEINLINE int32 NumSearchesInFlight() const { return SearchesInFlight.Num(); }
+
+	/* A* over graph data, safe to run on any thread. */
+	static FSpiderSurfacePathPtr SearchPath(const FSpiderSurfaceGraphData& Graph, int32 StartNode, int32 GoalNode, int32 MaxExpandedNodes);
+
+	/* Drop detours over another surface which return to the same one, then drop collinear points of each surface. */
+	static void SmoothPath(FSpiderSurfacePath& Path);
+
+private:
+	struct FPathKey
+	{
+		const FSpiderSurfaceGraphData* Graph;
+		uint64 StartKey;
+
+		/* Dominant axis of start normal, so spiders on both sides of a thin wall do not share path. */
+		int32 StartFacing;
+		int32 GoalNode;
+
+		FORCEINLINE bool operator==(const FPathKey& Other) const
+		{
+			return Graph == Other.Graph && StartKey == Other.StartKey && StartFacing == Other.StartFacing && GoalNode == Other.GoalNode;
+		}
+
+		friend FORCEINLINE uint32 GetTypeHash(const FPathKey& Key)
+		{
+			return HashCombine(HashCombine(PointerHash(Key.Graph), GetTypeHash(Key.StartKey)), GetTypeHash(Key.StartFacing * 31 + Key.GoalNode));
+		}
+	};
+
+	struct FCachedPath
+	{
+		FSpiderSurfacePathPtr Path;
+
+		/* Keeps graph data alive, so its address in key is not reused by another graph. */
+		TSharedPtr<const FSpiderSurfaceGraphData, ESPMode::ThreadSafe> Graph;
+		uint64 LastUsedFrame;
+	};
+
+	struct FSearchInFlight
+	{
+		TSharedPtr<const FSpiderSurfaceGraphData, ESPMode::ThreadSafe> Graph;
+		TArray<FOnSpiderPathFound> Callbacks;
+	};
+
+	TMap<FPathKey, FCachedPath> CachedPaths;
+	TMap<FPathKey, FSearchInFlight> SearchesInFlight;
+
+	void CompleteSearch(const FPathKey& Key, FSpiderSurfacePathPtr Path);
+	void EvictLeastRecentlyUsed(int32 MaxCachedPaths);
+};
@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderPerception.h"
+#include "SmartSpiderCharacter.h"
+#include "SmartSpiderSettings.h"
+#include "SpiderStats.h"
+
+namespace SpiderPerception
+{
+	static const FName SightTraceTag(TEXT("SpiderSight"));
+}
+
+FSpiderPerception::FSpiderPerception()
+	: SightCursor(0)
+{
+}
+
+void FSpiderPerception::AddSightTarget(AActor* Target)
+{
+	if (Target)
+	{
+		SightTargets.AddUnique(Target);
+	}
+}
+
+void FSpiderPerception::RemoveSightTarget(AActor* Target)
+{
+	SightTargets.Remove(Target);
+}
+
+void FSpiderPerception::ReportNoise(const FVector& Location, float Loudness, AActor* Instigator)
+{
+	if (Loudness > 0.f)
+	{
+		PendingNoises.Add(FNoiseEvent{ Location, Loudness, Instigator });
+	}
+}
+
+void FSpiderPerception::Reset()
+{
+	SpatialHash.Reset();
+	SightTargets.Reset();
+	PendingNoises.Reset();
+	SightChecksInFlight.Reset();
+	SightCandidates.Reset();
+	SightCursor = 0;
+}
+
+void FSpiderPerception::Update(UWorld* World, const TArray<ASmartSpiderCharacter*>& Spiders, const TArray<float>& SightDistancesSq, const TArray<float>& HearingDistancesSq)
+{
+	const USmartSpiderSettings* Settings = GetDefault<USmartSpiderSettings>();
+
+	ConsumeSightChecks(World);
+
+	const int32 NumSpiders = Spiders.Num();
+	Positions.SetNumUninitialized(NumSpiders, false);
+	float MaxSightDistanceSq = 0.f;
+	float MaxHearingDistanceSq = 0.f;
+	for (int32 Index = 0; Index < NumSpiders; ++Index)
+	{
+		ASmartSpiderCharacter* Spider = Spiders[Index];
+		if (!Spider)
+		{
+			Positions[Index] = FVector::ZeroVector;
+			continue;
+		}
+
+		const FVector Location = Spider->GetActorLocation();
+		Positions[Index] = Location;
+		MaxSightDistanceSq = FMath::Max(MaxSightDistanceSq, SightDistancesSq[Index]);
+		MaxHearingDistanceSq = FMath::Max(MaxHearingDistanceSq, HearingDistancesSq[Index]);
+
+		// Sensed targets leaving sight range are lost without a trace. Collected first, losing one removes every entry of it.
+		LostTargets.Reset();
+		for (AActor* Target : Spider->GetSensedActors())
+		{
+			if (!Target || Target->IsPendingKill() || FVector::DistSquared(Location, Target->GetActorLocation()) > SightDistancesSq[Index])
+			{
+				LostTargets.AddUnique(Target);
+			}
+		}
+
+		for (AActor* Target : LostTargets)
+		{
+			Spider->SetActorSensed(Target, false);
+		}
+	}
+
+	SpatialHash.Build(Positions, Settings->PerceptionCellSize);
+
+	DeliverNoises(Spiders, HearingDistancesSq, MaxHearingDistanceSq);
+
+	Targets.Reset();
+	for (int32 Index = SightTargets.Num() - 1; Index >= 0; --Index)
+	{
+		AActor* Target = SightTargets[Index].Get();
+		if (Target)
+		{
+			Targets.Add(Target);
+		}
+		else
+		{
+			SightTargets.RemoveAtSwap(Index, 1, false);
+		}
+	}
+
+	if (Settings->bSensePlayerPawns)
+	{
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* PlayerController = It->Get();
+			if (PlayerController && PlayerController->GetPawn())
+			{
+				Targets.AddUnique(PlayerController->GetPawn());
+			}
+		}
+	}
+
+	SightCandidates.Reset();
+	const float MaxSightDistance = FMath::Sqrt(MaxSightDistanceSq);
+	for (AActor* Target : Targets)
+	{
+		const FVector TargetLocation = Target->GetActorLocation();
+
+		QueryResults.Reset();
+		SpatialHash.Query(TargetLocation, MaxSightDistance, QueryResults);
+		for (int32 Index : QueryResults)
+		{
+			ASmartSpiderCharacter* Spider = Spiders[Index];
+			if (Spider && Spider != Target && FVector::DistSquared(Positions[Index], TargetLocation) <= SightDistancesSq[Index])
+			{
+				SightCandidates.Add(FSightCheck{ Spider, Target, FTraceHandle() });
+			}
+		}
+	}
+
+	IssueSightChecks(World);
+}
+
+void FSpiderPerception::ConsumeSightChecks(UWorld* World)
+{
+	for (const FSightCheck& Check : SightChecksInFlight)
+	{
+		ASmartSpiderCharacter* Spider = Check.Spider.Get();
+		AActor* Target = Check.Target.Get();
+		if (!Spider || !Target || !World->QueryTraceData(Check.Handle, TraceDatum)) continue;
+
+		const bool bBlocked = TraceDatum.OutHits.ContainsByPredicate([](const FHitResult& Hit) { return Hit.bBlockingHit; });
+		Spider->SetActorSensed(Target, !bBlocked);
+	}
+
+	SightChecksInFlight.Reset();
+}
+
+void FSpiderPerception::DeliverNoises(const TArray<ASmartSpiderCharacter*>& Spiders, const TArray<float>& HearingDistancesSq, float MaxHearingDistanceSq)
+{
+	if (PendingNoises.Num() == 0) return;
+
+	// Events may report noises again, they are heard at next update.
+	TArray<FNoiseEvent> Noises;
+	Exchange(Noises, PendingNoises);
+
+	const float MaxHearingDistance = FMath::Sqrt(MaxHearingDistanceSq);
+	for (const FNoiseEvent& Noise : Noises)
+	{
+		const float LoudnessSq = Noise.Loudness * Noise.Loudness;
+		AActor* Instigator = Noise.Instigator.Get();
+
+		QueryResults.Reset();
+		SpatialHash.Query(Noise.Location, MaxHearingDistance * Noise.Loudness, QueryResults);
+		for (int32 Index : QueryResults)
+		{
+			ASmartSpiderCharacter* Spider = Spiders[Index];
+			if (Spider && Spider != Instigator && FVector::DistSquared(Positions[Index], Noise.Location) <= HearingDistancesSq[Index] * LoudnessSq)
+			{
+				Spider->HearNoise(Noise.Location, Noise.Loudness, Instigator);
+			}
+		}
+	}
+}
+
+void FSpiderPerception::IssueSightChecks(UWorld* World)
+{
+	const int32 NumCandidates = SightCandidates.Num();
+	if (NumCandidates == 0) return;
+
+	const USmartSpiderSettings* Settings = GetDefault<USmartSpiderSettings>();
+	const int32 NumToIssue = Settings->MaxSightTracesPerFrame > 0 ? FMath::Min(Settings->MaxSightTracesPerFrame, NumCandidates) : NumCandidates;
+	const int32 Start = SightCursor % NumCandidates;
+	SightCursor = Start + NumToIssue;
+
+	for (int32 Count = 0; Count < NumToIssue; ++Count)
+	{
+		FSightCheck& Check = SightCandidates[(Start + Count) % NumCandidates];
+		ASmartSpiderCharacter* Spider = Check.Spider.Get();
+		AActor* Target = Check.Target.Get();
+
+		FCollisionQueryParams QueryParams(SpiderPerception::SightTraceTag, false, Spider);
+		QueryParams.AddIgnoredActor(Target);
+
+		Check.Handle = World->AsyncLineTraceByChannel(EAsyncTraceType::Test, Spider->GetEyePosition(), Target->GetActorLocation(), Settings->SightTraceChannel, QueryParams);
+		SightChecksInFlight.Add(Check);
+	}
+
+	INC_DWORD_STAT_BY(STAT_SpiderSightTraces, NumToIssue);
+}
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SpiderSpatialHash.h"
+#include "WorldCollision.h"
+
+class ASmartSpiderCharacter;
+
+/*
+* Sight and hearing of all swarm spiders of a world, in place of per-spider perception components.
+* Ranges are culled over a spatial hash of spiders with squared distances, line of sight is checked by async traces
+* within a per-frame budget, and results are consumed at next frame.
+*/
+class SMARTSPIDER_API FSpiderPerception
+{
+public:
+	FSpiderPerception();
+
+	void AddSightTarget(AActor* Target);
+	void RemoveSightTarget(AActor* Target);
+
+	/* Delivered to spiders within hearing range scaled by loudness at next update. */
+	void ReportNoise(const FVector& Location, float Loudness, AActor* Instigator);
+
+	/* Spider slots are indices of swarm manager, null slots are skipped. */
+	void Update(UWorld* World, const TArray<ASmartSpiderCharacter*>& Spiders, const TArray<float>& SightDistancesSq, const TArray<float>& HearingDistancesSq);
+
+	void Reset();
+
+	/* Sight checks issued at last update. */
+	FORCEINLINE int32 NumSightChecksInFlight() const { return SightChecksInFlight.Num(); }
+
+private:
+	struct FNoiseEvent
+	{
+		FVector Location;
+		float Loudness;
+		TWeakObjectPtr<AActor> Instigator;
+	};
+
+	struct FSightCheck
+	{
+		TWeakObjectPtr<ASmartSpiderCharacter> Spider;
+		TWeakObjectPtr<AActor> Target;
+		FTraceHandle Handle;
+	};
+
+	void ConsumeSightChecks(UWorld* World);
+	void DeliverNoises(const TArray<ASmartSpiderCharacter*>& Spiders, const TArray<float>& HearingDistancesSq, float MaxHearingDistanceSq);
+	void IssueSightChecks(UWorld* World);
+
+	FSpiderSpatialHash SpatialHash;
+
+	TArray<TWeakObjectPtr<AActor> > SightTargets;
+	TArray<FNoiseEvent> PendingNoises;
+
+	TArray<FSightCheck> SightChecksInFlight;
+
+	/* Spider and target pairs within sight range this frame, checked round-robin from @SightCursor. */
+	TArray<FSightCheck> SightCandidates;
+	int32 SightCursor;
+
+	/* Scratch kept for allocation. */
+	TArray<FVector> Positions;
+	TArray<AActor*> Targets;
+	TArray<AActor*> LostTargets;
+	TArray<int32> QueryResults;
+	FTraceDatum TraceDatum;
+};
@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderProbeKernels.h"
+
+namespace SpiderProbeKernels
+{
+	/* Components of four vectors, one lane each. */
+	struct FLanes
+	{
+		VectorRegister X;
+		VectorRegister Y;
+		VectorRegister Z;
+	};
+
+	static FORCEINLINE FLanes Load(const FVector* Vectors)
+	{
+		FLanes Lanes;
+		Lanes.X = MakeVectorRegister(Vectors[0].X, Vectors[1].X, Vectors[2].X, Vectors[3].X);
+		Lanes.Y = MakeVectorRegister(Vectors[0].Y, Vectors[1].Y, Vectors[2].Y, Vectors[3].Y);
+		Lanes.Z = MakeVectorRegister(Vectors[0].Z, Vectors[1].Z, Vectors[2].Z, Vectors[3].Z);
+		return Lanes;
+	}
+
+	static FORCEINLINE void Store(const FLanes& Lanes, int32 NumActive, FVector* const* OutVectors)
+	{
+		MS_ALIGN(16) float X[FSpiderProbeKernels::NumLanes] GCC_ALIGN(16);
+		MS_ALIGN(16) float Y[FSpiderProbeKernels::NumLanes] GCC_ALIGN(16);
+		MS_ALIGN(16) float Z[FSpiderProbeKernels::NumLanes] GCC_ALIGN(16);
+		VectorStoreAligned(Lanes.X, X);
+		VectorStoreAligned(Lanes.Y, Y);
+		VectorStoreAligned(Lanes.Z, Z);
+
+		for (int32 Lane = 0; Lane < NumActive; ++Lane)
+		{
+			*OutVectors[Lane] = FVector(X[Lane], Y[Lane], Z[Lane]);
+		}
+	}
+
+	static FORCEINLINE FLanes Cross(const FLanes& A, const FLanes& B)
+	{
+		FLanes Result;
+		Result.X = VectorSubtract(VectorMultiply(A.Y, B.Z), VectorMultiply(A.Z, B.Y));
+		Result.Y = VectorSubtract(VectorMultiply(A.Z, B.X), VectorMultiply(A.X, B.Z));
+		Result.Z = VectorSubtract(VectorMultiply(A.X, B.Y), VectorMultiply(A.Y, B.X));
+		return Result;
+	}
+
+	/* Same steps as FQuat::RotateVector, T = 2 * (Q x V), V' = V + W * T + (Q x T), then translated. */
+	static FORCEINLINE FLanes RotateTranslate(const FLanes& Q, const VectorRegister& W, const FLanes& Translation, const FLanes& V)
+	{
+		FLanes T = Cross(Q, V);
+		T.X = VectorAdd(T.X, T.X);
+		T.Y = VectorAdd(T.Y, T.Y);
+		T.Z = VectorAdd(T.Z, T.Z);
+
+		const FLanes QT = Cross(Q, T);
+
+		FLanes Result;
+		Result.X = VectorAdd(VectorAdd(VectorAdd(V.X, VectorMultiply(W, T.X)), QT.X), Translation.X);
+		Result.Y = VectorAdd(VectorAdd(VectorAdd(V.Y, VectorMultiply(W, T.Y)), QT.Y), Translation.Y);
+		Result.Z = VectorAdd(VectorAdd(VectorAdd(V.Z, VectorMultiply(W, T.Z)), QT.Z), Translation.Z);
+		return Result;
+	}
+}
+
+void FSpiderProbeKernels::TransformProbeSets(const FSpiderProbeSet* const* Sets, const FQuat* Rotations, const FVector* Locations, int32 Num,
+	FVector* OutStarts, FVector* OutEnds)
+{
+	using namespace SpiderProbeKernels;
+
+	for (int32 First = 0; First < Num; First += NumLanes)
+	{
+		// Tail lanes are padded with identity, their results are dropped.
+		const int32 NumActive = FMath::Min(NumLanes, Num - First);
+		FVector QuatAxes[NumLanes];
+		FVector Translations[NumLanes];
+		float QuatW[NumLanes];
+		const FSpiderProbeSet* LaneSets[NumLanes];
+		int32 NumRays = 0;
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			const bool bActive = Lane < NumActive;
+			const FQuat& Rotation = bActive ? Rotations[First + Lane] : FQuat::Identity;
+			QuatAxes[Lane] = FVector(Rotation.X, Rotation.Y, Rotation.Z);
+			QuatW[Lane] = Rotation.W;
+			Translations[Lane] = bActive ? Locations[First + Lane] : FVector::ZeroVector;
+			LaneSets[Lane] = Sets[bActive ? First + Lane : First];
+			NumRays = FMath::Max(NumRays, LaneSets[Lane]->NumRays);
+		}
+
+		const FLanes Q = Load(QuatAxes);
+		const VectorRegister W = MakeVectorRegister(QuatW[0], QuatW[1], QuatW[2], QuatW[3]);
+		const FLanes Translation = Load(Translations);
+
+		for (int32 Ray = 0; Ray < NumRays; ++Ray)
+		{
+			FVector LocalStarts[NumLanes];
+			FVector LocalEnds[NumLanes];
+			FVector* Starts[NumLanes];
+			FVector* Ends[NumLanes];
+			for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+			{
+				LocalStarts[Lane] = LaneSets[Lane]->LocalStarts[Ray];
+				LocalEnds[Lane] = LaneSets[Lane]->LocalEnds[Ray];
+				Starts[Lane] = &OutStarts[(First + Lane) * FSpiderProbeSet::MaxRays + Ray];
+				Ends[Lane] = &OutEnds[(First + Lane) * FSpiderProbeSet::MaxRays + Ray];
+			}
+
+			Store(RotateTranslate(Q, W, Translation, Load(LocalStarts)), NumActive, Starts);
+			Store(RotateTranslate(Q, W, Translation, Load(LocalEnds)), NumActive, Ends);
+		}
+	}
+}
+
+void FSpiderProbeKernels::TestAcceptableDistances(const FVector* TraceStarts, const FVector* ImpactPoints, const float* AcceptableDistancesSq, const float* TolerancesSq, int32 Num,
+	EAcceptableDistance* OutDistances)
+{
+	using namespace SpiderProbeKernels;
+
+	for (int32 First = 0; First < Num; First += NumLanes)
+	{
+		const int32 NumActive = FMath::Min(NumLanes, Num - First);
+		FVector Starts[NumLanes];
+		FVector Impacts[NumLanes];
+		float Acceptable[NumLanes];
+		float Tolerance[NumLanes];
+		for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			const int32 Index = First + FMath::Min(Lane, NumActive - 1);
+			Starts[Lane] = TraceStarts[Index];
+			Impacts[Lane] = ImpactPoints[Index];
+			Acceptable[Lane] = AcceptableDistancesSq[Index];
+			Tolerance[Lane] = TolerancesSq[Index];
+		}
+
+		const FLanes Start = Load(Starts);
+		const FLanes Impact = Load(Impacts);
+		const VectorRegister AcceptableSq = MakeVectorRegister(Acceptable[0], Acceptable[1], Acceptable[2], Acceptable[3]);
+		const VectorRegister ToleranceSq = MakeVectorRegister(Tolerance[0], Tolerance[1], Tolerance[2], Tolerance[3]);
+
+		// Same order as FVector::DistSquared.
+		const VectorRegister DeltaX = VectorSubtract(Impact.X, Start.X);
+		const VectorRegister DeltaY = VectorSubtract(Impact.Y, Start.Y);
+		const VectorRegister DeltaZ = VectorSubtract(Impact.Z, Start.Z);
+		const VectorRegister DistanceSq = VectorAdd(VectorAdd(VectorMultiply(DeltaX, DeltaX), VectorMultiply(DeltaY, DeltaY)), VectorMultiply(DeltaZ, DeltaZ));
+
+		const int32 EqualMask = VectorMaskBits(VectorCompareGT(ToleranceSq, VectorAbs(VectorSubtract(DistanceSq, AcceptableSq))));
+		const int32 LessMask = VectorMaskBits(VectorCompareGT(AcceptableSq, DistanceSq));
+
+		for (int32 Lane = 0; Lane < NumActive; ++Lane)
+		{
+			const int32 LaneBit = 1 << Lane;
+			OutDistances[First + Lane] = (EqualMask & LaneBit) ? EAcceptableDistance::Equal :
+										(LessMask & LaneBit) ? EAcceptableDistance::LessThan : EAcceptableDistance::GreaterThan;
+		}
+	}
+}
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+#include "EnvironmentTraceHit.h"
+
+/*
+* Probe math of many spiders at once in vector registers, four lanes per register.
+* Inputs are packed arrays, lanes are spiders for probe segments and hits for distance tests.
+* Results match the scalar path, FSpiderProbeSet::Transform and FAcceptableHitResult::TestAgainstHitResult.
+*/
+struct SMARTSPIDER_API FSpiderProbeKernels
+{
+	static const int32 NumLanes = 4;
+
+	/*
+	* World probe segments of spiders from rotation and location of each, local probes are resolved by probe set already.
+	* Out arrays hold FSpiderProbeSet::MaxRays segments per spider, slots past the rays of a spider are left unspecified.
+	*/
+	static void TransformProbeSets(const FSpiderProbeSet* const* Sets, const FQuat* Rotations, const FVector* Locations, int32 Num,
+		FVector* OutStarts, FVector* OutEnds);
+
+	/* Distance from trace start to impact against acceptable distance of each hit, with tolerance. All in square. */
+	static void TestAcceptableDistances(const FVector* TraceStarts, const FVector* ImpactPoints, const float* AcceptableDistancesSq, const float* TolerancesSq, int32 Num,
+		EAcceptableDistance* OutDistances);
+};
@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderProbeKernels.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace SpiderProbeKernelsTests
+{
+	/* Segments of rotated spiders far from origin lose a few ulps to the reordered math of the kernel. */
+	static const float SegmentTolerance = 0.01f;
+
+	static FSpiderProbeParams MakeProbeParams()
+	{
+		FSpiderProbeParams Params;
+		Params.TracingOffset_Eye = 25.f;
+		Params.TracingOffset_Bottom = 20.f;
+		Params.TracingOffset_BottomAssistor = 10.f;
+		Params.TracingDegreesOffset_ForwardBackward = 30.f;
+		Params.TracingDegreesOffset_LeftRight = 45.f;
+		Params.TracingDistance_Stick = 60.f;
+		Params.TracingDistance_Surface = 80.f;
+		Params.TracingDistanceTestToleranceSq = 4.f;
+		return Params;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSpiderProbeKernelsTransformTest, "SmartSpider.ProbeKernels.TransformProbeSets", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::SmokeFilter)
+
+bool FSpiderProbeKernelsTransformTest::RunTest(const FString& Parameters)
+{
+	using namespace SpiderProbeKernelsTests;
+
+	const FSpiderProbeParams Params = MakeProbeParams();
+
+	// Lanes of one register carry sets of different ray counts.
+	FSpiderProbeSet Sets[3];
+	Sets[0].Build(Params);
+	Sets[1].Build(Params);
+	Sets[1].AddRay(FSpiderProbeSet::MakeSideRay(Params, false, FColor::Red));
+	Sets[1].AddRay(FSpiderProbeSet::MakeSideRay(Params, true, FColor::Red));
+	Sets[2].Build(Params);
+	while (Sets[2].AddRay(FSpiderProbeRay(FVector(5.f, -5.f, 10.f), FVector(1.f, 1.f, -1.f), 50.f, FColor::Blue)));
+
+	// Counts around register width cover full registers and every tail length.
+	FRandomStream Stream(1);
+	for (int32 Num = 1; Num <= 3 * FSpiderProbeKernels::NumLanes + 1; ++Num)
+	{
+		TArray<const FSpiderProbeSet*> SpiderSets;
+		TArray<FQuat> Rotations;
+		TArray<FVector> Locations;
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			SpiderSets.Add(&Sets[Index % ARRAY_COUNT(Sets)]);
+			Rotations.Add(FRotator(Stream.FRandRange(-180, 180), Stream.FRandRange(-180, 180), Stream.FRandRange(-180, 180)).Quaternion());
+			Locations.Add(Stream.GetUnitVector() * Stream.FRandRange(0, 10000));
+		}
+
+		// One extra spider of sentinel slots catches tail lanes writing past the batch.
+		const FVector Sentinel(-1.f, -2.f, -3.f);
+		TArray<FVector> Starts;
+		TArray<FVector> Ends;
+		Starts.Init(Sentinel, (Num + 1) * FSpiderProbeSet::MaxRays);
+		Ends.Init(Sentinel, (Num + 1) * FSpiderProbeSet::MaxRays);
+
+		FSpiderProbeKernels::TransformProbeSets(SpiderSets.GetData(), Rotations.GetData(), Locations.GetData(), Num, Starts.GetData(), Ends.GetData());
+
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			FVector ScalarStarts[FSpiderProbeSet::MaxRays];
+			FVector ScalarEnds[FSpiderProbeSet::MaxRays];
+			SpiderSets[Index]->Transform(FTransform(Rotations[Index], Locations[Index]), ScalarStarts, ScalarEnds);
+
+			for (int32 Ray = 0; Ray < SpiderSets[Index]->NumRays; ++Ray)
+			{
+				const int32 Packed = Index * FSpiderProbeSet::MaxRays + Ray;
+				if (!Starts[Packed].Equals(ScalarStarts[Ray], SegmentTolerance) || !Ends[Packed].Equals(ScalarEnds[Ray], SegmentTolerance))
+				{
+					AddError(FString::Printf(TEXT("%d spiders, spider %d probe %d: kernel segment %s - %s, scalar %s - %s."), Num, Index, Ray,
+						*Starts[Packed].ToString(), *Ends[Packed].ToString(), *ScalarStarts[Ray].ToString(), *ScalarEnds[Ray].ToString()));
+				}
+			}
+		}
+
+		for (int32 Ray = 0; Ray < FSpiderProbeSet::MaxRays; ++Ray)
+		{
+			const int32 Packed = Num * FSpiderProbeSet::MaxRays + Ray;
+			if (Starts[Packed] != Sentinel || Ends[Packed] != Sentinel)
+			{
+				AddError(FString::Printf(TEXT("%d spiders: tail lane wrote probe %d past the batch."), Num, Ray));
+			}
+		}
+	}
+
+	return !HasAnyErrors();
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSpiderProbeKernelsDistanceTest, "SmartSpider.ProbeKernels.TestAcceptableDistances", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::SmokeFilter)
+
+bool FSpiderProbeKernelsDistanceTest::RunTest(const FString& Parameters)
+{
+	TArray<FVector> TraceStarts;
+	TArray<FVector> ImpactPoints;
+	TArray<float> AcceptableDistancesSq;
+	TArray<float> TolerancesSq;
+	TArray<EAcceptableDistance> Expected;
+
+	auto AddCase = [&](const FVector& Start, const FVector& Impact, float AcceptableDistanceSq, float ToleranceSq)
+	{
+		FAcceptableHitResult Hit;
+		Hit.HitResult.TraceStart = Start;
+		Hit.HitResult.ImpactPoint = Impact;
+		Hit.TestAgainstHitResult(AcceptableDistanceSq, ToleranceSq);
+
+		TraceStarts.Add(Start);
+		ImpactPoints.Add(Impact);
+		AcceptableDistancesSq.Add(AcceptableDistanceSq);
+		TolerancesSq.Add(ToleranceSq);
+		Expected.Add(Hit.AcceptableDistance);
+	};
+
+	// Tolerance edge in exact integer math, impact distance is 100 in square: delta equal to tolerance is not acceptable.
+	const FVector Start(10.f, 20.f, 30.f);
+	const FVector Impact = Start + FVector(0.f, 6.f, 8.f);
+	AddCase(Start, Impact, 100.f, 4.f);
+	AddCase(Start, Impact, 96.f, 4.f);
+	AddCase(Start, Impact, 104.f, 4.f);
+	AddCase(Start, Impact, 96.f, 5.f);
+	AddCase(Start, Impact, 104.f, 5.f);
+	AddCase(Start, Impact, 100.f, 0.f);
+
+	const EAcceptableDistance EdgeExpected[] =
+	{
+		EAcceptableDistance::Equal,
+		EAcceptableDistance::GreaterThan,
+		EAcceptableDistance::LessThan,
+		EAcceptableDistance::Equal,
+		EAcceptableDistance::Equal,
+		EAcceptableDistance::GreaterThan,
+	};
+
+	for (int32 Index = 0; Index < ARRAY_COUNT(EdgeExpected); ++Index)
+	{
+		TestEqual(FString::Printf(TEXT("Scalar tolerance edge case %d"), Index), (int32)Expected[Index], (int32)EdgeExpected[Index]);
+	}
+
+	// Random hits around acceptable distance, odd total count leaves a partial register.
+	FRandomStream Stream(2);
+	const int32 NumRandom = 8 * FSpiderProbeKernels::NumLanes + 1;
+	for (int32 Index = 0; Index < NumRandom; ++Index)
+	{
+		const FVector RandomStart = Stream.GetUnitVector() * Stream.FRandRange(0, 5000);
+		const float AcceptableDistance = Stream.FRandRange(10, 100);
+		const float ImpactDistance = AcceptableDistance + Stream.FRandRange(-3, 3);
+		AddCase(RandomStart, RandomStart + Stream.GetUnitVector() * ImpactDistance, FMath::Square(AcceptableDistance), 4.f);
+	}
+
+	// Every prefix, so the edge cases land in tail lanes too.
+	TArray<EAcceptableDistance> Distances;
+	for (int32 Num = 1; Num <= TraceStarts.Num(); Num += (Num < 2 * FSpiderProbeKernels::NumLanes) ? 1 : FSpiderProbeKernels::NumLanes + 1)
+	{
+		Distances.Init(EAcceptableDistance::Equal, Num + 1);
+		Distances[Num] = (EAcceptableDistance)0xFF;
+
+		FSpiderProbeKernels::TestAcceptableDistances(TraceStarts.GetData(), ImpactPoints.GetData(), AcceptableDistancesSq.GetData(), TolerancesSq.GetData(), Num, Distances.GetData());
+
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			if (Distances[Index] != Expected[Index])
+			{
+				AddError(FString::Printf(TEXT("%d hits, hit %d: kernel acceptable distance %d, scalar %d."), Num, Index, (int32)Distances[Index], (int32)Expected[Index]));
+			}
+		}
+
+		if (Distances[Num] != (EAcceptableDistance)0xFF)
+		{
+			AddError(FString::Printf(TEXT("%d hits: tail lane wrote past the batch."), Num));
+		}
+	}
+
+	return !HasAnyErrors();
+}
+
+#endif
@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderReplication.h"
+#include "Engine/NetSerialization.h"
+
+namespace SpiderNetQuantize
+{
+	static const uint32 NormalBits = 10;
+	static const uint32 HeadingBits = 10;
+
+	/* Surface velocity components, cm/s. */
+	static const int32 MaxSpeed = 4096;
+	static const uint32 SpeedBits = 16;
+
+	/* Surface normal within it is sent as one bit. */
+	static const float NormalAlongUpDot = 0.9999f;
+
+	enum EFlags
+	{
+		Attached = 1 << 0,
+		RelativeToBase = 1 << 1,
+		NormalAlongUp = 1 << 2,
+	};
+
+	static const uint32 NumFlags = 3;
+	static const uint32 SurfaceTypeBits = 2;
+
+	static FORCEINLINE float SignNotZero(float Value) { return Value >= 0.f ? 1.f : -1.f; }
+
+	static FORCEINLINE uint32 QuantizeUnit(float Value)
+	{
+		const uint32 MaxValue = (1 << NormalBits) - 1;
+		return (uint32)FMath::RoundToInt((FMath::Clamp(Value, -1.f, 1.f) * 0.5f + 0.5f) * MaxValue);
+	}
+
+	static FORCEINLINE float DequantizeUnit(uint32 Value)
+	{
+		const uint32 MaxValue = (1 << NormalBits) - 1;
+		return (float)Value / MaxValue * 2.f - 1.f;
+	}
+}
+
+FVector2D FSpiderNetQuantize::OctahedralEncode(const FVector& Vector)
+{
+	const float L1Norm = FMath::Abs(Vector.X) + FMath::Abs(Vector.Y) + FMath::Abs(Vector.Z);
+	if (L1Norm < SMALL_NUMBER) return FVector2D::ZeroVector;
+
+	FVector2D Encoded(Vector.X / L1Norm, Vector.Y / L1Norm);
+	if (Vector.Z < 0.f)
+	{
+		// Fold the lower hemisphere over the diagonals.
+		Encoded = FVector2D(
+			(1.f - FMath::Abs(Encoded.Y)) * SpiderNetQuantize::SignNotZero(Encoded.X),
+			(1.f - FMath::Abs(Encoded.X)) * SpiderNetQuantize::SignNotZero(Encoded.Y));
+	}
+
+	return Encoded;
+}
+
+FVector FSpiderNetQuantize::OctahedralDecode(const FVector2D& Encoded)
+{
+	FVector Vector(Encoded.X, Encoded.Y, 1.f - FMath::Abs(Encoded.X) - FMath::Abs(Encoded.Y));
+	if (Vector.Z < 0.f)
+	{
+		const float X = Vector.X;
+		Vector.X = (1.f - FMath::Abs(Vector.Y)) * SpiderNetQuantize::SignNotZero(X);
+		Vector.Y = (1.f - FMath::Abs(X)) * SpiderNetQuantize::SignNotZero(Vector.Y);
+	}
+
+	return Vector.GetSafeNormal();
+}
+
+void FSpiderNetQuantize::SerializeUnitVector(FArchive& Ar, FVector& Vector)
+{
+	uint32 X = 0;
+	uint32 Y = 0;
+	if (Ar.IsSaving())
+	{
+		const FVector2D Encoded = OctahedralEncode(Vector);
+		X = SpiderNetQuantize::QuantizeUnit(Encoded.X);
+		Y = SpiderNetQuantize::QuantizeUnit(Encoded.Y);
+	}
+
+	Ar.SerializeInt(X, 1 << SpiderNetQuantize::NormalBits);
+	Ar.SerializeInt(Y, 1 << SpiderNetQuantize::NormalBits);
+
+	// Saving side gets the quantized vector as well, so both sides build the same bases from it.
+	Vector = OctahedralDecode(FVector2D(SpiderNetQuantize::DequantizeUnit(X), SpiderNetQuantize::DequantizeUnit(Y)));
+}
+
+void FSpiderNetQuantize::SerializeRotation(FArchive& Ar, FQuat& Rotation)
+{
+	FVector Up = Rotation.GetUpVector();
+	SerializeUnitVector(Ar, Up);
+
+	FVector AxisX, AxisY;
+	Up.FindBestAxisVectors(AxisX, AxisY);
+
+	const uint32 NumHeadings = 1 << SpiderNetQuantize::HeadingBits;
+	uint32 Heading = 0;
+	if (Ar.IsSaving())
+	{
+		const FVector Forward = Rotation.GetForwardVector();
+		const float Angle = FMath::Atan2(FVector::DotProduct(Forward, AxisY), FVector::DotProduct(Forward, AxisX));
+		Heading = (uint32)FMath::RoundToInt((Angle / (2.f * PI) + 0.5f) * NumHeadings) % NumHeadings;
+	}
+
+	Ar.SerializeInt(Heading, NumHeadings);
+
+	if (Ar.IsLoading())
+	{
+		const float Angle = ((float)Heading / NumHeadings - 0.5f) * 2.f * PI;
+		Rotation = FRotationMatrix::MakeFromZX(Up, AxisX * FMath::Cos(Angle) + AxisY * FMath::Sin(Angle)).ToQuat();
+	}
+}
+
+bool FSpiderReplicatedSurfaceState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	// Work on copies, quantizing must not touch the state of server.
+	FQuat RepRotation = Rotation;
+	FVector RepSurfaceNormal = SurfaceNormal;
+	FVector RepLocation = Location;
+
+	uint8 Flags = 0;
+	uint8 Surface = (uint8)SurfaceType;
+	if (Ar.IsSaving())
+	{
+		Flags |= bAttached ? SpiderNetQuantize::Attached : 0;
+		Flags |= (bRelativeToBase && Base && Map) ? SpiderNetQuantize::RelativeToBase : 0;
+		Flags |= FVector::DotProduct(Rotation.GetUpVector(), SurfaceNormal) >= SpiderNetQuantize::NormalAlongUpDot ? SpiderNetQuantize::NormalAlongUp : 0;
+
+		// Base can not be sent without package map, location goes in world space then.
+		if (bRelativeToBase && Base && !(Flags & SpiderNetQuantize::RelativeToBase))
+		{
+			RepLocation = Base->GetComponentTransform().TransformPosition(Location);
+		}
+	}
+
+	Ar.SerializeBits(&Flags, SpiderNetQuantize::NumFlags);
+	Ar.SerializeBits(&Surface, SpiderNetQuantize::SurfaceTypeBits);
+
+	if (Flags & SpiderNetQuantize::RelativeToBase)
+	{
+		UObject* BaseObject = Base;
+		bOutSuccess = Map->SerializeObject(Ar, UPrimitiveComponent::StaticClass(), BaseObject);
+		Base = Cast<UPrimitiveComponent>(BaseObject);
+	}
+	else
+	{
+		Base = nullptr;
+		bOutSuccess = true;
+	}
+
+	bOutSuccess &= SerializePackedVector<1, 24>(RepLocation, Ar);
+
+	FSpiderNetQuantize::SerializeRotation(Ar, RepRotation);
+	if (Flags & SpiderNetQuantize::NormalAlongUp)
+	{
+		RepSurfaceNormal = RepRotation.GetUpVector();
+	}
+	else
+	{
+		FSpiderNetQuantize::SerializeUnitVector(Ar, RepSurfaceNormal);
+	}
+
+	// Velocity stays on the surface plane while attached, two components are enough.
+	if (Flags & SpiderNetQuantize::Attached)
+	{
+		FVector AxisX, AxisY;
+		RepSurfaceNormal.FindBestAxisVectors(AxisX, AxisY);
+
+		float SpeedX = FMath::Clamp(FVector::DotProduct(Velocity, AxisX), (float)-SpiderNetQuantize::MaxSpeed, (float)SpiderNetQuantize::MaxSpeed);
+		float SpeedY = FMath::Clamp(FVector::DotProduct(Velocity, AxisY), (float)-SpiderNetQuantize::MaxSpeed, (float)SpiderNetQuantize::MaxSpeed);
+		if (Ar.IsSaving())
+		{
+			WriteFixedCompressedFloat<SpiderNetQuantize::MaxSpeed, SpiderNetQuantize::SpeedBits>(SpeedX, Ar);
+			WriteFixedCompressedFloat<SpiderNetQuantize::MaxSpeed, SpiderNetQuantize::SpeedBits>(SpeedY, Ar);
+		}
+		else
+		{
+			ReadFixedCompressedFloat<SpiderNetQuantize::MaxSpeed, SpiderNetQuantize::SpeedBits>(SpeedX, Ar);
+			ReadFixedCompressedFloat<SpiderNetQuantize::MaxSpeed, SpiderNetQuantize::SpeedBits>(SpeedY, Ar);
+			Velocity = AxisX * SpeedX + AxisY * SpeedY;
+		}
+	}
+	else
+	{
+		bOutSuccess &= SerializePackedVector<1, 24>(Velocity, Ar);
+	}
+
+	if (Ar.IsLoading())
+	{
+		bAttached = !!(Flags & SpiderNetQuantize::Attached);
+		bRelativeToBase = !!(Flags & SpiderNetQuantize::RelativeToBase);
+		SurfaceType = (EEnvironmentSurface)Surface;
+		Location = RepLocation;
+		Rotation = RepRotation;
+		SurfaceNormal = RepSurfaceNormal;
+	}
+
+	return true;
+}
+
+bool FSpiderReplicatedSurfaceState::GetWorldLocation(FVector& OutLocation) const
+{
+	if (!bRelativeToBase)
+	{
+		OutLocation = Location;
+		return true;
+	}
+
+	if (!Base || Base->IsPendingKill()) return false;
+
+	OutLocation = Base->GetComponentTransform().TransformPosition(Location);
+	return true;
+}
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "EnvironmentTraceHit.h"
+#include "SpiderReplication.generated.h"
+
+/*
+* Surface state of spider sent to simulated proxies in place of replicated movement of character.
+* Rotation goes as octahedral up vector and heading around it, surface normal as octahedral vector or one bit when it matches up,
+* surface type in two bits, and velocity in two components on the surface plane while attached.
+* Location is relative to the surface base when spider walks on a movable, net addressable component.
+*/
+USTRUCT()
+struct SMARTSPIDER_API FSpiderReplicatedSurfaceState
+{
+	GENERATED_USTRUCT_BODY()
+
+	/* Movable component spider walks on, null if location is in world space. */
+	UPROPERTY()
+	UPrimitiveComponent* Base;
+
+	UPROPERTY()
+	FVector Location;
+
+	UPROPERTY()
+	FQuat Rotation;
+
+	UPROPERTY()
+	FVector SurfaceNormal;
+
+	UPROPERTY()
+	FVector Velocity;
+
+	UPROPERTY()
+	EEnvironmentSurface SurfaceType;
+
+	UPROPERTY()
+	uint8 bAttached : 1;
+
+	/* Location is relative to @Base, which may not be resolved on client yet. */
+	UPROPERTY()
+	uint8 bRelativeToBase : 1;
+
+	FSpiderReplicatedSurfaceState()
+		: Base(nullptr)
+		, Location(FVector::ZeroVector)
+		, Rotation(FQuat::Identity)
+		, SurfaceNormal(FVector::UpVector)
+		, Velocity(FVector::ZeroVector)
+		, SurfaceType(EEnvironmentSurface::Plane)
+		, bAttached(false)
+		, bRelativeToBase(false)
+	{
+	}
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+
+	/* World location, false if base has not been resolved on client yet. */
+	bool GetWorldLocation(FVector& OutLocation) const;
+};
+
+template<>
+struct TStructOpsTypeTraits<FSpiderReplicatedSurfaceState> : public TStructOpsTypeTraitsBase2<FSpiderReplicatedSurfaceState>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+/* Quantization of unit vectors and headings shared by spider replication. */
+struct SMARTSPIDER_API FSpiderNetQuantize
+{
+	/* Octahedral encoding, unit vector folded onto a square with two components of @NormalBits each. */
+	static void SerializeUnitVector(FArchive& Ar, FVector& Vector);
+
+	/* Up as unit vector, forward as heading around up. */
+	static void SerializeRotation(FArchive& Ar, FQuat& Rotation);
+
+	static FVector2D OctahedralEncode(const FVector& Vector);
+	static FVector OctahedralDecode(const FVector2D& Encoded);
+};
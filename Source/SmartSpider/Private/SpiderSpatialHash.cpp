@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderSpatialHash.h"
+
+FSpiderSpatialHash::FSpiderSpatialHash()
+	: CellSize(1)
+	, InvCellSize(1)
+{
+}
+
+void FSpiderSpatialHash::Reset()
+{
+	Positions.Reset();
+	Normals.Reset();
+	SortedItems.Reset();
+	CellKeys.Reset();
+	CellStarts.Reset();
+}
+
+void FSpiderSpatialHash::Build(const TArray<FVector>& InPositions, float InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.f);
+	InvCellSize = 1.f / CellSize;
+	Positions = InPositions;
+	Normals.Reset();
+
+	const int32 NumItems = Positions.Num();
+	ItemKeys.SetNumUninitialized(NumItems, false);
+	SortedItems.SetNumUninitialized(NumItems, false);
+	for (int32 Item = 0; Item < NumItems; ++Item)
+	{
+		ItemKeys[Item] = MakeCellKey(GetCell(Positions[Item]));
+		SortedItems[Item] = Item;
+	}
+
+	const TArray<uint64>& Keys = ItemKeys;
+	SortedItems.Sort([&Keys](int32 A, int32 B) { return Keys[A] < Keys[B]; });
+
+	CellKeys.Reset();
+	CellStarts.Reset();
+	for (int32 Index = 0; Index < NumItems; ++Index)
+	{
+		const uint64 Key = ItemKeys[SortedItems[Index]];
+		if (CellKeys.Num() == 0 || CellKeys.Last() != Key)
+		{
+			CellKeys.Add(Key);
+			CellStarts.Add(Index);
+		}
+	}
+	CellStarts.Add(NumItems);
+}
+
+void FSpiderSpatialHash::Build(const TArray<FVector>& InPositions, const TArray<FVector>& InNormals, float InCellSize)
+{
+	check(InPositions.Num() == InNormals.Num());
+
+	Build(InPositions, InCellSize);
+	Normals = InNormals;
+}
+
+int32 FSpiderSpatialHash::FindCell(uint64 Key) const
+{
+	int32 Low = 0;
+	int32 High = CellKeys.Num();
+	while (Low < High)
+	{
+		const int32 Mid = (Low + High) / 2;
+		if (CellKeys[Mid] < Key)
+		{
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+
+	return Low < CellKeys.Num() && CellKeys[Low] == Key ? Low : INDEX_NONE;
+}
+
+void FSpiderSpatialHash::Query(const FVector& Center, float Radius, TArray<int32>& OutItems) const
+{
+	ForEachInRadius(Center, Radius, [&OutItems](int32 Item, float DistanceSq) { OutItems.Add(Item); });
+}
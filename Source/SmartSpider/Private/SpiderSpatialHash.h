@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+
+/*
+* Uniform grid over item positions for range queries of all spiders at once.
+* Items are sorted by cell key, so a query is one binary search per overlapped cell and no per-cell allocation.
+*/
+class SMARTSPIDER_API FSpiderSpatialHash
+{
+public:
+	FSpiderSpatialHash();
+
+	/* Rebuild from positions, item index is the index in positions. */
+	void Build(const TArray<FVector>& InPositions, float InCellSize);
+
+	/* Rebuild with surface normal of each item, for queries that tell spiders on the same surface. */
+	void Build(const TArray<FVector>& InPositions, const TArray<FVector>& InNormals, float InCellSize);
+
+	void Reset();
+
+	/* Append items within radius of center, in squared distance. */
+	void Query(const FVector& Center, float Radius, TArray<int32>& OutItems) const;
+
+	/* Call functor(Item, DistanceSq) for items within radius of center. Read only, safe from worker threads. */
+	template<typename FunctorType>
+	void ForEachInRadius(const FVector& Center, float Radius, FunctorType&& Functor) const;
+
+	FORCEINLINE int32 Num() const { return Positions.Num(); }
+	FORCEINLINE const FVector& GetPosition(int32 Item) const { return Positions[Item]; }
+
+	/* Only valid if built with normals. */
+	FORCEINLINE const FVector& GetNormal(int32 Item) const { return Normals[Item]; }
+	FORCEINLINE bool HasNormals() const { return Normals.Num() == Positions.Num(); }
+
+	static FORCEINLINE uint64 MakeCellKey(const FIntVector& Cell)
+	{
+		// 21 bits per axis, enough for +-1M cells.
+		const uint64 Mask = (1ull << 21) - 1;
+		return ((uint64)(Cell.X + (1 << 20)) & Mask) << 42 | ((uint64)(Cell.Y + (1 << 20)) & Mask) << 21 | ((uint64)(Cell.Z + (1 << 20)) & Mask);
+	}
+
+private:
+	FORCEINLINE FIntVector GetCell(const FVector& Location) const
+	{
+		return FIntVector(FMath::FloorToInt(Location.X * InvCellSize), FMath::FloorToInt(Location.Y * InvCellSize), FMath::FloorToInt(Location.Z * InvCellSize));
+	}
+
+	int32 FindCell(uint64 Key) const;
+
+	float CellSize;
+	float InvCellSize;
+	TArray<FVector> Positions;
+	TArray<FVector> Normals;
+
+	/* Items sorted by cell, items of cell C are SortedItems[CellStarts[C], CellStarts[C + 1]). */
+	TArray<int32> SortedItems;
+	TArray<uint64> CellKeys;
+	TArray<int32> CellStarts;
+
+	/* Scratch of build, kept for its allocation. */
+	TArray<uint64> ItemKeys;
+};
+
+template<typename FunctorType>
+void FSpiderSpatialHash::ForEachInRadius(const FVector& Center, float Radius, FunctorType&& Functor) const
+{
+	if (CellKeys.Num() == 0) return;
+
+	const FIntVector MinCell = GetCell(Center - FVector(Radius));
+	const FIntVector MaxCell = GetCell(Center + FVector(Radius));
+	const float RadiusSq = Radius * Radius;
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+			{
+				const int32 Cell = FindCell(MakeCellKey(FIntVector(X, Y, Z)));
+				if (Cell == INDEX_NONE) continue;
+
+				for (int32 Index = CellStarts[Cell]; Index < CellStarts[Cell + 1]; ++Index)
+				{
+					const int32 Item = SortedItems[Index];
+					const float DistanceSq = FVector::DistSquared(Center, Positions[Item]);
+					if (DistanceSq <= RadiusSq)
+					{
+						Functor(Item, DistanceSq);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+#include "EnvironmentTraceHit.h"
+
+/*
+* Stats of spider hot path, "stat SmartSpider" in game, or capture with "stat startfile" for per-spider timelines.
+* Stats are compiled out of shipping builds along with every scope below.
+*/
+DECLARE_STATS_GROUP(TEXT("SmartSpider"), STATGROUP_SmartSpider, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Swarm Tick"), STAT_SpiderSwarmTick, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Schedule Traces"), STAT_SpiderScheduleTraces, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Simulate Env"), STAT_SpiderSimulateEnv, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Gather Probes"), STAT_SpiderGatherProbes, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Probe Traces"), STAT_SpiderProbeTraces, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Async Probes"), STAT_SpiderAsyncProbes, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Classify Probes"), STAT_SpiderClassifyProbes, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Apply Surface"), STAT_SpiderApplySurface, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Handle OnAir"), STAT_SpiderHandleOnAir, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Handle Plane"), STAT_SpiderHandlePlane, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Handle Convex"), STAT_SpiderHandleConvex, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Handle Concave"), STAT_SpiderHandleConcave, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Stick To Surface"), STAT_SpiderStickToSurface, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Snap To Surface"), STAT_SpiderSnapToSurface, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Blueprint Events"), STAT_SpiderBlueprintEvents, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Start Wall Walking"), STAT_SpiderStartWallWalking, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Phys Wall Walk"), STAT_SpiderPhysWallWalk, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Perception"), STAT_SpiderPerception, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Separation"), STAT_SpiderSeparation, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Flow Fields"), STAT_SpiderFlowFields, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Path Search"), STAT_SpiderPathSearch, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Agents"), STAT_SpiderAgents, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Leg IK"), STAT_SpiderLegIK, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Net Smoothing"), STAT_SpiderNetSmoothing, STATGROUP_SmartSpider, SMARTSPIDER_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Traces Issued"), STAT_SpiderTracesIssued, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Probe Cache Hits"), STAT_SpiderProbeCacheHits, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Distance Field Probes"), STAT_SpiderDistanceFieldProbes, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sight Traces"), STAT_SpiderSightTraces, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Transitions To OnAir"), STAT_SpiderTransitionsToOnAir, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Transitions To Plane"), STAT_SpiderTransitionsToPlane, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Transitions To Convex"), STAT_SpiderTransitionsToConvex, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Transitions To Concave"), STAT_SpiderTransitionsToConcave, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Edge Trajectories"), STAT_SpiderEdgeTrajectories, STATGROUP_SmartSpider, SMARTSPIDER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Dormant Spiders"), STAT_SpiderDormant, STATGROUP_SmartSpider, SMARTSPIDER_API);
+
+/* Count surface change by the new surface type. */
+FORCEINLINE void IncSpiderTransitionStat(EEnvironmentSurface NewSurface)
+{
+#if STATS
+	switch (NewSurface)
+	{
+		case EEnvironmentSurface::OnAir:
+			INC_DWORD_STAT(STAT_SpiderTransitionsToOnAir);
+			break;
+
+		case EEnvironmentSurface::Plane:
+			INC_DWORD_STAT(STAT_SpiderTransitionsToPlane);
+			break;
+
+		case EEnvironmentSurface::Convex:
+			INC_DWORD_STAT(STAT_SpiderTransitionsToConvex);
+			break;
+
+		case EEnvironmentSurface::Concave:
+			INC_DWORD_STAT(STAT_SpiderTransitionsToConcave);
+			break;
+
+		default:
+			break;
+	}
+#endif
+}
@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderSurfaceBakeVolume.h"
+#include "EngineUtils.h"
+
+ASpiderSurfaceBakeVolume::ASpiderSurfaceBakeVolume()
+{
+	SurfaceGraph = nullptr;
+}
+
+void ASpiderSurfaceBakeVolume::BakeSurfaceGraph()
+{
+#if WITH_EDITOR
+	if (!SurfaceGraph)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s has no surface graph asset to bake into."), *GetName());
+		return;
+	}
+
+	TArray<AActor*> IgnoredActors = ActorsToIgnore;
+	IgnoredActors.Add(this);
+
+	SurfaceGraph->Modify();
+	SurfaceGraph->Bake(GetWorld(), GetComponentsBoundingBox(true), BakeParams, IgnoredActors);
+	SurfaceGraph->MarkPackageDirty();
+
+	UE_LOG(LogTemp, Log, TEXT("%s baked %d surface nodes into %s."), *GetName(), SurfaceGraph->Num(), *SurfaceGraph->GetPathName());
+#endif
+}
+
+USpiderSurfaceGraph* ASpiderSurfaceBakeVolume::FindSurfaceGraph(UObject* WorldContextObject, FVector Location)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (!World) return nullptr;
+
+	for (TActorIterator<ASpiderSurfaceBakeVolume> It(World); It; ++It)
+	{
+		if (It->SurfaceGraph && !It->SurfaceGraph->IsEmpty() && It->SurfaceGraph->GetBounds().IsInside(Location))
+		{
+			return It->SurfaceGraph;
+		}
+	}
+
+	return nullptr;
+}
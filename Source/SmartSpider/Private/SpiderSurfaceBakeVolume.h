@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Volume.h"
+#include "SpiderSurfaceGraph.h"
+#include "SpiderSurfaceBakeVolume.generated.h"
+
+/*
+* Bounds of climbable surfaces baked into a surface graph asset.
+* Create the graph as a data asset of USpiderSurfaceGraph, assign it and bake in editor.
+*/
+UCLASS(ClassGroup = Spider)
+class SMARTSPIDER_API ASpiderSurfaceBakeVolume : public AVolume
+{
+	GENERATED_BODY()
+
+protected:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, category = "Surface Graph")
+	USpiderSurfaceGraph* SurfaceGraph;
+
+	UPROPERTY(EditAnywhere, category = "Surface Graph")
+	FSpiderSurfaceBakeParams BakeParams;
+
+	/* Movable or dynamic actors which should not be baked as climbable. */
+	UPROPERTY(EditAnywhere, category = "Surface Graph")
+	TArray<AActor*> ActorsToIgnore;
+
+public:
+	ASpiderSurfaceBakeVolume();
+
+	/* Extract climbable surfaces within the volume into @SurfaceGraph, save the asset afterwards. */
+	UFUNCTION(CallInEditor, category = "Surface Graph")
+	void BakeSurfaceGraph();
+
+	FORCEINLINE USpiderSurfaceGraph* GetSurfaceGraph() const { return SurfaceGraph; }
+
+	/* Surface graph of bake volume encompassing location, null if not found. */
+	UFUNCTION(BlueprintCallable, category = "SmartSpider", meta = (WorldContext = "WorldContextObject"))
+	static USpiderSurfaceGraph* FindSurfaceGraph(UObject* WorldContextObject, FVector Location);
+};
@@ -0,0 +1,363 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderSurfaceGraph.h"
+
+namespace SpiderSurfaceGraph
+{
+	/* Bump when layout of serialized arrays changes. 2: cell size and bounds moved from asset properties into graph data. */
+	static const int32 SerializeVersion = 2;
+
+	/* Surfaces facing a sweep direction less than it are left to other sweeps. */
+	static const float MinFacingDot = 0.3f;
+
+	/* Samples of the same cell with normals closer than it are merged. */
+	static const float MergeNormalDot = 0.9f;
+}
+
+FSpiderSurfaceGraphData::FSpiderSurfaceGraphData()
+	: CellSize(100)
+{
+	Bounds.Init();
+	EdgeOffsets.Add(0);
+	CellStarts.Add(0);
+}
+
+bool FSpiderSurfaceGraphData::Serialize(FArchive& Ar)
+{
+	int32 Version = SpiderSurfaceGraph::SerializeVersion;
+	Ar << Version;
+
+	if (Ar.IsLoading() && Version > SpiderSurfaceGraph::SerializeVersion)
+	{
+		Ar.SetError();
+		return false;
+	}
+
+	// Version 1 kept them as asset properties, which are gone.
+	if (Version >= 2)
+	{
+		Ar << CellSize;
+		Ar << Bounds;
+	}
+
+	NodePositions.BulkSerialize(Ar);
+	NodeNormals.BulkSerialize(Ar);
+	EdgeOffsets.BulkSerialize(Ar);
+	EdgeTargets.BulkSerialize(Ar);
+	EdgeCosts.BulkSerialize(Ar);
+	EdgeSurfaces.BulkSerialize(Ar);
+	CellKeys.BulkSerialize(Ar);
+	CellStarts.BulkSerialize(Ar);
+
+	// Arrays were read to keep the archive in sync, but nodes can not be found without cell size.
+	if (Version < 2)
+	{
+		*this = FSpiderSurfaceGraphData();
+		return false;
+	}
+
+	return true;
+}
+
+int32 FSpiderSurfaceGraphData::FindCell(uint64 Key) const
+{
+	int32 Low = 0;
+	int32 High = CellKeys.Num();
+	while (Low < High)
+	{
+		const int32 Mid = (Low + High) / 2;
+		if (CellKeys[Mid] < Key)
+		{
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+
+	return Low < CellKeys.Num() && CellKeys[Low] == Key ? Low : INDEX_NONE;
+}
+
+int32 FSpiderSurfaceGraphData::FindNearestNode(const FVector& Location, float MaxDistance) const
+{
+	if (IsEmpty() || CellSize <= 0.f) return INDEX_NONE;
+
+	const FIntVector CenterCell = GetCell(Location);
+	const int32 Radius = FMath::Max(FMath::CeilToInt(MaxDistance / CellSize), 1);
+
+	int32 NearestNode = INDEX_NONE;
+	float NearestDistanceSq = FMath::Square(MaxDistance);
+	for (int32 X = -Radius; X <= Radius; ++X)
+	{
+		for (int32 Y = -Radius; Y <= Radius; ++Y)
+		{
+			for (int32 Z = -Radius; Z <= Radius; ++Z)
+			{
+				const int32 Cell = FindCell(MakeCellKey(CenterCell + FIntVector(X, Y, Z)));
+				if (Cell == INDEX_NONE) continue;
+
+				for (int32 Node = CellStarts[Cell]; Node < CellStarts[Cell + 1]; ++Node)
+				{
+					const float DistanceSq = FVector::DistSquared(Location, NodePositions[Node]);
+					if (DistanceSq < NearestDistanceSq)
+					{
+						NearestDistanceSq = DistanceSq;
+						NearestNode = Node;
+					}
+				}
+			}
+		}
+	}
+
+	return NearestNode;
+}
+
+USpiderSurfaceGraph::USpiderSurfaceGraph()
+	: Data(MakeShareable(new FSpiderSurfaceGraphData()))
+{
+	NumNodes = 0;
+	NumEdges = 0;
+}
+
+void USpiderSurfaceGraph::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	if (Ar.IsLoading())
+	{
+		TSharedRef<FSpiderSurfaceGraphData, ESPMode::ThreadSafe> LoadedData = MakeShareable(new FSpiderSurfaceGraphData());
+		if (!LoadedData->Serialize(Ar))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Surface graph %s was baked by an incompatible version and is dropped, rebake it."), *GetPathName());
+			LoadedData = MakeShareable(new FSpiderSurfaceGraphData());
+		}
+		Data = LoadedData;
+	}
+	else
+	{
+		const_cast<FSpiderSurfaceGraphData&>(*Data).Serialize(Ar);
+	}
+
+	NumNodes = Data->Num();
+	NumEdges = Data->EdgeTargets.Num();
+}
+
+#if WITH_EDITOR
+void USpiderSurfaceGraph::Bake(UWorld* World, const FBox& InBounds, const FSpiderSurfaceBakeParams& Params, const TArray<AActor*>& ActorsToIgnore)
+{
+	check(World);
+
+	const float Spacing = Params.NodeSpacing;
+
+	FCollisionObjectQueryParams ObjectQueryParams;
+	for (const TEnumAsByte<EObjectTypeQuery>& ObjectType : Params.QueryObjectsType)
+	{
+		ObjectQueryParams.AddObjectTypesToQuery(UEngineTypes::ConvertToCollisionChannel(ObjectType));
+	}
+
+	static const FName BakeTraceTag(TEXT("SpiderSurfaceBake"));
+	FCollisionQueryParams QueryParams(BakeTraceTag, Params.bTraceComplex);
+	QueryParams.AddIgnoredActors(ActorsToIgnore);
+
+	// Sample surfaces: march rays along both directions of each axis through the bounds.
+	// Rays are aligned with node cells, so a flat surface gets one sample per cell.
+	TArray<FVector> Positions;
+	TArray<FVector> Normals;
+	TMap<FIntVector, TArray<int32> > SampleCells;
+
+	auto AddSample = [&](const FVector& Position, const FVector& Normal)
+	{
+		const FIntVector Cell(FMath::FloorToInt(Position.X / Spacing), FMath::FloorToInt(Position.Y / Spacing), FMath::FloorToInt(Position.Z / Spacing));
+		TArray<int32>& CellSamples = SampleCells.FindOrAdd(Cell);
+		for (int32 Sample : CellSamples)
+		{
+			if (FVector::DotProduct(Normals[Sample], Normal) > SpiderSurfaceGraph::MergeNormalDot) return;
+		}
+
+		CellSamples.Add(Positions.Add(Position));
+		Normals.Add(Normal);
+	};
+
+	if (ObjectQueryParams.IsValid())
+	{
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			const int32 AxisU = (Axis + 1) % 3;
+			const int32 AxisV = (Axis + 2) % 3;
+			const int32 FirstU = FMath::FloorToInt(InBounds.Min[AxisU] / Spacing);
+			const int32 LastU = FMath::FloorToInt(InBounds.Max[AxisU] / Spacing);
+			const int32 FirstV = FMath::FloorToInt(InBounds.Min[AxisV] / Spacing);
+			const int32 LastV = FMath::FloorToInt(InBounds.Max[AxisV] / Spacing);
+			const int32 MaxHitsPerRay = FMath::CeilToInt(InBounds.GetSize()[Axis] / Spacing) * 2 + 16;
+
+			for (int32 Sign = -1; Sign <= 1; Sign += 2)
+			{
+				FVector Dir = FVector::ZeroVector;
+				Dir[Axis] = Sign;
+
+				for (int32 U = FirstU; U <= LastU; ++U)
+				{
+					for (int32 V = FirstV; V <= LastV; ++V)
+					{
+						FVector Start;
+						Start[AxisU] = (U + 0.5f) * Spacing;
+						Start[AxisV] = (V + 0.5f) * Spacing;
+						Start[Axis] = Sign > 0 ? InBounds.Min[Axis] : InBounds.Max[Axis];
+
+						FVector End = Start;
+						End[Axis] = Sign > 0 ? InBounds.Max[Axis] : InBounds.Min[Axis];
+
+						FCollisionQueryParams RayParams = QueryParams;
+						FHitResult Hit;
+						for (int32 Step = 0; Step < MaxHitsPerRay && World->LineTraceSingleByObjectType(Hit, Start, End, ObjectQueryParams, RayParams); ++Step)
+						{
+							if (Hit.bStartPenetrating || Hit.Time <= 0.f)
+							{
+								// Started inside simple collision, the rest of it faces away from the ray anyway.
+								RayParams.AddIgnoredComponent(Hit.Component.Get());
+								continue;
+							}
+
+							if (FVector::DotProduct(Hit.ImpactNormal, -Dir) > SpiderSurfaceGraph::MinFacingDot)
+							{
+								AddSample(Hit.ImpactPoint, Hit.ImpactNormal);
+							}
+
+							Start = Hit.ImpactPoint + Dir * 0.1f;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Link samples of neighbor cells, labeled by the surface spider crosses between them.
+	struct FBakeEdge
+	{
+		int32 Target;
+		float Cost;
+		EEnvironmentSurface Surface;
+	};
+
+	TArray<TArray<FBakeEdge> > SampleEdges;
+	SampleEdges.SetNum(Positions.Num());
+
+	const float MaxEdgeLengthSq = FMath::Square(Spacing * 1.75f);
+	const float PlaneDot = FMath::Cos(FMath::DegreesToRadians(Params.PlaneAngleTolerance));
+	for (int32 Sample = 0; Sample < Positions.Num(); ++Sample)
+	{
+		const FVector& Position = Positions[Sample];
+		const FVector& Normal = Normals[Sample];
+		const FIntVector Cell(FMath::FloorToInt(Position.X / Spacing), FMath::FloorToInt(Position.Y / Spacing), FMath::FloorToInt(Position.Z / Spacing));
+
+		for (int32 X = -1; X <= 1; ++X)
+		{
+			for (int32 Y = -1; Y <= 1; ++Y)
+			{
+				for (int32 Z = -1; Z <= 1; ++Z)
+				{
+					const TArray<int32>* Neighbors = SampleCells.Find(Cell + FIntVector(X, Y, Z));
+					if (!Neighbors) continue;
+
+					for (int32 Neighbor : *Neighbors)
+					{
+						// Each pair is tested once and linked both ways.
+						if (Neighbor <= Sample) continue;
+
+						const FVector Delta = Positions[Neighbor] - Position;
+						if (Delta.SizeSquared() > MaxEdgeLengthSq) continue;
+
+						const FVector& NeighborNormal = Normals[Neighbor];
+						const float NormalDot = FVector::DotProduct(Normal, NeighborNormal);
+
+						// Opposite sides of a thin wall.
+						if (NormalDot < -0.5f) continue;
+
+						EEnvironmentSurface Surface;
+						if (NormalDot >= PlaneDot)
+						{
+							// Parallel surfaces at different heights, e.g. stair steps, are linked through their risers.
+							if (FMath::Abs(FVector::DotProduct(Normal, Delta)) > Spacing * 0.25f) continue;
+							Surface = EEnvironmentSurface::Plane;
+						}
+						else
+						{
+							Surface = FVector::DotProduct(NeighborNormal - Normal, Delta) > 0.f ? EEnvironmentSurface::Convex : EEnvironmentSurface::Concave;
+						}
+
+						// Path over a convex edge goes around the corner, lift it high enough to pass over.
+						const float Lift = Surface == EEnvironmentSurface::Convex ? FMath::Max(Params.ClearanceHeight, Delta.Size()) : Params.ClearanceHeight;
+						if (World->LineTraceTestByObjectType(Position + Normal * Lift, Positions[Neighbor] + NeighborNormal * Lift, ObjectQueryParams, QueryParams)) continue;
+
+						const float Cost = Delta.Size() * (Surface == EEnvironmentSurface::Plane ? 1.f : Params.TransitionCostScale);
+						SampleEdges[Sample].Add({ Neighbor, Cost, Surface });
+						SampleEdges[Neighbor].Add({ Sample, Cost, Surface });
+					}
+				}
+			}
+		}
+	}
+
+	// Sort nodes by cell, so nodes of a cell are contiguous.
+	TSharedRef<FSpiderSurfaceGraphData, ESPMode::ThreadSafe> NewData = MakeShareable(new FSpiderSurfaceGraphData());
+	FSpiderSurfaceGraphData& Graph = NewData.Get();
+	Graph.CellSize = Spacing;
+	Graph.Bounds = InBounds;
+
+	TArray<uint64> SampleKeys;
+	SampleKeys.SetNumUninitialized(Positions.Num());
+	TArray<int32> Order;
+	Order.SetNumUninitialized(Positions.Num());
+	for (int32 Sample = 0; Sample < Positions.Num(); ++Sample)
+	{
+		SampleKeys[Sample] = FSpiderSurfaceGraphData::MakeCellKey(Graph.GetCell(Positions[Sample]));
+		Order[Sample] = Sample;
+	}
+	Order.Sort([&SampleKeys](int32 A, int32 B) { return SampleKeys[A] < SampleKeys[B]; });
+
+	TArray<int32> Remap;
+	Remap.SetNumUninitialized(Positions.Num());
+	for (int32 Node = 0; Node < Order.Num(); ++Node)
+	{
+		Remap[Order[Node]] = Node;
+	}
+
+	Graph.NodePositions.Reset(Positions.Num());
+	Graph.NodeNormals.Reset(Positions.Num());
+	Graph.EdgeOffsets.Reset(Positions.Num() + 1);
+	Graph.EdgeTargets.Reset();
+	Graph.EdgeCosts.Reset();
+	Graph.EdgeSurfaces.Reset();
+	Graph.CellKeys.Reset();
+	Graph.CellStarts.Reset();
+
+	for (int32 Node = 0; Node < Order.Num(); ++Node)
+	{
+		const int32 Sample = Order[Node];
+		Graph.NodePositions.Add(Positions[Sample]);
+		Graph.NodeNormals.Add(Normals[Sample]);
+
+		if (Graph.CellKeys.Num() == 0 || Graph.CellKeys.Last() != SampleKeys[Sample])
+		{
+			Graph.CellKeys.Add(SampleKeys[Sample]);
+			Graph.CellStarts.Add(Node);
+		}
+
+		Graph.EdgeOffsets.Add(Graph.EdgeTargets.Num());
+		for (const FBakeEdge& Edge : SampleEdges[Sample])
+		{
+			Graph.EdgeTargets.Add(Remap[Edge.Target]);
+			Graph.EdgeCosts.Add(Edge.Cost);
+			Graph.EdgeSurfaces.Add((uint8)Edge.Surface);
+		}
+	}
+	Graph.EdgeOffsets.Add(Graph.EdgeTargets.Num());
+	Graph.CellStarts.Add(Graph.NodePositions.Num());
+
+	Data = NewData;
+	NumNodes = Graph.NodePositions.Num();
+	NumEdges = Graph.EdgeTargets.Num();
+}
+#endif
@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Engine/DataAsset.h"
+#include "EnvironmentTraceHit.h"
+#include "SpiderSurfaceGraph.generated.h"
+
+/* Tuning of surface graph bake. */
+USTRUCT(BlueprintType)
+struct FSpiderSurfaceBakeParams
+{
+	GENERATED_USTRUCT_BODY()
+
+	/* Climbable objects, keep the same as @QueryObjectsType of spiders. */
+	UPROPERTY(EditAnywhere, category = "Bake")
+	TArray<TEnumAsByte<EObjectTypeQuery> > QueryObjectsType;
+
+	UPROPERTY(EditAnywhere, category = "Bake")
+	uint32 bTraceComplex : 1;
+
+	/* Distance between surface nodes, also the cell size of nearest node lookup. */
+	UPROPERTY(EditAnywhere, category = "Bake", meta = (ClampMin = "10.0"))
+	float NodeSpacing;
+
+	/* Free space required above surface for spider to walk between two nodes. */
+	UPROPERTY(EditAnywhere, category = "Bake", meta = (ClampMin = "0.0"))
+	float ClearanceHeight;
+
+	/* Max degrees between node normals still treated as the same plane. */
+	UPROPERTY(EditAnywhere, category = "Bake", meta = (ClampMin = "0.0", ClampMax = "90.0"))
+	float PlaneAngleTolerance;
+
+	/* Cost multiplier of crossing convex and concave edges, so planning prefers fewer surface transitions. */
+	UPROPERTY(EditAnywhere, category = "Bake", meta = (ClampMin = "1.0"))
+	float TransitionCostScale;
+
+	FSpiderSurfaceBakeParams()
+	{
+		QueryObjectsType.Add(UEngineTypes::ConvertToObjectType(ECollisionChannel::ECC_WorldStatic));
+		bTraceComplex = false;
+		NodeSpacing = 100;
+		ClearanceHeight = 10;
+		PlaneAngleTolerance = 10;
+		TransitionCostScale = 1.5f;
+	}
+};
+
+/*
+* Climbable surfaces baked into a graph of surface nodes, for spider navigation on walls and ceilings.
+* Edges are stored in compressed rows(CSR) and labeled with the surface spider crosses.
+* Nodes are sorted by grid cell, so nearest node lookup is a binary search over cell keys.
+* Immutable once built, so path searches can read it from worker threads.
+*/
+struct SMARTSPIDER_API FSpiderSurfaceGraphData
+{
+	TArray<FVector> NodePositions;
+	TArray<FVector> NodeNormals;
+
+	/* Edges of node N are [EdgeOffsets[N], EdgeOffsets[N + 1]). */
+	TArray<int32> EdgeOffsets;
+	TArray<int32> EdgeTargets;
+	TArray<float> EdgeCosts;
+	TArray<uint8> EdgeSurfaces;
+
+	/* Sorted keys of non-empty cells, nodes of cell C are [CellStarts[C], CellStarts[C + 1]). */
+	TArray<uint64> CellKeys;
+	TArray<int32> CellStarts;
+
+	float CellSize;
+	FBox Bounds;
+
+	FSpiderSurfaceGraphData();
+
+	/* Plain arrays are bulk serialized, loading does no per-element parsing. False if loaded data is stale and was dropped. */
+	bool Serialize(FArchive& Ar);
+
+	FORCEINLINE int32 Num() const { return NodePositions.Num(); }
+	FORCEINLINE bool IsEmpty() const { return NodePositions.Num() == 0; }
+
+	FORCEINLINE int32 GetEdgeBegin(int32 Node) const { return EdgeOffsets[Node]; }
+	FORCEINLINE int32 GetEdgeEnd(int32 Node) const { return EdgeOffsets[Node + 1]; }
+	FORCEINLINE EEnvironmentSurface GetEdgeSurface(int32 Edge) const { return (EEnvironmentSurface)EdgeSurfaces[Edge]; }
+
+	/* Nearest node within max distance, INDEX_NONE if not found. */
+	int32 FindNearestNode(const FVector& Location, float MaxDistance) const;
+	int32 FindCell(uint64 Key) const;
+
+	FORCEINLINE FIntVector GetCell(const FVector& Location) const
+	{
+		return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+	}
+
+	static FORCEINLINE uint64 MakeCellKey(const FIntVector& Cell)
+	{
+		// 21 bits per axis, enough for +-1M cells.
+		const uint64 Mask = (1ull << 21) - 1;
+		return ((uint64)(Cell.X + (1 << 20)) & Mask) << 42 | ((uint64)(Cell.Y + (1 << 20)) & Mask) << 21 | ((uint64)(Cell.Z + (1 << 20)) & Mask);
+	}
+};
+
+typedef TSharedRef<const FSpiderSurfaceGraphData, ESPMode::ThreadSafe> FSpiderSurfaceGraphDataRef;
+
+/* Asset of baked surface graph, rebaking swaps in new graph data while searches may still hold the old one. */
+UCLASS(BlueprintType)
+class SMARTSPIDER_API USpiderSurfaceGraph : public UDataAsset
+{
+	GENERATED_BODY()
+
+protected:
+	FSpiderSurfaceGraphDataRef Data;
+
+	UPROPERTY(VisibleAnywhere, Transient, category = "Surface Graph")
+	int32 NumNodes;
+
+	UPROPERTY(VisibleAnywhere, Transient, category = "Surface Graph")
+	int32 NumEdges;
+
+public:
+	USpiderSurfaceGraph();
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	FORCEINLINE const FSpiderSurfaceGraphDataRef& GetData() const { return Data; }
+
+	FORCEINLINE int32 Num() const { return Data->Num(); }
+	FORCEINLINE bool IsEmpty() const { return Data->IsEmpty(); }
+	FORCEINLINE const FBox& GetBounds() const { return Data->Bounds; }
+
+#if WITH_EDITOR
+	/* Extract climbable surfaces within bounds of the world, replaces current graph. */
+	void Bake(UWorld* World, const FBox& InBounds, const FSpiderSurfaceBakeParams& Params, const TArray<AActor*>& ActorsToIgnore);
+#endif
+};
@@ -0,0 +1,678 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderSwarmManager.h"
+#include "SmartSpiderCharacter.h"
+#include "SmartSpiderSettings.h"
+#include "SpiderMovementComponent.h"
+#include "SpiderStats.h"
+#include "SpiderProbeKernels.h"
+#include "SignificanceManager.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Async/ParallelFor.h"
+
+static TAutoConsoleVariable<int32> CVarSpiderParallelClassifyMinBatch(
+	TEXT("SmartSpider.ParallelClassifyMinBatch"),
+	32,
+	TEXT("Minimal number of swarm spiders to classify surface across worker threads, less than it will classify on game thread."));
+
+static TAutoConsoleVariable<int32> CVarSpiderVectorizedProbes(
+	TEXT("SmartSpider.VectorizedProbes"),
+	1,
+	TEXT("Probe segments and acceptable distance tests of swarm spiders in vector registers.\n")
+	TEXT("0: scalar path per spider\n")
+	TEXT("1: vectorized, see SmartSpider.ProbeKernels automation tests for its match with scalar path"));
+
+namespace SpiderSwarm
+{
+	/* Neighbors whose normals differ more than it are on another surface, e.g. the other side of a thin wall. */
+	static const float SeparationMinNormalDot = 0.7f;
+
+	/* Flow fields not sampled for this many frames are dropped. */
+	static const uint64 FlowFieldIdleFrames = 120;
+
+	/* Served spiders per worker task of vectorized classification. */
+	static const int32 ClassifyChunkSize = 64;
+
+	/* Swarm manager of each game world. */
+	static TMap<const UWorld*, ASpiderSwarmManager*> WorldManagers;
+}
+
+ASpiderSwarmManager::ASpiderSwarmManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	bInBatchedPass = false;
+	NextFlowField = 0;
+	AgentInstances = nullptr;
+}
+
+ASpiderSwarmManager* ASpiderSwarmManager::Get(UWorld* World, bool bCreateIfMissing /* = true */)
+{
+	if (!World || !World->IsGameWorld()) return nullptr;
+
+	if (ASpiderSwarmManager** Manager = SpiderSwarm::WorldManagers.Find(World))
+	{
+		return *Manager;
+	}
+
+	if (!bCreateIfMissing) return nullptr;
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<ASpiderSwarmManager>(SpawnParams);
+}
+
+void ASpiderSwarmManager::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+
+	UWorld* World = GetWorld();
+	if (World && World->IsGameWorld())
+	{
+		SpiderSwarm::WorldManagers.Add(World, this);
+	}
+}
+
+void ASpiderSwarmManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (int32 Index = Spiders.Num() - 1; Index >= 0; --Index)
+	{
+		FSpiderSwarmHandle Handle(Index);
+		Unregister(Handle);
+	}
+
+	SpiderSwarm::WorldManagers.Remove(GetWorld());
+
+	// Searches in flight only hold a weak pointer, their results are dropped.
+	Pathfinder.Reset();
+	FlowFields.Reset();
+	Perception.Reset();
+	Agents.Reset();
+	DistanceFields.Reset();
+#if ENABLE_DRAW_DEBUG
+	DebugDraw.Reset();
+#endif
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FSpiderPathfinder& ASpiderSwarmManager::GetPathfinder()
+{
+	if (!Pathfinder.IsValid())
+	{
+		Pathfinder = MakeShareable(new FSpiderPathfinder());
+	}
+
+	return *Pathfinder;
+}
+
+FSpiderFlowField* ASpiderSwarmManager::FindOrAddFlowField(const USpiderSurfaceGraph* Graph, const AActor* Target)
+{
+	if (!Graph || Graph->IsEmpty() || !Target) return nullptr;
+
+	for (const TSharedPtr<FSpiderFlowField>& FlowField : FlowFields)
+	{
+		if (FlowField->GetTarget() == Target && FlowField->GetGraphAsset() == Graph && !FlowField->IsStale())
+		{
+			FlowField->MarkUsed();
+			return FlowField.Get();
+		}
+	}
+
+	TSharedPtr<FSpiderFlowField> FlowField = MakeShareable(new FSpiderFlowField(Graph, Target));
+	FlowField->SetGoal(Target->GetActorLocation());
+	FlowFields.Add(FlowField);
+	return FlowField.Get();
+}
+
+void ASpiderSwarmManager::UpdateFlowFields()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderFlowFields);
+
+	for (int32 Index = FlowFields.Num() - 1; Index >= 0; --Index)
+	{
+		const TSharedPtr<FSpiderFlowField>& FlowField = FlowFields[Index];
+		if (FlowField->IsStale() || GFrameCounter - FlowField->GetLastUsedFrame() > SpiderSwarm::FlowFieldIdleFrames)
+		{
+			FlowFields.RemoveAtSwap(Index, 1, false);
+			continue;
+		}
+
+		FlowField->SetGoal(FlowField->GetTarget()->GetActorLocation());
+	}
+
+	const int32 NumFlowFields = FlowFields.Num();
+	if (NumFlowFields == 0) return;
+
+	// Builds share one deadline, starting from a different field each frame.
+	const double Deadline = FPlatformTime::Seconds() + GetDefault<USmartSpiderSettings>()->FlowFieldBudgetMs * 0.001;
+	NextFlowField = NextFlowField % NumFlowFields;
+	for (int32 Count = 0; Count < NumFlowFields; ++Count)
+	{
+		const int32 Index = (NextFlowField + Count) % NumFlowFields;
+		if (!FlowFields[Index]->Update(Deadline))
+		{
+			NextFlowField = Index + 1;
+			return;
+		}
+	}
+}
+
+void ASpiderSwarmManager::Tick(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderSwarmTick);
+
+	Super::Tick(DeltaSeconds);
+
+	GatherViewpoints();
+	UpdateSignificance();
+	UpdateFlowFields();
+
+	// Before batched pass, promotion and demotion register and unregister spiders.
+	UpdateAgents(DeltaSeconds);
+
+	const int32 NumSpiders = Spiders.Num();
+	ProbeResults.SetNum(NumSpiders, false);
+	ProbeGathered.Init(false, NumSpiders);
+	bInBatchedPass = true;
+
+	ScheduleCandidates.Reset();
+	for (int32 Index = 0; Index < NumSpiders; ++Index)
+	{
+		ASmartSpiderCharacter* Spider = Spiders[Index];
+		if (!Spider || Spider->IsPendingKill()) continue;
+
+		// Dormant spiders stay registered for perception only, they are woken by events.
+		Spider->UpdateDormancy(DeltaSeconds);
+		if (!Spider->IsDormant() && Spider->PrepareEnvTracing(DeltaSeconds))
+		{
+			ScheduleCandidates.Add(Index);
+		}
+	}
+
+	// Schedule: spiders in transition first, then stable plane walkers with the longest starvation.
+	if (!TraceScheduler.IsUnlimited())
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SpiderScheduleTraces);
+
+		ScheduleCandidates.Sort([this](int32 A, int32 B)
+		{
+			const bool bTransitionA = LastSurfaceTypes[A] != EEnvironmentSurface::Plane;
+			const bool bTransitionB = LastSurfaceTypes[B] != EEnvironmentSurface::Plane;
+			if (bTransitionA != bTransitionB) return bTransitionA;
+
+			return StarvationAges[A] > StarvationAges[B];
+		});
+	}
+
+	ServedIndices.Reset();
+	for (int32 Index : ScheduleCandidates)
+	{
+		ASmartSpiderCharacter* Spider = Spiders[Index];
+		if (TraceScheduler.TryAcquire(Spider->GetExpectedProbeCost()))
+		{
+			ServedIndices.Add(Index);
+			StarvationAges[Index] = 0;
+		}
+		else
+		{
+			Spider->ExtrapolateOnSurface();
+			++StarvationAges[Index];
+		}
+	}
+
+	const int32 VectorizedProbes = CVarSpiderVectorizedProbes.GetValueOnGameThread();
+	if (VectorizedProbes > 0)
+	{
+		TransformProbesVectorized();
+	}
+
+	// Probe: traces or async results on game thread.
+	for (int32 Served = 0; Served < ServedIndices.Num(); ++Served)
+	{
+		const int32 Index = ServedIndices[Served];
+		ProbeResults[Index] = FTraceResult();
+		if (VectorizedProbes > 0)
+		{
+			const int32 FirstRay = Served * FSpiderProbeSet::MaxRays;
+			Spiders[Index]->GatherProbes(ProbeResults[Index], &KernelStarts[FirstRay], &KernelEnds[FirstRay]);
+		}
+		else
+		{
+			Spiders[Index]->GatherProbes(ProbeResults[Index]);
+		}
+		ProbeGathered[Index] = true;
+	}
+
+	// Classify: pure function of probe hits and swarm storage, no actor access.
+	if (VectorizedProbes > 0)
+	{
+		ClassifyProbesVectorized();
+	}
+	else
+	{
+		const bool bSingleThread = NumSpiders < CVarSpiderParallelClassifyMinBatch.GetValueOnGameThread();
+		ParallelFor(NumSpiders, [this](int32 Index)
+		{
+			if (ProbeGathered[Index])
+			{
+				FSpiderSurfaceClassifier::Classify(ProbeResults[Index], AcceptableDistanceSq_SurfaceDetected[Index], ProbeParams[Index].TracingDistanceTestToleranceSq);
+			}
+		}, bSingleThread);
+	}
+
+	// Apply: actor mutation on game thread. Blueprint events may unregister spiders, which only clears the slot here.
+	for (int32 Index = 0; Index < NumSpiders; ++Index)
+	{
+		ASmartSpiderCharacter* Spider = Spiders[Index];
+		if (ProbeGathered[Index] && Spider && !Spider->IsPendingKill())
+		{
+			Spider->ApplySurface(Spider->ConsumeEnvDeltaTime(), ProbeResults[Index]);
+		}
+	}
+
+	// Still in batched pass, perception events may unregister spiders.
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SpiderPerception);
+		Perception.Update(GetWorld(), Spiders, SightDistancesSq, HearingDistancesSq);
+	}
+
+	UpdateSeparation();
+
+	bInBatchedPass = false;
+
+	PendingRemovals.Sort(TGreater<int32>());
+	for (int32 Index : PendingRemovals)
+	{
+		RemoveSlot(Index);
+	}
+	PendingRemovals.Reset();
+
+#if ENABLE_DRAW_DEBUG
+	DebugDraw.Flush(GetWorld());
+#endif
+}
+
+void ASpiderSwarmManager::RegisterDistanceField(USpiderDistanceField* DistanceField)
+{
+	if (DistanceField)
+	{
+		DistanceFields.AddUnique(DistanceField);
+	}
+}
+
+void ASpiderSwarmManager::UnregisterDistanceField(USpiderDistanceField* DistanceField)
+{
+	DistanceFields.Remove(DistanceField);
+}
+
+const FSpiderDistanceFieldData* ASpiderSwarmManager::FindDistanceField(const FBox& Box) const
+{
+	for (const USpiderDistanceField* DistanceField : DistanceFields)
+	{
+		if (DistanceField && !DistanceField->IsEmpty() && DistanceField->GetBounds().IsInside(Box))
+		{
+			return &DistanceField->GetData().Get();
+		}
+	}
+
+	return nullptr;
+}
+
+void ASpiderSwarmManager::TransformProbesVectorized()
+{
+	const int32 NumServed = ServedIndices.Num();
+	KernelProbeSets.SetNumUninitialized(NumServed, false);
+	KernelRotations.SetNumUninitialized(NumServed, false);
+	KernelLocations.SetNumUninitialized(NumServed, false);
+	KernelStarts.SetNumUninitialized(NumServed * FSpiderProbeSet::MaxRays, false);
+	KernelEnds.SetNumUninitialized(NumServed * FSpiderProbeSet::MaxRays, false);
+
+	for (int32 Served = 0; Served < NumServed; ++Served)
+	{
+		const ASmartSpiderCharacter* Spider = Spiders[ServedIndices[Served]];
+		const FTransform& Transform = Spider->GetActorTransform();
+		KernelProbeSets[Served] = &Spider->ProbeSet;
+		KernelRotations[Served] = Transform.GetRotation();
+		KernelLocations[Served] = Transform.GetLocation();
+	}
+
+	FSpiderProbeKernels::TransformProbeSets(KernelProbeSets.GetData(), KernelRotations.GetData(), KernelLocations.GetData(), NumServed,
+		KernelStarts.GetData(), KernelEnds.GetData());
+}
+
+void ASpiderSwarmManager::ClassifyProbesVectorized()
+{
+	// Same hits as scalar FSpiderSurfaceClassifier::Classify, untraced probes take no lanes.
+	const int32 NumServed = ServedIndices.Num();
+	const int32 NumHits = NumServed * FTraceResult::NumAcceptableHits;
+	KernelHitStarts.SetNumUninitialized(NumHits, false);
+	KernelHitImpacts.SetNumUninitialized(NumHits, false);
+	KernelAcceptableDistancesSq.SetNumUninitialized(NumHits, false);
+	KernelTolerancesSq.SetNumUninitialized(NumHits, false);
+	KernelDistances.SetNumUninitialized(NumHits, false);
+
+	// Chunks write disjoint ranges of packed arrays and probe results.
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumServed, SpiderSwarm::ClassifyChunkSize);
+	const bool bSingleThread = NumServed < CVarSpiderParallelClassifyMinBatch.GetValueOnGameThread();
+	ParallelFor(NumChunks, [this, NumServed](int32 Chunk)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_SpiderClassifyProbes);
+
+		const int32 FirstServed = Chunk * SpiderSwarm::ClassifyChunkSize;
+		const int32 LastServed = FMath::Min(FirstServed + SpiderSwarm::ClassifyChunkSize, NumServed);
+		for (int32 Served = FirstServed; Served < LastServed; ++Served)
+		{
+			const int32 Index = ServedIndices[Served];
+			FTraceResult& Probes = ProbeResults[Index];
+			for (int32 HitIndex = 0; HitIndex < FTraceResult::NumAcceptableHits; ++HitIndex)
+			{
+				// Lanes of hits that missed are computed as well, the result is dropped.
+				const FHitResult& Hit = Probes.GetAcceptableHit(HitIndex).HitResult;
+				const int32 Packed = Served * FTraceResult::NumAcceptableHits + HitIndex;
+				KernelHitStarts[Packed] = Hit.TraceStart;
+				KernelHitImpacts[Packed] = Hit.ImpactPoint;
+				KernelAcceptableDistancesSq[Packed] = AcceptableDistanceSq_SurfaceDetected[Index];
+				KernelTolerancesSq[Packed] = ProbeParams[Index].TracingDistanceTestToleranceSq;
+			}
+		}
+
+		const int32 FirstHit = FirstServed * FTraceResult::NumAcceptableHits;
+		FSpiderProbeKernels::TestAcceptableDistances(&KernelHitStarts[FirstHit], &KernelHitImpacts[FirstHit], &KernelAcceptableDistancesSq[FirstHit], &KernelTolerancesSq[FirstHit],
+			(LastServed - FirstServed) * FTraceResult::NumAcceptableHits, &KernelDistances[FirstHit]);
+
+		for (int32 Served = FirstServed; Served < LastServed; ++Served)
+		{
+			const int32 Index = ServedIndices[Served];
+			FTraceResult& Probes = ProbeResults[Index];
+			for (int32 HitIndex = 0; HitIndex < FTraceResult::NumAcceptableHits; ++HitIndex)
+			{
+				FAcceptableHitResult& Hit = Probes.GetAcceptableHit(HitIndex);
+				if (!Hit.HitResult.bBlockingHit) continue;
+
+				Hit.SetAcceptableDistance(KernelDistances[Served * FTraceResult::NumAcceptableHits + HitIndex]);
+			}
+
+			Probes.SurfaceType = FSpiderSurfaceClassifier::GetSurfaceType(Probes);
+		}
+	}, bSingleThread);
+}
+
+void ASpiderSwarmManager::UpdateSeparation()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SpiderSeparation);
+
+	const USmartSpiderSettings* Settings = GetDefault<USmartSpiderSettings>();
+	const int32 NumSpiders = Spiders.Num();
+
+	NeighborPositions.SetNumUninitialized(NumSpiders, false);
+	for (int32 Index = 0; Index < NumSpiders; ++Index)
+	{
+		ASmartSpiderCharacter* Spider = Spiders[Index];
+		NeighborPositions[Index] = Spider ? Spider->GetActorLocation() : FVector::ZeroVector;
+	}
+
+	NeighborHash.Build(NeighborPositions, SurfaceNormals, Settings->SeparationRadius);
+
+	SeparationVelocities.SetNumZeroed(NumSpiders, false);
+	if (Settings->bEnableSeparation)
+	{
+		const float Radius = Settings->SeparationRadius;
+		const float InvRadius = 1.f / Radius;
+		const float Speed = Settings->SeparationSpeed;
+
+		// Pure function of neighbor hash, each spider only writes its own slot.
+		const bool bSingleThread = NumSpiders < CVarSpiderParallelClassifyMinBatch.GetValueOnGameThread();
+		ParallelFor(NumSpiders, [this, Radius, InvRadius, Speed](int32 Index)
+		{
+			if (!Spiders[Index]) return;
+
+			const FVector& Location = NeighborHash.GetPosition(Index);
+			const FVector& Normal = NeighborHash.GetNormal(Index);
+			FVector Push = FVector::ZeroVector;
+
+			NeighborHash.ForEachInRadius(Location, Radius, [&](int32 Neighbor, float DistanceSq)
+			{
+				if (Neighbor == Index || !Spiders[Neighbor]) return;
+				if (FVector::DotProduct(Normal, NeighborHash.GetNormal(Neighbor)) < SpiderSwarm::SeparationMinNormalDot) return;
+
+				FVector Away = FVector::VectorPlaneProject(Location - NeighborHash.GetPosition(Neighbor), Normal);
+				float Distance = Away.Size();
+				if (Distance < KINDA_SMALL_NUMBER)
+				{
+					// Exactly stacked, split them by slot order along an arbitrary surface axis.
+					FVector AxisX, AxisY;
+					Normal.FindBestAxisVectors(AxisX, AxisY);
+					Away = Index < Neighbor ? AxisX : -AxisX;
+					Distance = 0.f;
+				}
+				else
+				{
+					Away /= Distance;
+				}
+
+				Push += Away * (1.f - Distance * InvRadius);
+			});
+
+			SeparationVelocities[Index] = Push.GetClampedToMaxSize(1.f) * Speed;
+		}, bSingleThread);
+	}
+
+	for (int32 Index = 0; Index < NumSpiders; ++Index)
+	{
+		ASmartSpiderCharacter* Spider = Spiders[Index];
+		if (Spider && !Spider->IsPendingKill())
+		{
+			Spider->GetSpiderMovement()->SetSeparationVelocity(SeparationVelocities[Index]);
+		}
+	}
+}
+
+void ASpiderSwarmManager::FindNeighbors(const FVector& Location, float Radius, TArray<ASmartSpiderCharacter*>& OutNeighbors) const
+{
+	NeighborHash.ForEachInRadius(Location, Radius, [this, &OutNeighbors](int32 Item, float DistanceSq)
+	{
+		// Hash is rebuilt at the end of tick, slots may have been removed since.
+		if (Spiders.IsValidIndex(Item) && Spiders[Item])
+		{
+			OutNeighbors.Add(Spiders[Item]);
+		}
+	});
+}
+
+void ASpiderSwarmManager::UpdateSignificance()
+{
+	const USmartSpiderSettings* Settings = GetDefault<USmartSpiderSettings>();
+	if (!Settings->bEnableSignificanceLOD || !Settings->bUpdateSignificanceManager) return;
+
+	USignificanceManager* SignificanceManager = USignificanceManager::Get(GetWorld());
+	if (!SignificanceManager) return;
+
+	SignificanceManager->Update(Viewpoints);
+}
+
+void ASpiderSwarmManager::GatherViewpoints()
+{
+	Viewpoints.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (!PlayerController) continue;
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		Viewpoints.Add(FTransform(ViewRotation, ViewLocation));
+	}
+}
+
+void ASpiderSwarmManager::UpdateAgents(float DeltaSeconds)
+{
+	// Keep updating instances once created, so the last destroyed agent is cleared.
+	if (Agents.Num() == 0 && !AgentInstances) return;
+
+	if (!AgentInstances)
+	{
+		UStaticMesh* AgentMesh = Cast<UStaticMesh>(GetDefault<USmartSpiderSettings>()->AgentMesh.TryLoad());
+		if (AgentMesh)
+		{
+			AgentInstances = NewObject<UInstancedStaticMeshComponent>(this);
+			AgentInstances->SetStaticMesh(AgentMesh);
+			AgentInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			AgentInstances->SetCastShadow(false);
+			AgentInstances->RegisterComponent();
+		}
+	}
+
+	Agents.Update(GetWorld(), DeltaSeconds, Viewpoints, TraceScheduler, AgentInstances);
+}
+
+int32 ASpiderSwarmManager::SpawnSpiderAgent(UObject* WorldContextObject, TSubclassOf<ASmartSpiderCharacter> SpiderClass, FTransform Transform, FVector Velocity)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	ASpiderSwarmManager* Manager = Get(World);
+	return Manager ? Manager->Agents.SpawnAgent(World, *SpiderClass, Transform, Velocity) : INDEX_NONE;
+}
+
+void ASpiderSwarmManager::DestroySpiderAgent(UObject* WorldContextObject, int32 AgentId)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (ASpiderSwarmManager* Manager = Get(World, false))
+	{
+		Manager->Agents.DestroyAgent(AgentId);
+	}
+}
+
+void ASpiderSwarmManager::SetSpiderAgentVelocity(UObject* WorldContextObject, int32 AgentId, FVector Velocity)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (ASpiderSwarmManager* Manager = Get(World, false))
+	{
+		Manager->Agents.SetVelocity(AgentId, Velocity);
+	}
+}
+
+ASmartSpiderCharacter* ASpiderSwarmManager::GetSpiderAgentActor(UObject* WorldContextObject, int32 AgentId)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	ASpiderSwarmManager* Manager = Get(World, false);
+	return Manager ? Manager->Agents.GetActor(AgentId) : nullptr;
+}
+
+FSpiderSwarmHandle ASpiderSwarmManager::Register(ASmartSpiderCharacter* Spider)
+{
+	check(Spider && !Spider->SwarmHandle.IsValid());
+
+	FSpiderSwarmHandle Handle(Spiders.Add(Spider));
+	ProbeParams.Add(Spider->ProbeParams);
+	AcceptableDistanceSq_SurfaceDetected.Add(Spider->AcceptableDistanceSq_SurfaceDetected);
+	AcceptableDistanceSq_TransitionDetected.Add(Spider->AcceptableDistanceSq_TransitionDetected);
+	LastSurfaceTypes.Add(Spider->LastSurfaceType);
+	SurfaceNormals.Add(Spider->SurfaceNormal);
+	NeedStickToSurface.Add(!!Spider->bNeedStickToSurface);
+	SightDistancesSq.Add(Spider->SightsDistanceSq);
+	HearingDistancesSq.Add(Spider->HearingDistanceSq);
+	StarvationAges.Add(0);
+
+	Spider->SwarmHandle = Handle;
+
+	return Handle;
+}
+
+void ASpiderSwarmManager::Unregister(FSpiderSwarmHandle& Handle)
+{
+	if (!Handle.IsValid()) return;
+
+	const int32 Index = Handle.Index;
+	check(Spiders.IsValidIndex(Index));
+
+	ASmartSpiderCharacter* Spider = Spiders[Index];
+	if (Spider)
+	{
+		Spider->LastSurfaceType = LastSurfaceTypes[Index];
+		Spider->SurfaceNormal = SurfaceNormals[Index];
+		Spider->bNeedStickToSurface = NeedStickToSurface[Index];
+		Spider->SwarmHandle.Invalidate();
+		Spider->GetSpiderMovement()->SetSeparationVelocity(FVector::ZeroVector);
+	}
+
+	Handle.Invalidate();
+
+	if (bInBatchedPass)
+	{
+		Spiders[Index] = nullptr;
+		PendingRemovals.Add(Index);
+	}
+	else
+	{
+		RemoveSlot(Index);
+	}
+}
+
+void ASpiderSwarmManager::RemoveSlot(int32 Index)
+{
+	Spiders.RemoveAtSwap(Index, 1, false);
+	ProbeParams.RemoveAtSwap(Index, 1, false);
+	AcceptableDistanceSq_SurfaceDetected.RemoveAtSwap(Index, 1, false);
+	AcceptableDistanceSq_TransitionDetected.RemoveAtSwap(Index, 1, false);
+	LastSurfaceTypes.RemoveAtSwap(Index, 1, false);
+	SurfaceNormals.RemoveAtSwap(Index, 1, false);
+	NeedStickToSurface.RemoveAtSwap(Index);
+	SightDistancesSq.RemoveAtSwap(Index, 1, false);
+	HearingDistancesSq.RemoveAtSwap(Index, 1, false);
+	StarvationAges.RemoveAtSwap(Index, 1, false);
+
+	// The last spider was swapped into the hole.
+	if (Spiders.IsValidIndex(Index) && Spiders[Index])
+	{
+		Spiders[Index]->SwarmHandle.Index = Index;
+	}
+}
+
+void ASpiderSwarmManager::UpdateProbeParams(FSpiderSwarmHandle Handle, const FSpiderProbeParams& InProbeParams, float InAcceptableDistanceSq_Surface, float InAcceptableDistanceSq_Transition)
+{
+	check(Spiders.IsValidIndex(Handle.Index));
+
+	ProbeParams[Handle.Index] = InProbeParams;
+	AcceptableDistanceSq_SurfaceDetected[Handle.Index] = InAcceptableDistanceSq_Surface;
+	AcceptableDistanceSq_TransitionDetected[Handle.Index] = InAcceptableDistanceSq_Transition;
+}
+
+void ASpiderSwarmManager::UpdateSensorRanges(FSpiderSwarmHandle Handle, float InSightDistanceSq, float InHearingDistanceSq)
+{
+	check(Spiders.IsValidIndex(Handle.Index));
+
+	SightDistancesSq[Handle.Index] = InSightDistanceSq;
+	HearingDistancesSq[Handle.Index] = InHearingDistanceSq;
+}
+
+void ASpiderSwarmManager::RegisterSightTarget(UObject* WorldContextObject, AActor* Target)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (ASpiderSwarmManager* Manager = Get(World))
+	{
+		Manager->Perception.AddSightTarget(Target);
+	}
+}
+
+void ASpiderSwarmManager::UnregisterSightTarget(UObject* WorldContextObject, AActor* Target)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (ASpiderSwarmManager* Manager = Get(World, false))
+	{
+		Manager->Perception.RemoveSightTarget(Target);
+	}
+}
+
+void ASpiderSwarmManager::ReportNoise(UObject* WorldContextObject, FVector Location, float Loudness, AActor* Instigator)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject);
+	if (ASpiderSwarmManager* Manager = Get(World, false))
+	{
+		Manager->Perception.ReportNoise(Location, Loudness, Instigator);
+	}
+}
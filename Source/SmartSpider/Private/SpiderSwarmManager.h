@@ -0,0 +1,234 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Info.h"
+#include "EnvironmentTraceHit.h"
+#include "SpiderTraceScheduler.h"
+#include "SpiderPathfinder.h"
+#include "SpiderFlowField.h"
+#include "SpiderPerception.h"
+#include "SpiderDebugDraw.h"
+#include "SpiderAgentSystem.h"
+#include "SpiderDistanceField.h"
+#include "SpiderSwarmManager.generated.h"
+
+class ASmartSpiderCharacter;
+class UInstancedStaticMeshComponent;
+
+/* Index of spider simulation state owned by swarm manager. */
+struct FSpiderSwarmHandle
+{
+	int32 Index;
+
+	FSpiderSwarmHandle()
+		: Index(INDEX_NONE)
+	{
+	}
+
+	explicit FSpiderSwarmHandle(int32 InIndex)
+		: Index(InIndex)
+	{
+	}
+
+	FORCEINLINE bool IsValid() const { return Index != INDEX_NONE; }
+	FORCEINLINE void Invalidate() { Index = INDEX_NONE; }
+};
+
+/*
+* Simulate all swarm spiders of the world within one batched pass.
+* Probe parameters and runtime state are kept in structure of arrays, spider only keeps a handle into it.
+*/
+UCLASS(ClassGroup = Spider, NotPlaceable, Transient)
+class SMARTSPIDER_API ASpiderSwarmManager : public AInfo
+{
+	GENERATED_BODY()
+
+protected:
+	UPROPERTY(Transient)
+	TArray<ASmartSpiderCharacter*> Spiders;
+
+	TArray<FSpiderProbeParams> ProbeParams;
+	TArray<float> AcceptableDistanceSq_SurfaceDetected;
+	TArray<float> AcceptableDistanceSq_TransitionDetected;
+	TArray<EEnvironmentSurface> LastSurfaceTypes;
+	TArray<FVector> SurfaceNormals;
+	TBitArray<> NeedStickToSurface;
+	TArray<float> SightDistancesSq;
+	TArray<float> HearingDistancesSq;
+
+	/* Per frame scratch of batched pass. */
+	TArray<FTraceResult> ProbeResults;
+	TBitArray<> ProbeGathered;
+
+	/* Frames since spider was served by trace scheduler, for round-robin of stable spiders. */
+	TArray<int32> StarvationAges;
+	TArray<int32> ScheduleCandidates;
+
+	/* Spiders served by trace scheduler at this frame, in order of probe kernel lanes. */
+	TArray<int32> ServedIndices;
+
+	/* Packed inputs and outputs of probe kernels, reused across frames. */
+	TArray<const FSpiderProbeSet*> KernelProbeSets;
+	TArray<FQuat> KernelRotations;
+	TArray<FVector> KernelLocations;
+	TArray<FVector> KernelStarts;
+	TArray<FVector> KernelEnds;
+	TArray<FVector> KernelHitStarts;
+	TArray<FVector> KernelHitImpacts;
+	TArray<float> KernelAcceptableDistancesSq;
+	TArray<float> KernelTolerancesSq;
+	TArray<EAcceptableDistance> KernelDistances;
+
+	/* World probe segments of served spiders into @KernelStarts and @KernelEnds. */
+	void TransformProbesVectorized();
+
+	/* Acceptable distance tests of served spiders in vector registers, then surface type of each. */
+	void ClassifyProbesVectorized();
+
+	FSpiderTraceScheduler TraceScheduler;
+
+	/* Surface path queries shared by all spiders of the world, created on first use. */
+	TSharedPtr<FSpiderPathfinder, ESPMode::ThreadSafe> Pathfinder;
+
+	/* Flow fields toward targets chased by swarms, dropped once no spider samples them. */
+	TArray<TSharedPtr<FSpiderFlowField> > FlowFields;
+
+	/* Flow field served first next frame, so every field progresses when the budget is tight. */
+	int32 NextFlowField;
+
+	/* Follow targets and rebuild flow fields within time budget. */
+	void UpdateFlowFields();
+
+	FSpiderPerception Perception;
+
+	/* Positions and surface normals of swarm spiders, rebuilt every frame. */
+	FSpiderSpatialHash NeighborHash;
+	TArray<FVector> NeighborPositions;
+	TArray<FVector> SeparationVelocities;
+
+	/* Rebuild neighbor hash and push spiders on the same surface apart. */
+	void UpdateSeparation();
+
+#if ENABLE_DRAW_DEBUG
+	/* Probes of all spiders of the world, drawn in one batch at end of tick. */
+	FSpiderDebugDraw DebugDraw;
+#endif
+
+	/* Slots unregistered while in batched pass, removed once the pass is done so indices stay stable. */
+	TArray<int32> PendingRemovals;
+	uint32 bInBatchedPass : 1;
+
+	void RemoveSlot(int32 Index);
+
+	/* Lightweight spiders without actor, promoted to pooled spider actors near viewpoints. */
+	FSpiderAgentSystem Agents;
+
+	/* Mesh instances of lightweight agents, created on first agent if project settings has an agent mesh. */
+	UPROPERTY(Transient)
+	UInstancedStaticMeshComponent* AgentInstances;
+
+	void UpdateAgents(float DeltaSeconds);
+
+	/* Distance fields of loaded sublevels, probed by spiders instead of tracing static collision. */
+	UPROPERTY(Transient)
+	TArray<USpiderDistanceField*> DistanceFields;
+
+	/* Player controllers are local players on client, and all observers on server. */
+	void GatherViewpoints();
+	TArray<FTransform> Viewpoints;
+
+	/* Feed player viewpoints to significance manager. */
+	void UpdateSignificance();
+
+public:
+	ASpiderSwarmManager();
+
+	/* Get swarm manager of world, spawn one if missing. Only available for game world. */
+	static ASpiderSwarmManager* Get(UWorld* World, bool bCreateIfMissing = true);
+
+	virtual void PostInitializeComponents() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaSeconds) override;
+
+	/* Take over simulation state and environment tracing of spider, its actor tick keeps running. */
+	FSpiderSwarmHandle Register(ASmartSpiderCharacter* Spider);
+
+	/* Hand simulation state back to spider and invalidate handle. */
+	void Unregister(FSpiderSwarmHandle& Handle);
+
+	/* Refresh probe parameters after spider tuning changed. */
+	void UpdateProbeParams(FSpiderSwarmHandle Handle, const FSpiderProbeParams& InProbeParams, float InAcceptableDistanceSq_Surface, float InAcceptableDistanceSq_Transition);
+
+	/* Refresh sensor ranges after spider tuning changed. */
+	void UpdateSensorRanges(FSpiderSwarmHandle Handle, float InSightDistanceSq, float InHearingDistanceSq);
+
+	FORCEINLINE int32 Num() const { return Spiders.Num(); }
+
+	FORCEINLINE FSpiderPerception& GetPerception() { return Perception; }
+
+	/* Swarm spiders near location as of this frame, O(k) over the neighbor hash. */
+	void FindNeighbors(const FVector& Location, float Radius, TArray<ASmartSpiderCharacter*>& OutNeighbors) const;
+
+	FORCEINLINE const FSpiderSpatialHash& GetNeighborHash() const { return NeighborHash; }
+
+#if ENABLE_DRAW_DEBUG
+	FORCEINLINE FSpiderDebugDraw& GetDebugDraw() { return DebugDraw; }
+#endif
+
+	/* Let swarm spiders see actor besides player pawns. */
+	UFUNCTION(BlueprintCallable, category = "SmartSpider|Perception", meta = (WorldContext = "WorldContextObject"))
+	static void RegisterSightTarget(UObject* WorldContextObject, AActor* Target);
+
+	UFUNCTION(BlueprintCallable, category = "SmartSpider|Perception", meta = (WorldContext = "WorldContextObject"))
+	static void UnregisterSightTarget(UObject* WorldContextObject, AActor* Target);
+
+	/* Swarm spiders within hearing distance scaled by loudness hear the noise at next frame. */
+	UFUNCTION(BlueprintCallable, category = "SmartSpider|Perception", meta = (WorldContext = "WorldContextObject"))
+	static void ReportNoise(UObject* WorldContextObject, FVector Location, float Loudness = 1.f, AActor* Instigator = nullptr);
+
+	/* Spawn a lightweight spider agent, returns its id. Null class for ASmartSpiderCharacter. */
+	UFUNCTION(BlueprintCallable, category = "SmartSpider|Agents", meta = (WorldContext = "WorldContextObject"))
+	static int32 SpawnSpiderAgent(UObject* WorldContextObject, TSubclassOf<ASmartSpiderCharacter> SpiderClass, FTransform Transform, FVector Velocity);
+
+	UFUNCTION(BlueprintCallable, category = "SmartSpider|Agents", meta = (WorldContext = "WorldContextObject"))
+	static void DestroySpiderAgent(UObject* WorldContextObject, int32 AgentId);
+
+	UFUNCTION(BlueprintCallable, category = "SmartSpider|Agents", meta = (WorldContext = "WorldContextObject"))
+	static void SetSpiderAgentVelocity(UObject* WorldContextObject, int32 AgentId, FVector Velocity);
+
+	/* Spider actor standing for agent while promoted, null otherwise. */
+	UFUNCTION(BlueprintPure, category = "SmartSpider|Agents", meta = (WorldContext = "WorldContextObject"))
+	static ASmartSpiderCharacter* GetSpiderAgentActor(UObject* WorldContextObject, int32 AgentId);
+
+	FORCEINLINE FSpiderAgentSystem& GetAgents() { return Agents; }
+
+	/* Player viewpoints gathered at this frame. */
+	FORCEINLINE const TArray<FTransform>& GetViewpoints() const { return Viewpoints; }
+
+	FORCEINLINE FSpiderTraceScheduler& GetTraceScheduler() { return TraceScheduler; }
+
+	/* Called by distance field volumes as their sublevel is loaded and unloaded. */
+	void RegisterDistanceField(USpiderDistanceField* DistanceField);
+	void UnregisterDistanceField(USpiderDistanceField* DistanceField);
+
+	/* Distance field whose bounds contain the box, null if not found. Valid for this frame. */
+	const FSpiderDistanceFieldData* FindDistanceField(const FBox& Box) const;
+
+	FSpiderPathfinder& GetPathfinder();
+
+	/* Flow field toward target over graph, shared by every spider chasing it. Marked used on every call. */
+	FSpiderFlowField* FindOrAddFlowField(const USpiderSurfaceGraph* Graph, const AActor* Target);
+
+	/* Trace budget usage of last frame, for tuning @MaxTracesPerFrame of project settings. */
+	UFUNCTION(BlueprintCallable, category = "SmartSpider")
+	FSpiderTraceBudgetStats GetTraceBudgetStats() const { return TraceScheduler.GetLastFrameStats(); }
+
+	FORCEINLINE const FSpiderProbeParams& GetProbeParams(FSpiderSwarmHandle Handle) const { return ProbeParams[Handle.Index]; }
+	FORCEINLINE float GetAcceptableDistanceSq_SurfaceDetected(FSpiderSwarmHandle Handle) const { return AcceptableDistanceSq_SurfaceDetected[Handle.Index]; }
+	FORCEINLINE float GetAcceptableDistanceSq_TransitionDetected(FSpiderSwarmHandle Handle) const { return AcceptableDistanceSq_TransitionDetected[Handle.Index]; }
+	FORCEINLINE EEnvironmentSurface& GetLastSurfaceType(FSpiderSwarmHandle Handle) { return LastSurfaceTypes[Handle.Index]; }
+	FORCEINLINE FVector& GetSurfaceNormal(FSpiderSwarmHandle Handle) { return SurfaceNormals[Handle.Index]; }
+	FORCEINLINE bool IsNeedStickToSurface(FSpiderSwarmHandle Handle) const { return NeedStickToSurface[Handle.Index]; }
+	FORCEINLINE void SetNeedStickToSurface(FSpiderSwarmHandle Handle, bool bNeed) { NeedStickToSurface[Handle.Index] = bNeed; }
+};
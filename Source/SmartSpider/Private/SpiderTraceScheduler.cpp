@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SmartSpider.h"
+#include "SpiderTraceScheduler.h"
+#include "SmartSpiderSettings.h"
+
+FSpiderTraceScheduler::FSpiderTraceScheduler()
+	: FrameNumber(0)
+	, Reserved(0)
+{
+}
+
+bool FSpiderTraceScheduler::TryAcquire(int32 NumTraces)
+{
+	Refresh();
+
+	if (Current.Budget > 0 && FMath::Max(Reserved, Current.TracesIssued) + NumTraces > Current.Budget)
+	{
+		++Current.SpidersDeferred;
+		return false;
+	}
+
+	Reserved = FMath::Max(Reserved, Current.TracesIssued) + NumTraces;
+	++Current.SpidersServed;
+	return true;
+}
+
+void FSpiderTraceScheduler::Refresh()
+{
+	if (FrameNumber == GFrameCounter) return;
+
+	LastFrame = Current;
+	Current = FSpiderTraceBudgetStats();
+	Current.Budget = GetDefault<USmartSpiderSettings>()->MaxTracesPerFrame;
+	Reserved = 0;
+	FrameNumber = GFrameCounter;
+}
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "SmartSpider.h"
+#include "SpiderStats.h"
+#include "SpiderTraceScheduler.generated.h"
+
+/* Environment trace budget usage of one frame. */
+USTRUCT(BlueprintType)
+struct FSpiderTraceBudgetStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	/* Max traces per frame, 0 for unlimited. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Trace Budget")
+	int32 Budget;
+
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Trace Budget")
+	int32 TracesIssued;
+
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Trace Budget")
+	int32 SpidersServed;
+
+	/* Spiders extrapolated along their last surface because budget ran out. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, category = "Trace Budget")
+	int32 SpidersDeferred;
+
+	FSpiderTraceBudgetStats()
+	{
+		Budget = 0;
+		TracesIssued = 0;
+		SpidersServed = 0;
+		SpidersDeferred = 0;
+	}
+};
+
+/*
+* Hard cap of environment traces issued by all spiders of a world per frame.
+* Spiders acquire the traces they expect to issue before probing, and every trace is accounted when issued.
+*/
+class SMARTSPIDER_API FSpiderTraceScheduler
+{
+public:
+	FSpiderTraceScheduler();
+
+	/* Try to reserve traces for a spider at this frame, deferred spider should extrapolate along its last surface. */
+	bool TryAcquire(int32 NumTraces);
+
+	FORCEINLINE void NotifyTracesIssued(int32 NumTraces)
+	{
+		Refresh();
+		Current.TracesIssued += NumTraces;
+		INC_DWORD_STAT_BY(STAT_SpiderTracesIssued, NumTraces);
+	}
+
+	FORCEINLINE bool IsUnlimited()
+	{
+		Refresh();
+		return Current.Budget <= 0;
+	}
+
+	FORCEINLINE const FSpiderTraceBudgetStats& GetLastFrameStats() const { return LastFrame; }
+
+private:
+	/* Roll over to a new frame lazily, spiders may acquire before or after swarm manager ticks. */
+	void Refresh();
+
+	uint64 FrameNumber;
+	int32 Reserved;
+	FSpiderTraceBudgetStats Current;
+	FSpiderTraceBudgetStats LastFrame;
+};
@@ -39,7 +39,9 @@ public class SmartSpider : ModuleRules
 				"Engine",
 				"Slate",
 				"SlateCore",
-                "AIModule"
+                "AIModule",
+                "SignificanceManager",
+                "Json"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);